@@ -16,10 +16,13 @@ void bind_dataset(py::module & m)
                          const bool c=false,
                          const float validation_size=0.0,
                          const float batch_size=1.0,
-                         const bool shuffle_split=false){
+                         const bool shuffle_split=false,
+                         const bool contiguous_split=false,
+                         const size_t sniff_sample_size=0){
                 return br::Data::Dataset(
                     X, feature_names, feature_types, c,
-                    validation_size, batch_size, shuffle_split);
+                    validation_size, batch_size, shuffle_split, 
+                    contiguous_split, sniff_sample_size);
             }), 
             py::arg("X"),
             py::arg("feature_names") = vector<string>(),
@@ -27,7 +30,9 @@ void bind_dataset(py::module & m)
             py::arg("c") = false,
             py::arg("validation_size") = 0.0,
             py::arg("batch_size") = 1.0,
-            py::arg("shuffle_split") = false
+            py::arg("shuffle_split") = false,
+            py::arg("contiguous_split") = false,
+            py::arg("sniff_sample_size") = 0
         )
         // construct from X, y, feature names (and optional validation and batch sizes) with constructor 2.
         .def(py::init([](const Ref<const ArrayXXf>& X, 
@@ -37,10 +42,13 @@ void bind_dataset(py::module & m)
                          const bool c=false,
                          const float validation_size=0.0,
                          const float batch_size=1.0,
-                         const bool shuffle_split=false){                            
+                         const bool shuffle_split=false,
+                         const bool contiguous_split=false,
+                         const size_t sniff_sample_size=0){                            
                 return br::Data::Dataset(
                     X, y, feature_names, {}, feature_types,
-                    c, validation_size, batch_size, shuffle_split);
+                    c, validation_size, batch_size, shuffle_split,
+                    contiguous_split, sniff_sample_size);
             }), 
             py::arg("X"),
             py::arg("y"),
@@ -49,7 +57,9 @@ void bind_dataset(py::module & m)
             py::arg("c") = false,
             py::arg("validation_size") = 0.0,
             py::arg("batch_size") = 1.0,
-            py::arg("shuffle_split") = false
+            py::arg("shuffle_split") = false,
+            py::arg("contiguous_split") = false,
+            py::arg("sniff_sample_size") = 0
         )
         // construct from X, feature names, but copying the feature types from a
         // reference dataset with constructor 4. Useful for predicting (specially
@@ -74,13 +84,24 @@ void bind_dataset(py::module & m)
         .def("get_n_samples", &br::Data::Dataset::get_n_samples)
         .def("get_n_features", &br::Data::Dataset::get_n_features)
         .def("print", &br::Data::Dataset::print)
-        .def("get_batch", &br::Data::Dataset::get_batch)
-        .def("get_training_data", &br::Data::Dataset::get_training_data)
-        .def("get_validation_data", &br::Data::Dataset::get_validation_data)
+        // views are not exposed to python, so these return copies
+        .def("get_batch", [](const br::Data::Dataset &d) {
+            return d.get_batch().materialize(); })
+        .def("get_training_data", [](const br::Data::Dataset &d) {
+            return d.get_training_data().materialize(); })
+        .def("get_validation_data", [](const br::Data::Dataset &d) {
+            return d.get_validation_data().materialize(); })
         .def("get_batch_size", &br::Data::Dataset::get_batch_size)
         .def("set_batch_size", &br::Data::Dataset::set_batch_size)
-        .def("split", &br::Data::Dataset::split)
+        // the halves are copied, since windows must not outlive their parent
+        .def("split", [](const br::Data::Dataset &d, const ArrayXb& mask) {
+            auto halves = d.split(mask);
+            return std::array<br::Data::Dataset, 2>{
+                halves[0](0, halves[0].get_n_samples()), 
+                halves[1](0, halves[1].get_n_samples())}; })
         .def("get_X", &br::Data::Dataset::get_X)        
+        .def("save_binary", &br::Data::Dataset::save_binary, py::arg("path"))
+        .def_static("load_binary", &br::Data::Dataset::load_binary, py::arg("path"))
         ;
 
     m.def("read_csv", &br::Data::read_csv, py::arg("path"), py::arg("target"), py::arg("sep")=',');
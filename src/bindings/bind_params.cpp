@@ -40,9 +40,16 @@ void bind_params(py::module& m)
         .def_property("weights_init", &Brush::Parameters::get_weights_init, &Brush::Parameters::set_weights_init)
         .def_property("classification", &Brush::Parameters::get_classification, &Brush::Parameters::set_classification)
         .def_property("shuffle_split", &Brush::Parameters::get_shuffle_split, &Brush::Parameters::set_shuffle_split)
+        .def_property("contiguous_split", &Brush::Parameters::get_contiguous_split, &Brush::Parameters::set_contiguous_split)
         .def_property("validation_size", &Brush::Parameters::get_validation_size, &Brush::Parameters::set_validation_size)
         .def_property("feature_names", &Brush::Parameters::get_feature_names, &Brush::Parameters::set_feature_names)
         .def_property("batch_size", &Brush::Parameters::get_batch_size, &Brush::Parameters::set_batch_size)
+        .def_property("stratify_batch", &Brush::Parameters::get_stratify_batch, &Brush::Parameters::set_stratify_batch)
+        .def_property("batch_growth", &Brush::Parameters::get_batch_growth, &Brush::Parameters::set_batch_growth)
+        .def_property("eval_tile_size", &Brush::Parameters::get_eval_tile_size, &Brush::Parameters::set_eval_tile_size)
+        .def_property("subtree_cache_mb", &Brush::Parameters::get_subtree_cache_mb, &Brush::Parameters::set_subtree_cache_mb)
+        .def_property("retain_outputs", &Brush::Parameters::get_retain_outputs, &Brush::Parameters::set_retain_outputs)
+        .def_property("precision", &Brush::Parameters::get_precision, &Brush::Parameters::set_precision)
         .def_property("max_depth", &Brush::Parameters::get_max_depth, &Brush::Parameters::set_max_depth)
         .def_property("max_size", &Brush::Parameters::get_max_size, &Brush::Parameters::set_max_size)
         .def_property("objectives", &Brush::Parameters::get_objectives, &Brush::Parameters::set_objectives)
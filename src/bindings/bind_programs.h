@@ -58,6 +58,7 @@ void bind_program(py::module& m, string name)
             stream_redirect()
             )
         .def("get_dot_model", &T::get_dot_model, py::arg("extras")="")
+        .def("get_cpp_model", &T::get_cpp_model, py::arg("name")="brush_predict")
         .def("get_weights", &T::get_weights)
         .def("size", &T::size, py::arg("include_weight")=true)
         .def("complexity", &T::complexity)
@@ -0,0 +1,105 @@
+/* Brush
+copyright 2020 William La Cava
+license: GNU/GPL v3
+*/
+
+#include "batch.h"
+
+using namespace Brush::Util;
+
+namespace Brush::Data{
+
+BatchScheduler::BatchScheduler(const Dataset& d, float batch_size,
+                               bool stratify, float growth)
+    : data_(&d)
+    , growth_(growth)
+    , stratify_(stratify)
+    , use_batch_(batch_size > 0.0 && batch_size < 1.0)
+{
+    batch_size_ = use_batch_ ? batch_size : 1.0;
+
+    if (growth < 1.0)
+        HANDLE_ERROR_THROW(fmt::format("Batch size growth must be at least 1, "
+                                       "got {}\n", growth));
+
+    if (use_batch_)
+    {
+        rows_ = d.get_training_data().get_indices();
+        order_.resize(rows_.size());
+        new_epoch();
+    }
+}
+
+size_t BatchScheduler::get_n_batch() const
+{
+    if (!use_batch_)
+        return data_ ? data_->get_n_samples() : 0;
+
+    // at least one row, since the batch size is in (0, 1) and ceil rounds up
+    return std::min(rows_.size(), size_t(ceil(rows_.size()*batch_size_)));
+}
+
+void BatchScheduler::new_epoch()
+{
+    if (epoch_ > 0)
+        batch_size_ = std::min(1.0f, batch_size_*growth_);
+
+    ++epoch_;
+    pos_ = 0;
+
+    if (!stratify_)
+    {
+        order_ = rows_;
+        r.shuffle(order_.begin(), order_.end());
+        return;
+    }
+
+    // spread the rows of each class evenly over the permutation: the j-th of
+    // n_c shuffled rows of a class is placed at about j/n_c of the way in,
+    // with jitter so that the classes are not interleaved in a fixed pattern
+    const ArrayXf& y = data_->get_training_data().get_parent().y;
+    std::map<float, vector<size_t>> classes;
+    for (auto i : rows_)
+        classes[y(i)].push_back(i);
+
+    vector<std::pair<float, size_t>> keyed;
+    keyed.reserve(rows_.size());
+    for (auto& [label, idx] : classes)
+    {
+        r.shuffle(idx.begin(), idx.end());
+        for (size_t j = 0; j < idx.size(); ++j)
+            keyed.push_back({(j + r.rnd_flt())/idx.size(), idx[j]});
+    }
+    std::sort(keyed.begin(), keyed.end());
+
+    for (size_t k = 0; k < keyed.size(); ++k)
+        order_[k] = keyed[k].second;
+}
+
+DatasetView BatchScheduler::next()
+{
+    if (data_ == nullptr)
+        HANDLE_ERROR_THROW("BatchScheduler has no dataset\n");
+
+    if (!use_batch_)
+        return DatasetView(*data_, 0, data_->get_n_samples());
+
+    size_t n = get_n_batch();
+    if (pos_ + n > order_.size())
+    {
+        new_epoch();
+        n = get_n_batch();
+    }
+
+    // once batches have grown to the whole partition, the training view is
+    // returned as is, rather than a permutation of all of its rows
+    if (n == rows_.size())
+        return data_->get_training_data();
+
+    vector<size_t> idx(order_.begin() + pos_, order_.begin() + pos_ + n);
+    pos_ += n;
+
+    return DatasetView(data_->get_training_data().get_parent(), std::move(idx));
+}
+
+} // Brush::Data
@@ -0,0 +1,70 @@
+/* Brush
+copyright 2020 William La Cava
+license: GNU/GPL v3
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "data.h"
+
+namespace Brush::Data
+{
+
+/*!
+* @class BatchScheduler
+* @brief hands out mini-batches of the training rows of a Dataset.
+*
+* At the start of every epoch the training rows are permuted once, and each
+* call to next() returns the following slice of that permutation as a view,
+* so drawing a batch costs O(batch) rather than O(N). When fewer rows than a
+* batch are left, a new epoch starts.
+*
+* With `stratify`, the permutation interleaves the classes of the target, so
+* that each slice keeps the class proportions of the training rows. With
+* `growth` > 1, the batch size is multiplied by `growth` at every new epoch,
+* until batches span the whole training partition.
+*
+* If the batch size is not in (0, 1), every call returns a view of the whole
+* dataset, like Dataset::get_batch(), and get_batch_size() is 1. A batch of
+* all training rows is the training view itself. The scheduler must not outlive its
+* dataset.
+*/
+class BatchScheduler
+{
+    public:
+        BatchScheduler() = default;
+
+        BatchScheduler(const Dataset& d, float batch_size,
+                       bool stratify = false, float growth = 1.0);
+
+        /// the next batch of the current epoch.
+        DatasetView next();
+
+        /// number of epochs started so far.
+        inline size_t get_epoch() const { return epoch_; };
+
+        /// fraction of the training rows in each batch of the current epoch.
+        inline float get_batch_size() const { return batch_size_; };
+
+        /// number of rows in each batch of the current epoch.
+        size_t get_n_batch() const;
+
+    private:
+        /// draws the permutation of a new epoch.
+        void new_epoch();
+
+        const Dataset* data_ = nullptr;
+        vector<size_t> rows_;   ///< training rows, in the parent of the training view
+        vector<size_t> order_;  ///< permutation of rows_ for this epoch
+        size_t pos_ = 0;        ///< start of the next batch in order_
+        size_t epoch_ = 0;
+        float batch_size_ = 1.0;
+        float growth_ = 1.0;
+        bool stratify_ = false;
+        bool use_batch_ = false;
+};
+
+} // Brush::Data
+
+#endif
@@ -68,7 +68,7 @@ DataType StateType(const State& arg)
 {
     return StateTypes.at(arg.index());
 }
-State check_type(const ArrayXf& x, const string t)
+State check_type(const Ref<const ArrayXf>& x, const string t, size_t sample_size)
 {
     State tmp;
 
@@ -93,15 +93,34 @@ State check_type(const ArrayXf& x, const string t)
         bool isBinary = true;
         bool isCategorical = true;
 
-        std::map<float, bool> uniqueMap;
-        for(int i = 0; i < x.size(); i++)
+        // integer columns with more than max_categories unique values are
+        // continuous. The unique values are kept in a small array, and the
+        // scan stops as soon as the column is known to be continuous.
+        constexpr int max_categories = 10;
+        std::array<float, max_categories> unique_values;
+        int n_unique = 0;
+
+        // with sampling, only every step-th row is inspected
+        const size_t n = x.size();
+        const size_t step = (sample_size > 0 && sample_size < n) ? n / sample_size : 1;
+
+        for (size_t i = 0; i < n && (isBinary || isCategorical); i += step)
         {
-            if(x(i) != 0 && x(i) != 1)
+            const float value = x(i);
+            if (value != 0 && value != 1)
                 isBinary = false;
-            if(x(i) != floor(x(i)) && x(i) != ceil(x(i)))
+
+            if (value != floor(value) && value != ceil(value))
                 isCategorical = false;
-            else
-                uniqueMap[x(i)] = true;
+            else if (isCategorical 
+                     && std::find(unique_values.begin(), unique_values.begin() + n_unique,
+                                  value) == unique_values.begin() + n_unique)
+            {
+                if (n_unique == max_categories)
+                    isCategorical = false;
+                else
+                    unique_values[n_unique++] = value;
+            }
         } 
         
         if (isBinary)
@@ -110,13 +129,13 @@ State check_type(const ArrayXf& x, const string t)
         }
         else
         {
-            if(isCategorical && uniqueMap.size() <= 10)
+            if(isCategorical)
             {
                 tmp = ArrayXi(x.cast<int>());
             }
             else
             {
-                tmp = x;
+                tmp = ArrayXf(x);
             }
         }
     }
@@ -125,34 +144,48 @@ State check_type(const ArrayXf& x, const string t)
 }
 
 template<typename StateRef>
-State cast_type(const ArrayXf& x, const StateRef& x_ref)
+State cast_type(const Ref<const ArrayXf>& x, const StateRef& x_ref)
 {
     if (std::holds_alternative<ArrayXi>(x_ref))
         return ArrayXi(x.cast<int>());
     else if (std::holds_alternative<ArrayXb>(x_ref))
         return ArrayXb(x.cast<bool>());
     
-    return x;
+    return ArrayXf(x);
 }
 
 /// return a slice of the data using indices idx
 Dataset Dataset::operator()(const vector<size_t>& idx) const
 {
-    std::map<std::string, State> new_features;
-    for (auto& [key, value] : this->features) 
+    if (is_window())
+    {
+        vector<size_t> rows(idx.size());
+        for (size_t i = 0; i < idx.size(); ++i)
+            rows[i] = root_row(idx[i]);
+
+        Dataset copy = get_root()(rows);
+        if (this->y.size() == 0)
+            copy.y.resize(0);
+        return copy;
+    }
+
+    std::vector<State> new_columns(this->columns.size());
+    for (size_t k = 0; k < this->columns.size(); ++k) 
     {
-        auto& k = key;
         std::visit([&](auto&& arg) 
         {
             using T = std::decay_t<decltype(arg)>;
-            if constexpr ( T::NumDimensions == 1)
-                new_features[k] = T(arg(idx));
+            // empty columns stay empty, rather than being indexed
+            if (arg.size() == 0)
+                new_columns[k] = T();
+            else if constexpr ( T::NumDimensions == 1)
+                new_columns[k] = T(arg(idx));
             else if constexpr (T::NumDimensions==2)
-                new_features[k] = T(arg(idx, Eigen::all));
+                new_columns[k] = T(arg(idx, Eigen::all));
             else 
                 static_assert(always_false_v<T>, "non-exhaustive visitor!");
         },
-        value
+        this->columns[k]
         );
     }
     ArrayXf new_y;
@@ -160,36 +193,163 @@ Dataset Dataset::operator()(const vector<size_t>& idx) const
     {
         new_y = this->y(idx);
     }
-    // using constructor 1
-    Dataset result(new_features, new_y, this->classification);
-    // Preserve the original feature name and type order from parent
-    // The constructor's init() may have reordered them, so we fix that here
-    result.feature_names = this->feature_names;
-    result.feature_types = this->feature_types;
-    result.feature_name_order_ = this->feature_names;
-    
-    // Rebuild features_of_type to match the corrected order
-    result.features_of_type.clear();
-    result.unique_data_types.clear();
-    for (size_t i = 0; i < result.feature_names.size(); ++i) {
-        const auto& name = result.feature_names[i];
-        const auto& ftype = result.feature_types[i];
-        result.features_of_type[ftype].push_back(name);
-        Util::unique_insert(result.unique_data_types, ftype);
+    count_copied((get_n_bytes()/std::max(get_n_samples(), 1))*idx.size());
+
+    return Dataset(*this, std::move(new_columns), new_y);
+}
+
+/// return a slice of the data with rows [start, start+n)
+Dataset Dataset::operator()(size_t start, size_t n) const
+{
+    if (is_window())
+    {
+        vector<size_t> idx(n);
+        std::iota(idx.begin(), idx.end(), start);
+        return (*this)(idx);
     }
-    
-    return result;
+
+    std::vector<State> new_columns(this->columns.size());
+    for (size_t k = 0; k < this->columns.size(); ++k) 
+    {
+        std::visit([&](auto&& arg) 
+        {
+            using T = std::decay_t<decltype(arg)>;
+            if constexpr ( T::NumDimensions == 1)
+                new_columns[k] = T(arg.segment(start, n));
+            else if constexpr (T::NumDimensions==2)
+                new_columns[k] = T(arg.middleRows(start, n));
+            else 
+                static_assert(always_false_v<T>, "non-exhaustive visitor!");
+        },
+        this->columns[k]
+        );
+    }
+    ArrayXf new_y;
+    if (this->y.size()>0)
+    {
+        new_y = this->y.segment(start, n);
+    }
+    count_copied((get_n_bytes()/std::max(get_n_samples(), 1))*n);
+
+    return Dataset(*this, std::move(new_columns), new_y);
+}
+
+/// 5. a row slice of parent. Keeps the parent's feature names, types and ids
+Dataset::Dataset(const Dataset& parent, std::vector<State>&& new_columns,
+                 const ArrayXf& new_y)
+    : feature_name_order_(parent.feature_names)
+    , feature_handles_(parent.feature_handles_)
+    , unique_data_types(parent.unique_data_types)
+    , feature_types(parent.feature_types)
+    , feature_names(parent.feature_names)
+    , features_of_type(parent.features_of_type)
+    , columns(std::move(new_columns))
+    , feature_ids(parent.feature_ids)
+    , y(new_y)
+    , classification(parent.classification)
+    , validation_size(0.0)
+    , use_validation(false)
+    , shuffle_split(false)
+    , contiguous_split(false)
+    , batch_size(1.0)
+    , use_batch(false)
+{
+    init_partitions();
+}
+
+
+/// 6. a window. Only the target is copied
+Dataset::Dataset(Window w, bool with_target)
+    : window_(std::move(w))
+    , classification(window_.root->classification)
+    , validation_size(0.0)
+    , use_validation(false)
+    , shuffle_split(false)
+    , contiguous_split(false)
+    , batch_size(1.0)
+    , use_batch(false)
+{
+    const ArrayXf& root_y = window_.root->y;
+    if (with_target && root_y.size() > 0)
+    {
+        if (window_.idx)
+            y = root_y(std::span<const size_t>(window_.idx->data() + window_.start,
+                                               window_.n));
+        else
+            y = root_y.segment(window_.start, window_.n);
+
+        count_copied(y.size()*sizeof(float));
+    }
+
+    // both partitions span the window
+    training_.n = window_.n;
+    validation_.n = window_.n;
+}
+
+Dataset Dataset::window(size_t start, size_t n, bool with_target) const
+{
+    if (start + n > size_t(get_n_samples()))
+        HANDLE_ERROR_THROW(fmt::format("window: rows [{},{}) out of range "
+            "for dataset with {} samples\n", start, start+n, get_n_samples()));
+
+    // the same rows of the same dataset get the same id. The top bit keeps
+    // it apart from the ids of datasets holding columns.
+    size_t seed = 0;
+    std::hash_combine(seed, get_id());
+    std::hash_combine(seed, start);
+    std::hash_combine(seed, n);
+
+    Window w;
+    w.root = &get_root();
+    w.idx = window_.idx;
+    w.start = window_.start + start;
+    w.n = n;
+    w.id = uint64_t(seed) | (uint64_t(1) << 63);
+
+    return Dataset(std::move(w), with_target);
+}
+
+Dataset Dataset::window(std::shared_ptr<const vector<size_t>> idx, 
+                        bool with_target) const
+{
+    const size_t n_samples = get_n_samples();
+    for (auto i : *idx)
+    {
+        if (i >= n_samples)
+            HANDLE_ERROR_THROW(fmt::format("window: row {} out of range "
+                "for dataset with {} samples\n", i, n_samples));
+    }
+
+    Window w;
+    w.root = &get_root();
+    if (is_window())
+    {
+        // rows of a window are rows of its root
+        auto rows = std::make_shared<vector<size_t>>(idx->size());
+        for (size_t i = 0; i < idx->size(); ++i)
+            (*rows)[i] = root_row((*idx)[i]);
+        w.idx = std::move(rows);
+    }
+    else
+        w.idx = std::move(idx);
+    w.n = w.idx->size();
+    w.id = Id::next();
+
+    return Dataset(std::move(w), with_target);
 }
 
+DatasetView Dataset::view(const vector<size_t>& idx) const
+{
+    return DatasetView(*this, idx);
+}
 
 // TODO: i need to improve how get batch works. Maybe a function to update batch indexes, and always using the same dataset?
 // TODO: also, i need to make sure the get batch will sample only from training data and not test
-Dataset Dataset::get_batch() const
+DatasetView Dataset::get_batch() const
 {
-    // will always return a new dataset, even when use_batch is false (this case, returns itself)
-
+    // when use_batch is false, returns a view of the whole dataset
     if (!use_batch) 
-        return (*this);
+        return DatasetView(*this, 0, get_n_samples());
 
     auto n_samples = int(this->get_n_samples());
     // garantee that at least one sample is going to be returned, since
@@ -197,7 +357,7 @@ Dataset Dataset::get_batch() const
     // up
     n_samples = int(ceil(n_samples*batch_size));
 
-    return (*this)(r.shuffled_index(n_samples));
+    return DatasetView(*this, r.shuffled_index(n_samples));
 }
 
 array<Dataset, 2> Dataset::split(const ArrayXb& mask) const
@@ -205,14 +365,129 @@ array<Dataset, 2> Dataset::split(const ArrayXb& mask) const
     // TODO: assert that mask is not filled with zeros or ones (would create
     // one empty partition)
 
-    // split data into two based on mask. 
-    auto idx1 = Util::mask_to_index(mask);
-    auto idx2 = Util::mask_to_index((!mask));
-    return std::array<Dataset, 2>{ (*this)(idx1), (*this)(idx2) };
+    // split data into two based on mask. The halves read the rows in place
+    auto idx1 = std::make_shared<const vector<size_t>>(Util::mask_to_index(mask));
+    auto idx2 = std::make_shared<const vector<size_t>>(Util::mask_to_index((!mask)));
+    const bool with_target = this->y.size() > 0;
+    return std::array<Dataset, 2>{ window(idx1, with_target), 
+                                   window(idx2, with_target) };
 }
 
-Dataset Dataset::get_training_data() const { return (*this)(training_data_idx); }
-Dataset Dataset::get_validation_data() const { return (*this)(validation_data_idx); }
+Dataset::Partition::Partition() 
+    : cache(std::make_shared<DatasetCache>()) 
+{}
+
+Dataset::Partition::Partition(vector<size_t> rows)
+    : Partition()
+{
+    // store runs of consecutive indices as a range
+    bool consecutive = true;
+    for (size_t i = 1; i < rows.size(); ++i)
+    {
+        if (rows[i] != rows[i-1]+1)
+        {
+            consecutive = false;
+            break;
+        }
+    }
+
+    n = rows.size();
+    if (consecutive && !rows.empty())
+        start = rows.front();
+    else if (!consecutive)
+        idx = std::make_shared<const vector<size_t>>(std::move(rows));
+}
+
+Dataset::Partition::Partition(const Partition& other)
+    : idx(other.idx)
+    , start(other.start)
+    , n(other.n)
+    , cache(std::make_shared<DatasetCache>())
+{}
+
+Dataset::Partition& Dataset::Partition::operator=(const Partition& other)
+{
+    idx = other.idx;
+    start = other.start;
+    n = other.n;
+    cache = std::make_shared<DatasetCache>();
+    return *this;
+}
+
+vector<size_t> Dataset::Partition::indices() const
+{
+    if (idx)
+        return *idx;
+
+    vector<size_t> rows(n);
+    std::iota(rows.begin(), rows.end(), start);
+    return rows;
+}
+
+DatasetView Dataset::partition_view(const Partition& p) const
+{
+    if (p.idx)
+        return DatasetView(*this, p.idx, p.cache);
+
+    return DatasetView(*this, p.start, p.n, p.cache);
+}
+
+DatasetView Dataset::get_training_data() const { 
+    // the partitions are adjacent blocks of the layout
+    if (layout_)
+        return DatasetView(*layout_, 0, training_.n, training_.cache);
+    return partition_view(training_); 
+}
+DatasetView Dataset::get_validation_data() const { 
+    if (layout_)
+        return DatasetView(*layout_, training_.n, validation_.n, validation_.cache);
+    return partition_view(validation_); 
+}
+
+void Dataset::release_partitions()
+{
+    training_.cache = std::make_shared<DatasetCache>();
+    validation_.cache = std::make_shared<DatasetCache>();
+}
+
+void Dataset::set_partitions(vector<size_t> train, vector<size_t> validation)
+{
+    // copy the partitions into contiguous blocks. Skipped when training and
+    // validation data overlap (they are then the whole dataset).
+    layout_.reset();
+    if (contiguous_split && use_validation
+    &&  train.size() + validation.size() == size_t(get_n_samples()))
+    {
+        vector<size_t> order = train;
+        order.insert(order.end(), validation.begin(), validation.end());
+        layout_ = std::make_shared<const Dataset>((*this)(order));
+    }
+
+    training_ = Partition(std::move(train));
+    validation_ = Partition(std::move(validation));
+}
+
+size_t Dataset::get_n_bytes() const
+{
+    size_t n_bytes = this->y.size()*sizeof(float);
+    for (const auto& value : this->columns) 
+    {
+        std::visit([&](auto&& arg) 
+        {
+            using T = std::decay_t<decltype(arg)>;
+            if constexpr (is_same_v<T, TimeSeries<typename T::Scalar>>)
+            {
+                n_bytes += arg.n_values()*(sizeof(typename T::Scalar) + sizeof(int))
+                         + (arg.size()+1)*sizeof(Eigen::Index);
+            }
+            else
+                n_bytes += arg.size()*sizeof(typename T::Scalar);
+        },
+        value
+        );
+    }
+    return n_bytes;
+}
 
 vector<string> Dataset::get_feature_types() const {
     // iterate through each feature name in order, get the data type, and return it. This is
@@ -220,11 +495,12 @@ vector<string> Dataset::get_feature_types() const {
     // when calling predict. 
 
     vector<string> python_feature_types;
-    // Iterate through feature_names to preserve order, not through features map
-    for (const auto& name: this->feature_names)
+    const Dataset& root = get_root();
+    // Iterate through feature_names to preserve order
+    for (size_t i = 0; i < root.feature_names.size(); ++i)
     {
-        // fmt::print("name:{}\n",name);
-        const auto& value = this->features.at(name);
+        const auto& name = root.feature_names.at(i);
+        const auto& value = root.columns.at(i);
         
         // save feature types
         auto feature_type = StateType(value);
@@ -245,16 +521,16 @@ vector<string> Dataset::get_feature_types() const {
 }
 
 
-/// call init at the end of constructors
-/// to define metafeatures of the data.
-void Dataset::init()
+/// call init at the end of constructors to store the features
+/// as columns and define metafeatures of the data.
+void Dataset::init(std::map<string, State> features)
 {
     //TODO: populate feature_names, var_data_types, data_types, features_of_type
     // n_features = this->features.size();
     // note this will have to change in unsupervised settings
     // n_samples = this->y.size();
 
-    if (this->features.size() == 0){
+    if (features.size() == 0){
         HANDLE_ERROR_THROW(
             fmt::format("Error during the initialization of the dataset. It "
                         "does not contain any data\n") 
@@ -267,7 +543,7 @@ void Dataset::init()
     // a const-ref to the temporary produced by a mixed lvalue/prvalue ternary expression.
     vector<string> names_to_use;
     if (this->feature_name_order_.empty()) {
-        for (const auto& [name, value] : this->features) {
+        for (const auto& [name, value] : features) {
             names_to_use.push_back(name);
         }
     } else {
@@ -277,7 +553,7 @@ void Dataset::init()
     for (const auto& name : names_to_use)
     {
         // fmt::print("name:{}\n",name);
-        const auto& value = this->features.at(name);
+        auto& value = features.at(name);
         
         // save feature types
         auto feature_type = StateType(value);
@@ -288,15 +564,23 @@ void Dataset::init()
         // add feature to appropriate map list 
         this->features_of_type[feature_type].push_back(name);
 
-        // populate feature names in the original order
+        // the feature id is its position in the original order
+        this->feature_ids[name] = this->columns.size();
         this->feature_names.push_back(name);
+        this->feature_handles_.push_back(name);
+        this->columns.push_back(std::move(value));
     }
 
-    // setting the training and validation data indexes
+    init_partitions();
+}
+
+/// sets the training and validation data indexes
+void Dataset::init_partitions()
+{
     auto n_samples = int(this->get_n_samples());
 
-    training_data_idx.resize(0);
-    validation_data_idx.resize(0);
+    vector<size_t> training_data_idx;
+    vector<size_t> validation_data_idx;
 
     if (!use_validation)
     {
@@ -375,6 +659,8 @@ void Dataset::init()
                     [&](int element) { return element; });
         }   
     }
+
+    set_partitions(std::move(training_data_idx), std::move(validation_data_idx));
 }
 
 float Dataset::get_batch_size() { return batch_size; }
@@ -387,7 +673,8 @@ void Dataset::set_batch_size(float new_size) {
 map<string, State> Dataset::make_features(const ArrayXXf& X,
                                           const map<string,State>& Z,
                                           const vector<string>& vn,
-                                          const vector<string>& ft
+                                          const vector<string>& ft,
+                                          size_t sniff_sample_size
                                          ) 
 {
     // fmt::print("Dataset::make_features()\n");
@@ -435,13 +722,26 @@ map<string, State> Dataset::make_features(const ArrayXXf& X,
         var_types = ft;
     }
 
+    // check_type throws on unknown types, which must happen before the
+    // parallel region below
+    for (const auto& t : var_types)
+    {
+        if (!t.empty() && t != "ArrayB" && t != "ArrayI" && t != "ArrayF")
+            HANDLE_ERROR_THROW(
+                "Invalid feature type. check_type does not support this type: " + t);
+    }
+
+    // columns are converted in parallel, then moved into the map
+    vector<State> states(X.cols());
+    #pragma omp parallel for schedule(dynamic)
     for (int i = 0; i < X.cols(); ++i)
     {
         // fmt::print("X({}): {} \n",i,tmp_feature_names.at(i));
-        State tmp = check_type(X.col(i).array(), var_types.at(i));
-
-        tmp_features[tmp_feature_names.at(i)] = tmp;
+        states[i] = check_type(X.col(i), var_types.at(i), sniff_sample_size);
     }
+
+    for (int i = 0; i < X.cols(); ++i)
+        tmp_features[tmp_feature_names.at(i)] = std::move(states[i]);
     // fmt::print("tmp_features insert\n");
     tmp_features.insert(Z.begin(), Z.end());
 
@@ -482,25 +782,28 @@ map<string,State> Dataset::copy_and_make_features(const ArrayXXf& X,
         tmp_feature_names = vn;
     }
 
-    if (ref_dataset.features.size() != tmp_feature_names.size())
+    if (size_t(ref_dataset.get_n_features()) != tmp_feature_names.size())
         HANDLE_ERROR_THROW(
             fmt::format("Reference dataset with incompatible number of variables: "
             "Reference has {} variable names, but X has {}", 
-            ref_dataset.features.size(), 
+            ref_dataset.get_n_features(), 
             tmp_feature_names.size()
             )
         );
 
-    map<string, State> tmp_features;
+    // look up the reference columns first, since a missing name throws
+    vector<const State*> refs;
+    for (const auto& name : tmp_feature_names)
+        refs.push_back(&ref_dataset[name]);
+
+    vector<State> states(X.cols());
+    #pragma omp parallel for schedule(dynamic)
     for (int i = 0; i < X.cols(); ++i)
-    {
-        State tmp = cast_type(
-            X.col(i).array(),
-            ref_dataset.features.at(tmp_feature_names.at(i))
-        );
+        states[i] = cast_type(X.col(i), *refs.at(i));
 
-        tmp_features[tmp_feature_names.at(i)] = tmp;
-    }
+    map<string, State> tmp_features;
+    for (int i = 0; i < X.cols(); ++i)
+        tmp_features[tmp_feature_names.at(i)] = std::move(states[i]);
 
     // Store the original feature name order
     this->feature_name_order_ = tmp_feature_names;
@@ -508,11 +811,116 @@ map<string,State> Dataset::copy_and_make_features(const ArrayXXf& X,
     return tmp_features;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// DatasetView
+
+DatasetView::DatasetView(const Dataset& parent, size_t start, size_t n,
+                         std::shared_ptr<DatasetCache> cache)
+    : parent_(&parent)
+    , idx_(nullptr)
+    , start_(start)
+    , n_(n)
+    , cache_(cache ? cache : std::make_shared<DatasetCache>())
+{
+    if (start + n > size_t(parent.get_n_samples()))
+        HANDLE_ERROR_THROW(fmt::format("DatasetView: rows [{},{}) out of range "
+            "for dataset with {} samples\n", start, start+n, parent.get_n_samples()));
+}
+
+DatasetView::DatasetView(const Dataset& parent, vector<size_t> idx,
+                         std::shared_ptr<DatasetCache> cache)
+    : parent_(&parent)
+    , idx_(nullptr)
+    , start_(0)
+    , n_(idx.size())
+    , cache_(cache ? cache : std::make_shared<DatasetCache>())
+{
+    // store runs of consecutive indices as a range
+    bool consecutive = true;
+    for (size_t i = 1; i < idx.size(); ++i)
+    {
+        if (idx[i] != idx[i-1]+1)
+        {
+            consecutive = false;
+            break;
+        }
+    }
+
+    if (consecutive && !idx.empty())
+        start_ = idx.front();
+    else if (!consecutive)
+        idx_ = std::make_shared<const vector<size_t>>(std::move(idx));
+}
+
+DatasetView::DatasetView(const Dataset& parent, 
+                         std::shared_ptr<const vector<size_t>> idx,
+                         std::shared_ptr<DatasetCache> cache)
+    : parent_(&parent)
+    , idx_(std::move(idx))
+    , start_(0)
+    , n_(idx_->size())
+    , cache_(cache ? cache : std::make_shared<DatasetCache>())
+{
+}
+
+vector<size_t> DatasetView::get_indices() const
+{
+    if (!is_contiguous())
+        return *idx_;
+
+    vector<size_t> idx(n_);
+    std::iota(idx.begin(), idx.end(), start_);
+    return idx;
+}
+
+ArrayXf DatasetView::get_y() const
+{
+    const auto& y = parent_->y;
+    if (y.size() == 0)
+        return ArrayXf();
+
+    if (is_contiguous())
+        return y.segment(start_, n_);
+
+    return y(*idx_);
+}
+
+DatasetView DatasetView::view(const vector<size_t>& idx) const
+{
+    vector<size_t> parent_idx(idx.size());
+    for (size_t i = 0; i < idx.size(); ++i)
+        parent_idx[i] = is_contiguous() ? start_ + idx[i] : idx_->at(idx[i]);
+
+    return DatasetView(*parent_, parent_idx);
+}
+
+Dataset DatasetView::materialize() const
+{
+    if (is_contiguous())
+        return (*parent_)(start_, n_);
+
+    return (*parent_)(*idx_);
+}
+
+const Dataset& DatasetView::get() const
+{
+    if (is_identity())
+        return *parent_;
+
+    std::call_once(cache_->materialized, [&](){
+        cache_->data = std::make_unique<Dataset>(is_contiguous() 
+            ? parent_->window(start_, n_) : parent_->window(idx_));
+    });
+
+    return *cache_->data;
+}
+
+} // data
+
 ostream& operator<<(ostream& os, DataType dt)
 {
     os << DataTypeName[dt];
     return os;
 }
-    
-} // data
+
 } // Brush
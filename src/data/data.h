@@ -12,10 +12,14 @@ license: GNU/GPL v3
 #include "../util/error.h"
 #include "../util/logger.h"
 #include "../util/rnd.h"
+#include "../util/interned.h"
 #include "timeseries.h"
 //external includes
 #include <variant>
 #include <optional> 
+#include <atomic>
+#include <mutex>
+#include <span>
 
 namespace Brush
 {
@@ -33,12 +37,20 @@ namespace Data
 */
 
 
-/// determines data types of columns of matrix X.
-State check_type(const ArrayXf& x, const string t);
+/// determines data types of columns of matrix X. If t is empty, a column
+/// of 0s and 1s is boolean, a column with at most 10 distinct integers is
+/// integer, and anything else is float. A positive sample_size sniffs only
+/// about that many evenly spaced rows, and casts the whole column to the
+/// type found.
+State check_type(const Ref<const ArrayXf>& x, const string t, size_t sample_size = 0);
 DataType StateType(const State& arg);
 
 template<typename StateRef>
-State cast_type(const ArrayXf& x, const StateRef& x_ref);
+State cast_type(const Ref<const ArrayXf>& x, const StateRef& x_ref);
+
+class DatasetView;
+struct DatasetCache;
+class DatasetFile;
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -54,12 +66,137 @@ class Dataset
     //Dataset(ArrayXXf& X, ArrayXf& y, std::map<string, 
     //std::pair<vector<ArrayXf>, vector<ArrayXf>>>& Z): X(X), y(y), Z(Z){}
     private:
-        vector<size_t> training_data_idx;
-        vector<size_t> validation_data_idx;
+        /// @brief rows of a partition: [start, start+n), or the rows in idx
+        /// when they are not consecutive. Its views share one window, built
+        /// the first time it is requested and kept until
+        /// release_partitions(). Copies of a dataset build their own, since
+        /// a window reads the dataset it was made from.
+        struct Partition
+        {
+            std::shared_ptr<const vector<size_t>> idx;
+            size_t start = 0;
+            size_t n = 0;
+            std::shared_ptr<DatasetCache> cache;
+
+            Partition();
+            explicit Partition(vector<size_t> rows);
+            Partition(const Partition& other);
+            Partition& operator=(const Partition& other);
+
+            vector<size_t> indices() const;
+        };
+        Partition training_;
+        Partition validation_;
+
+        /// @brief with contiguous_split, a copy of the rows with the 
+        /// training rows first and the validation rows next, so that the 
+        /// partitions are adjacent blocks of it. Shared by copies of the
+        /// dataset. It takes as much memory as the dataset, which keeps its
+        /// own rows in their original order for get_X, the target and 
+        /// predictions.
+        std::shared_ptr<const Dataset> layout_;
+
         /// @brief stores the original feature name order before map sorting
         vector<string> feature_name_order_;
 
+        /// @brief interned feature names, indexed by feature id. See 
+        /// get_column_id().
+        vector<Util::Interned<string>> feature_handles_;
+
+        /// @brief a number that identifies a dataset for the lifetime of the
+        /// process. Unlike its address, which a new dataset may reuse once
+        /// it is freed, it is never given to another dataset: copies and
+        /// moves get a new one.
+        struct Id
+        {
+            uint64_t value;
+
+            Id() : value(next()) {};
+            Id(const Id&) : value(next()) {};
+            Id& operator=(const Id&) { value = next(); return *this; };
+
+            static uint64_t next()
+            {
+                static std::atomic<uint64_t> counter{0};
+                return ++counter;
+            };
+        };
+        Id id_;
+
+        /// @brief the rows of another dataset read by a window: rows
+        /// [start, start+n) of root, or its rows listed in entries
+        /// [start, start+n) of idx.
+        struct Window
+        {
+            /// the dataset holding the columns, which is never a window
+            const Dataset* root = nullptr;
+            std::shared_ptr<const vector<size_t>> idx;
+            size_t start = 0;
+            size_t n = 0;
+            /// see get_id(). Copies of a window read the same rows, so they
+            /// keep it.
+            uint64_t id = 0;
+        };
+        Window window_;
+
+        /// an empty dataset, filled in by DatasetFile.
+        Dataset() = default;
+        friend class DatasetFile;
+
+        /// 5. a row slice of parent, with the parent's feature ids.
+        Dataset(const Dataset& parent, std::vector<State>&& new_columns,
+                const ArrayXf& new_y);
+
+        /// 6. a window, see window().
+        Dataset(Window w, bool with_target);
+
+        /// sets the training and validation data indexes.
+        void init_partitions();
+
+        /// sets the partitions to the rows in train and validation, and 
+        /// lays them out with contiguous_split.
+        void set_partitions(vector<size_t> train, vector<size_t> validation);
+
+        /// a view of partition p.
+        DatasetView partition_view(const Partition& p) const;
+
+        /// row of the root read by row i of a window.
+        inline size_t root_row(size_t i) const {
+            return window_.idx ? (*window_.idx)[window_.start + i] 
+                               : window_.start + i;
+        };
+
     public:
+        /// @brief identifies the dataset, e.g. for the outputs cached on it.
+        /// See Id.
+        inline uint64_t get_id() const { 
+            return is_window() ? window_.id : id_.value; 
+        };
+
+        /// @brief true if the dataset reads the rows of another one in place
+        /// instead of holding columns, see window(). 
+        inline bool is_window() const { return window_.root != nullptr; };
+
+        /// @brief the dataset holding the columns and the feature metadata
+        /// (names, types and ids) read by a window, or the dataset itself. 
+        /// Windows leave their own metadata empty.
+        inline const Dataset& get_root() const { 
+            return is_window() ? *window_.root : *this; 
+        };
+
+#ifdef BRUSH_COUNT_COPIES
+        /// @brief running total of bytes deep-copied by row slicing. Only
+        /// compiled in the builds of the tests, which measure the cost of
+        /// materializing views.
+        inline static std::atomic<size_t> n_bytes_copied{0};
+#endif
+        /// @brief adds to n_bytes_copied in builds that count copies
+        static inline void count_copied(size_t n_bytes) {
+#ifdef BRUSH_COUNT_COPIES
+            n_bytes_copied += n_bytes;
+#endif
+        };
+
         /// @brief keeps track of the unique data types in the dataset. 
         std::vector<DataType> unique_data_types;
 
@@ -72,8 +209,13 @@ class Dataset
         /// @brief map from data types to features having that type.
         std::unordered_map<DataType,vector<string>> features_of_type;
         
-        /// @brief dataset features, as key value pairs
-        std::map<string, State> features;
+        /// @brief dataset features, indexed by feature id. The id of a
+        /// feature is its position in feature_names. Empty in a window: 
+        /// read its rows with visit_column().
+        std::vector<State> columns;
+
+        /// @brief map from feature names to feature ids.
+        std::unordered_map<string, size_t> feature_ids;
 
         // TODO: this should probably be a more complex type to include feature type 
         // and potentially other info, like arbitrary relations between features
@@ -90,21 +232,51 @@ class Dataset
         bool use_validation;
         bool shuffle_split;
 
+        /// @brief copy the rows at init so training samples form a 
+        /// contiguous prefix and validation samples a contiguous suffix of 
+        /// the copy. The partitions are then unit-stride blocks of each 
+        /// column, while the dataset, and so its predictions, keep the 
+        /// original row order.
+        bool contiguous_split;
+
         /// @brief percentage of training data size to use in each batch. if 1.0, then all data is used
         float batch_size;
         bool use_batch;
 
+        /// deep copy of the rows in idx. Prefer view() when the result is
+        /// only read.
         Dataset operator()(const vector<size_t>& idx) const;
 
-        /// call init at the end of constructors
-        /// to define metafeatures of the data.
-        void init();
+        /// deep copy of rows [start, start+n).
+        Dataset operator()(size_t start, size_t n) const;
+
+        /// non-owning selection of the rows in idx.
+        DatasetView view(const vector<size_t>& idx) const;
+
+        /// @brief a dataset reading rows [start, start+n) of this one in
+        /// place: its columns are blocks of the columns of the root, so it
+        /// copies no feature. Only the target is copied, unless with_target
+        /// is false. Windows of rows [start, start+n) of a dataset share 
+        /// their id, so the outputs cached on one apply to the others. A
+        /// window must not outlive the dataset holding the columns.
+        Dataset window(size_t start, size_t n, bool with_target = true) const;
+
+        /// @brief a dataset reading the rows of this one listed in idx in
+        /// place. See window(start, n); the window gets a new id.
+        Dataset window(std::shared_ptr<const vector<size_t>> idx, 
+                       bool with_target = true) const;
 
-        /// turns input data into a feature map
+        /// call init at the end of constructors to store the features
+        /// as columns and define metafeatures of the data.
+        void init(std::map<string, State> features);
+
+        /// turns input data into a feature map. Columns are converted in
+        /// parallel; see check_type for sniff_sample_size.
         map<string,State> make_features(const ArrayXXf& X,
                                         const map<string, State>& Z = {},
                                         const vector<string>& vn = {},
-                                        const vector<string>& ft = {}
+                                        const vector<string>& ft = {},
+                                        size_t sniff_sample_size = 0
                                        );
 
         /// turns input into a feature map, with feature types copied from a reference
@@ -119,17 +291,18 @@ class Dataset
              bool c = false,
              float validation_size = 0.0,
              float batch_size = 1.0,
-             bool shuffle_split = false
+             bool shuffle_split = false,
+             bool contiguous_split = false
              ) 
-             : features(d) 
-             , y(y_)
+             : y(y_)
              , classification(c) 
              , validation_size(validation_size)
              , use_validation(validation_size > 0.0 && validation_size < 1.0)
              , batch_size(batch_size)
              , use_batch(batch_size > 0.0 && batch_size < 1.0)
              , shuffle_split(shuffle_split)
-             {init();};
+             , contiguous_split(contiguous_split)
+             {init(d);};
 
         /// 2. initialize data from a matrix with feature columns.
         Dataset(const ArrayXXf& X, 
@@ -140,18 +313,20 @@ class Dataset
              bool c = false,
              float validation_size = 0.0,
              float batch_size = 1.0,
-             bool shuffle_split = false
+             bool shuffle_split = false,
+             bool contiguous_split = false,
+             size_t sniff_sample_size = 0
             ) 
-            : features(make_features(X,Z,vn,ft))
-            , y(y_)
+            : y(y_)
             , classification(c)
             , validation_size(validation_size)
             , use_validation(validation_size > 0.0 && validation_size < 1.0)
             , batch_size(batch_size)
             , use_batch(batch_size > 0.0 && batch_size < 1.0)
             , shuffle_split(shuffle_split)
+            , contiguous_split(contiguous_split)
             {
-                init();
+                init(make_features(X,Z,vn,ft,sniff_sample_size));
                 Xref = optional<reference_wrapper<const ArrayXXf>>{X};
             } 
 
@@ -161,17 +336,19 @@ class Dataset
              bool c = false,
              float validation_size = 0.0,
              float batch_size = 1.0,
-             bool shuffle_split = false
+             bool shuffle_split = false,
+             bool contiguous_split = false,
+             size_t sniff_sample_size = 0
             ) 
             : classification(c)
-            , features(make_features(X,map<string, State>{},vn,ft))
             , validation_size(validation_size)
             , use_validation(validation_size > 0.0 && validation_size < 1.0)
             , batch_size(batch_size)
             , use_batch(batch_size > 0.0 && batch_size < 1.0)
             , shuffle_split(shuffle_split)
+            , contiguous_split(contiguous_split)
             {
-                init();
+                init(make_features(X,map<string, State>{},vn,ft,sniff_sample_size));
                 Xref = optional<reference_wrapper<const ArrayXXf>>{X};
             }
 
@@ -182,14 +359,14 @@ class Dataset
              const vector<string>& vn
             )
             : classification(ref_dataset.classification)
-            , features(copy_and_make_features(X,ref_dataset,vn))
             , validation_size(0.0)
             , use_validation(false)
             , batch_size(1.0)
             , use_batch(false)
             , shuffle_split(false)
+            , contiguous_split(false)
             {
-                init();
+                init(copy_and_make_features(X,ref_dataset,vn));
                 Xref = optional<reference_wrapper<const ArrayXXf>>{X};
             } 
 
@@ -198,8 +375,10 @@ class Dataset
             fmt::print("Dataset contains {} samples and {} features\n",
                 get_n_samples(), get_n_features()
             );
-            for (auto& [key, value] : this->features) 
+            for (size_t i = 0; i < columns.size(); ++i) 
             {
+                const auto& key = feature_names.at(i);
+                const auto& value = columns.at(i);
                 if (std::holds_alternative<ArrayXf>(value))
                     fmt::print("{} <ArrayXf>: {}\n", key, std::get<ArrayXf>(value));
                 else if (std::holds_alternative<ArrayXi>(value))
@@ -218,57 +397,302 @@ class Dataset
         
         // inner partition of original dataset for train and validation.
         // if split is not set, then training = validation.
-        Dataset get_training_data() const;
-        Dataset get_validation_data() const;
+        // Both are views, which resolve to a window of the partition, built
+        // at most once per dataset, or to the dataset itself when the 
+        // partition spans every sample.
+        DatasetView get_training_data() const;
+        DatasetView get_validation_data() const;
+
+        /// frees the windows of the partitions and their copies of the 
+        /// target, once they are no longer needed, such as when a fit 
+        /// ends. Views made before keep their window until they are
+        /// destroyed; later views build it again.
+        void release_partitions();
         vector<string> get_feature_types() const;
 
+        /// number of bytes held by the features and the target.
+        size_t get_n_bytes() const;
+
+        /// writes the features, the target and the partitions to a binary
+        /// file. Defined with DatasetFile, in io.cpp.
+        void save_binary(const std::string& path) const;
+
+        /// loads a dataset written by save_binary(), keeping its feature
+        /// ids, types and partitions.
+        static Dataset load_binary(const std::string& path);
+
         inline int get_n_samples() const { 
+            if (is_window())
+                return int(window_.n);
+            if (columns.empty())
+                return int(y.size());
             return std::visit(
                 [&](auto&& arg) -> int { return int(arg.size());}, 
-                features.begin()->second
+                columns.front()
             );
         };
-        inline int get_n_features() const { return this->features.size(); };
+        inline int get_n_features() const { return get_root().columns.size(); };
         /// select random subset of data for training weights.
-        Dataset get_batch() const;
+        DatasetView get_batch() const;
 
         float get_batch_size();
         void set_batch_size(float new_size);
 
         DataType get_feature_type(const string& name) const
         {
-            DataType feature_type = DataType::ArrayF;
-
-            bool has_feature = false;
-            for (auto& [ftype, names] : features_of_type){
-                auto it = std::find(names.begin(), names.end(), name);
-
-                if (it != names.end())
-                {
-                    feature_type = ftype;
-                    has_feature = true;
-                    break;
-                }
-            }
+            return get_root().feature_types.at(get_feature_id(name));
+        };
 
-            if (!has_feature)
+        /// id of feature `name`, used to index columns.
+        size_t get_feature_id(const string& name) const
+        {
+            const auto& ids = get_root().feature_ids;
+            const auto& it = ids.find(name);
+            if (it == ids.end())
                 HANDLE_ERROR_THROW(fmt::format("Couldn't find feature {} in data\n",name));
+            return it->second;
+        };
+
+        /// id of feature `name`, given the id `id` it had in the data a 
+        /// program was fit on: `id` itself when it refers to the same 
+        /// feature here, and a lookup by name otherwise (e.g. data with
+        /// reordered columns). Names are interned, so checking the id 
+        /// compares two pointers.
+        size_t get_column_id(int id, const Util::Interned<string>& name) const
+        {
+            const auto& handles = get_root().feature_handles_;
+            if (id >= 0 && size_t(id) < handles.size() && handles[id] == name)
+                return id;
 
-            return feature_type;
+            return get_feature_id(name.get());
         };
 
+        /// splits the rows into windows, the first with the rows where mask
+        /// is true. See window().
         std::array<Dataset, 2> split(const ArrayXb& mask) const;
 
-        State operator[](std::string name) const 
+        /// @brief calls f with the rows of feature `id`, which must hold a
+        /// T, and returns its result. f receives the column itself, or, in
+        /// a window, an Eigen block or indexed view of the column of the
+        /// root, so reading a window copies nothing (time series, which are
+        /// not Eigen types, are sliced into a copy). f must accept all of
+        /// them, e.g. a generic lambda.
+        template<typename T, typename F>
+        std::invoke_result_t<F&, const T&> visit_column(size_t id, F&& f) const
         {
-            if (this->features.find(name) == features.end())
-                HANDLE_ERROR_THROW(fmt::format("Couldn't find feature {} in data\n",name));
-            return this->features.at(name);
+            const Dataset& root = get_root();
+            if (id >= root.columns.size())
+                HANDLE_ERROR_THROW(fmt::format("Feature id {} is out of range "
+                    "for data with {} features\n", id, root.columns.size()));
+
+            const State& value = root.columns[id];
+            if (!std::holds_alternative<T>(value))
+                HANDLE_ERROR_THROW(fmt::format("Failed to return type {} for '{}'. "
+                    "The feature's original ret type is {}.\n",
+                    DataTypeEnum<T>::value, root.feature_names[id], StateType(value)));
+
+            const T& column = std::get<T>(value);
+            if (!is_window())
+                return f(column);
+
+            const size_t start = window_.start;
+            const size_t n = window_.n;
+            if (window_.idx)
+            {
+                std::span<const size_t> rows(window_.idx->data() + start, n);
+                if constexpr (T::NumDimensions == 1)
+                    return f(column(rows));
+                else
+                    return f(column(rows, Eigen::all));
+            }
+            if constexpr (T::NumDimensions == 1)
+                return f(column.segment(start, n));
+            else
+                return f(column.middleRows(start, n));
+        };
+
+        /// borrowed access to feature `name`. Not available in a window,
+        /// see visit_column().
+        const State& operator[](const std::string& name) const 
+        {
+            if (is_window())
+                HANDLE_ERROR_THROW(fmt::format("Feature {} of a window must be "
+                    "read with visit_column()\n", name));
+            return columns[get_feature_id(name)];
+        };
+
+        /// borrowed access to feature `name`, which must hold a T.
+        template<typename T>
+        const T& get(const std::string& name) const
+        {
+            const State& value = (*this)[name];
+            if (!std::holds_alternative<T>(value))
+                HANDLE_ERROR_THROW(fmt::format("Failed to return type {} for '{}'. "
+                    "The feature's original ret type is {}.\n",
+                    DataTypeEnum<T>::value, name, StateType(value)));
+
+            return std::get<T>(value);
         };
 
         /* template<> ArrayXb get<ArrayXb>(std::string name) */
 }; // class data
 
+/// @brief lazily built window of a row selection, shared between views.
+struct DatasetCache
+{
+    std::once_flag materialized;
+    std::unique_ptr<Dataset> data;
+};
+
+/*!
+* @class DatasetView
+* @brief a non-owning selection of rows of a Dataset.
+*
+* Stores a pointer to the parent dataset and either a contiguous row range or
+* a vector of row indices. Nothing is copied on construction. Consumers that
+* need a `Dataset` (evaluation, splits, the weight optimizer) receive one
+* through `get()` or the implicit conversion: a view spanning every row
+* resolves to the parent itself, and any other view to a window of the 
+* parent (see Dataset::window()), which reads the columns of the parent in 
+* place. The window is built once, the first time it is requested, and 
+* shared by all copies of the view; it holds a copy of the target only.
+* 
+* A view must not outlive its parent dataset.
+*/
+class DatasetView
+{
+    private:
+        const Dataset* parent_;
+        std::shared_ptr<const vector<size_t>> idx_; ///< null for contiguous views
+        size_t start_;
+        size_t n_;
+        std::shared_ptr<DatasetCache> cache_;
+
+    public:
+        /// selects rows [start, start+n) of parent.
+        DatasetView(const Dataset& parent, size_t start, size_t n,
+                    std::shared_ptr<DatasetCache> cache = nullptr);
+
+        /// selects the rows of parent listed in idx.
+        DatasetView(const Dataset& parent, vector<size_t> idx,
+                    std::shared_ptr<DatasetCache> cache = nullptr);
+
+        /// selects the rows of parent listed in idx, sharing idx.
+        DatasetView(const Dataset& parent, std::shared_ptr<const vector<size_t>> idx,
+                    std::shared_ptr<DatasetCache> cache = nullptr);
+
+        inline int get_n_samples() const { return int(n_); };
+        inline int get_n_features() const { return parent_->get_n_features(); };
+        inline const Dataset& get_parent() const { return *parent_; };
+        inline bool is_contiguous() const { return idx_ == nullptr; };
+        inline size_t get_start() const { return start_; };
+
+        /// true if the view selects every row of the parent, in order.
+        inline bool is_identity() const { 
+            return is_contiguous() && start_ == 0 
+                && n_ == size_t(parent_->get_n_samples()); 
+        };
+
+        /// row indices into the parent dataset.
+        vector<size_t> get_indices() const;
+
+        /// target values of the selected rows.
+        ArrayXf get_y() const;
+
+        /// target values of a contiguous view, without copying.
+        Eigen::Map<const ArrayXf> y_segment() const
+        {
+            if (!is_contiguous())
+                HANDLE_ERROR_THROW("y_segment() requires a contiguous view.");
+
+            return Eigen::Map<const ArrayXf>(parent_->y.data() + start_, n_);
+        };
+
+        /// column `name` of a contiguous view, without copying.
+        template<typename T> requires (bool(T::IsVectorAtCompileTime))
+        Eigen::Map<const T> segment(const string& name) const
+        {
+            if (!is_contiguous())
+                HANDLE_ERROR_THROW("segment() requires a contiguous view.");
+
+            const T& column = parent_->get<T>(name);
+            return Eigen::Map<const T>(column.data() + start_, n_);
+        };
+
+        /// a new view with rows idx of this view.
+        DatasetView view(const vector<size_t>& idx) const;
+
+        /// a deep copy of the selected rows. Always copies.
+        Dataset materialize() const;
+
+        /// the selected rows as a Dataset: the parent, or a window of it,
+        /// built at most once.
+        const Dataset& get() const;
+        operator const Dataset&() const { return get(); };
+};
+
+/*!
+* @class ChunkSource
+* @brief a source of row blocks of a dataset, for evaluating programs on data
+* that does not fit in memory at once.
+*
+* Chunked evaluation keeps one block of features resident at a time, plus
+* per-sample targets and predictions. Implementations must return the same
+* feature names, in the same order, for every block.
+*/
+class ChunkSource
+{
+    public:
+        virtual ~ChunkSource() = default;
+
+        virtual size_t get_n_samples() const = 0;
+
+        /// the target of every sample.
+        virtual ArrayXf get_y() const = 0;
+
+        /// whether the target holds class labels.
+        virtual bool is_classification() const = 0;
+
+        /// rows [start, start+n) as a dataset without a validation partition.
+        virtual Dataset rows(size_t start, size_t n) const = 0;
+
+        /// calls f(start, block) on consecutive blocks of at most chunk_size
+        /// rows, in order.
+        template<typename F>
+        void for_each_chunk(size_t chunk_size, F&& f) const
+        {
+            if (chunk_size == 0)
+                HANDLE_ERROR_THROW("chunk_size must be positive.");
+
+            const size_t n_samples = get_n_samples();
+            for (size_t start = 0; start < n_samples; start += chunk_size)
+            {
+                const Dataset block = rows(start, std::min(chunk_size, n_samples - start));
+                f(start, block);
+            }
+        };
+};
+
+/// serves row blocks of a dataset held in memory. Blocks of a dataset that
+/// fit in cache are the row tiles used by tiled evaluation, see
+/// Parameters::eval_tile_size. Blocks are windows of the dataset without 
+/// a target (see Dataset::window), so serving them copies no rows.
+class DatasetChunks : public ChunkSource
+{
+    private:
+        const Dataset& data;
+
+    public:
+        explicit DatasetChunks(const Dataset& d) : data(d) {};
+
+        size_t get_n_samples() const override { return data.get_n_samples(); };
+        ArrayXf get_y() const override { return data.y; };
+        bool is_classification() const override { return data.classification; };
+        Dataset rows(size_t start, size_t n) const override { 
+            return data.window(start, n, false);
+        };
+};
+
 // TODO: serialization of features in order to nlohmann to work
 // NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Dataset,
 //     features,
@@ -7,76 +7,268 @@ license: GNU/GPL v3
 #include "../util/utils.h"
 /* #include "rnd.h" */
 #include <unordered_set>
+#include <charconv>
+#include <string_view>
+#include <iterator>
+#include <list>
+#include <cstring>
+#include <bit>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define BRUSH_HAS_MMAP
+#endif
 
 namespace Brush::Data{
-    
-/// read csv file into Data. 
+
+/// maps `path`, falling back to reading it when mapping fails.
+MappedFile::MappedFile(const std::string& path)
+{
+#ifdef BRUSH_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        HANDLE_ERROR_THROW("Invalid input file " + path + "\n");
+
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void* p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            ::madvise(p, st.st_size, MADV_SEQUENTIAL);
+            mapped_ = p;
+            data_ = static_cast<const char*>(p);
+            size_ = st.st_size;
+        }
+    }
+    ::close(fd);
+    if (mapped_)
+        return;
+#endif
+    std::ifstream indata(path, std::ios::binary);
+    if (!indata.good())
+        HANDLE_ERROR_THROW("Invalid input file " + path + "\n");
+
+    buffer_.assign(std::istreambuf_iterator<char>(indata),
+                   std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef BRUSH_HAS_MMAP
+    if (mapped_)
+        ::munmap(mapped_, size_);
+#endif
+}
+
+namespace {
+
+/// strips blanks (and the '\r' of CRLF line endings) from both ends of a cell.
+std::string_view trim_cell(std::string_view cell)
+{
+    const char* blanks = "\t\n\v\f\r ";
+    size_t first = cell.find_first_not_of(blanks);
+    if (first == std::string_view::npos)
+        return {};
+    size_t last = cell.find_last_not_of(blanks);
+    return cell.substr(first, last - first + 1);
+}
+
+/// calls `f` on every non-blank line of `text`.
+template<typename F>
+void for_each_line(std::string_view text, F&& f)
+{
+    size_t begin = 0;
+    while (begin < text.size())
+    {
+        size_t end = text.find('\n', begin);
+        if (end == std::string_view::npos)
+            end = text.size();
+
+        std::string_view line = text.substr(begin, end - begin);
+        if (!trim_cell(line).empty())
+            f(line);
+
+        begin = end + 1;
+    }
+}
+
+/// splits `text` into about `n` byte ranges that start and end at line
+/// boundaries, so that each range can be parsed independently.
+vector<std::string_view> split_at_lines(std::string_view text, size_t n)
+{
+    vector<std::string_view> ranges;
+    const size_t step = std::max<size_t>(1, text.size() / std::max<size_t>(1, n));
+
+    size_t begin = 0;
+    while (begin < text.size())
+    {
+        size_t end = std::min(text.size(), begin + step);
+        if (end < text.size())
+        {
+            end = text.find('\n', end);
+            end = (end == std::string_view::npos) ? text.size() : end + 1;
+        }
+        ranges.push_back(text.substr(begin, end - begin));
+        begin = end;
+    }
+    return ranges;
+}
+
+/// parses a numeric cell. Cells are read as doubles and then narrowed, which
+/// gives the same values as the std::stod-based reader this replaces.
+bool parse_cell(std::string_view cell, float& value)
+{
+    cell = trim_cell(cell);
+    if (!cell.empty() && cell.front() == '+')
+        cell.remove_prefix(1);
+
+    double tmp;
+    auto [ptr, ec] = std::from_chars(cell.data(), cell.data() + cell.size(), tmp);
+    if (ec != std::errc() || ptr != cell.data() + cell.size() || cell.empty())
+        return false;
+
+    value = static_cast<float>(tmp);
+    return true;
+}
+
+} // anonymous namespace
+
+/// read csv file into Data.
+///
+/// The file is memory-mapped and split into byte ranges at line boundaries.
+/// A first parallel pass counts the rows of each range, so that every range
+/// knows its first row and the columns can be allocated up front; a second
+/// parallel pass parses the cells directly into the columns. The types of the
+/// columns are then inferred in parallel.
 Dataset read_csv (
     const std::string& path,
     const std::string& target,
     char sep
 )
 {
-    std::ifstream indata;
-    indata.open(path);
-    if (!indata.good())
-        HANDLE_ERROR_THROW("Invalid input file " + path + "\n"); 
-        
-    string line;
-    map<string,vector<float>> values;
-    vector<float> targets;
-
-    std::vector<string> names;
-    unsigned rows=0, target_col_num = 0;
-    
-    while (std::getline(indata, line)) 
+    MappedFile file(path);
+    std::string_view text(file.data(), file.size());
+
+    // read in header
+    size_t header_end = 0;
+    std::string_view header;
+    while (header_end < text.size() && trim_cell(header).empty())
     {
-        std::stringstream lineStream(line);
-        std::string cell;
-        
-        unsigned col_num=0;   
-        while (std::getline(lineStream, cell, sep)) 
+        size_t end = text.find('\n', header_end);
+        if (end == std::string_view::npos)
+            end = text.size();
+        header = text.substr(header_end, end - header_end);
+        header_end = std::min(text.size(), end + 1);
+    }
+    if (trim_cell(header).empty())
+        HANDLE_ERROR_THROW("No header found in input file " + path + "\n");
+
+    vector<string> names;
+    int target_col_num = -1;
+    size_t n_cols = 0;
+    {
+        size_t begin = 0;
+        while (begin <= header.size())
         {
-            cell = Util::trim(cell);
-              
-            if (rows==0) // read in header
-            {
-                if (!cell.compare(target))
-                    target_col_num = col_num;                    
-                else
-                    names.push_back(cell);
-            }
-            else if (col_num != target_col_num) 
-            {
-                auto col_name = names.at(col_num);
-                if (!values.contains(col_name))
-                    values[col_name] = {};
+            size_t end = header.find(sep, begin);
+            if (end == std::string_view::npos)
+                end = header.size();
 
-                values.at(names.at(col_num)).push_back(std::stod(cell));
-            }
+            string cell(trim_cell(header.substr(begin, end - begin)));
+            if (!cell.compare(target))
+                target_col_num = n_cols;
             else
-                targets.push_back(std::stod(cell));
-            
-            ++col_num;
+                names.push_back(cell);
+
+            ++n_cols;
+            begin = end + 1;
         }
-        ++rows;
     }
-    
-    auto y = ArrayXf::Map(targets.data(), targets.size());
-    // for (int i = 0; i < targets.size(); ++i)
-    //     y(i) = targets.at(i);
+    if (target_col_num < 0)
+        HANDLE_ERROR_THROW(fmt::format("Target column '{}' not found in {}\n",
+                                       target, path));
 
-    // infer types of features
-    map<string, State> features;
-    for (auto& [key, value] : values) 
+    // split the body into ranges, and count the rows of each one
+    std::string_view body = text.substr(header_end);
+    vector<std::string_view> ranges = split_at_lines(body,
+                                                     4*omp_get_max_threads());
+    const int n_ranges = ranges.size();
+
+    vector<size_t> first_row(n_ranges + 1, 0);
+    #pragma omp parallel for schedule(static)
+    for (int r = 0; r < n_ranges; ++r)
     {
-        auto tmp = Map<ArrayXf>(value.data(), value.size());
+        size_t rows = 0;
+        for_each_line(ranges[r], [&](std::string_view){ ++rows; });
+        first_row[r+1] = rows;
+    }
+    std::partial_sum(first_row.begin(), first_row.end(), first_row.begin());
+    const size_t n_rows = first_row.back();
+
+    // parse the cells into preallocated columns
+    vector<ArrayXf> columns(names.size(), ArrayXf(n_rows));
+    ArrayXf y(n_rows);
+
+    // exceptions cannot leave the parallel region, so errors are recorded
+    // per range and the first one is thrown afterwards
+    vector<string> errors(n_ranges);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int r = 0; r < n_ranges; ++r)
+    {
+        size_t row = first_row[r];
+        for_each_line(ranges[r], [&](std::string_view line){
+            if (!errors[r].empty())
+                return;
 
-        if (tmp.size() != y.size())
-            HANDLE_ERROR_THROW("different numbers of samples in X and y");
-        features[key] = check_type(tmp, ""); 
-        
+            size_t col_num = 0, feature = 0, begin = 0;
+            while (begin <= line.size() && errors[r].empty())
+            {
+                size_t end = line.find(sep, begin);
+                if (end == std::string_view::npos)
+                    end = line.size();
+
+                std::string_view cell = line.substr(begin, end - begin);
+                float value;
+                if (col_num >= n_cols)
+                    errors[r] = fmt::format("Row {} has more than {} columns",
+                                            row+1, n_cols);
+                else if (!parse_cell(cell, value))
+                    errors[r] = fmt::format("Could not parse '{}' in row {}, column {}",
+                                            trim_cell(cell), row+1, col_num+1);
+                else if (int(col_num) == target_col_num)
+                    y(row) = value;
+                else
+                    columns[feature++](row) = value;
+
+                ++col_num;
+                begin = end + 1;
+            }
+            if (errors[r].empty() && col_num != n_cols)
+                errors[r] = fmt::format("Row {} has {} columns, expected {}",
+                                        row+1, col_num, n_cols);
+            ++row;
+        });
     }
+    for (const auto& err : errors)
+        if (!err.empty())
+            HANDLE_ERROR_THROW(err + " of " + path + "\n");
+
+    // infer types of features
+    vector<State> states(names.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < int(names.size()); ++i)
+        states[i] = check_type(columns[i], "");
+
+    map<string, State> features;
+    for (size_t i = 0; i < names.size(); ++i)
+        features[names[i]] = std::move(states[i]);
 
     // check if endpoint is binary
     bool binary_endpoint = (y.array() == 0 || y.array() == 1).all();
@@ -84,8 +276,362 @@ Dataset read_csv (
     // using constructor 1. (initializing data from a map)
     auto result = Dataset(features, y, binary_endpoint);
 
-    return result;    
+    return result;
 }
 
-} // Brush
+///////////////////////////////////////////////////////////////////////////////
+// binary dataset files
+
+namespace {
+
+const char BINARY_MAGIC[8] = {'B','R','U','S','H','D','S','1'};
+const size_t BINARY_ALIGNMENT = 64;
+
+/// written in the header, and checked when a file is opened
+const string BINARY_FORMAT = "brush dataset";
+const int BINARY_VERSION = 1;
+
+/// numbers in the blocks and the size of the header are stored in the byte
+/// order of the machine that wrote the file
+inline string native_byte_order()
+{
+    return std::endian::native == std::endian::little ? "little" : "big";
+}
 
+inline uint64_t swap_bytes(uint64_t n)
+{
+    uint64_t swapped = 0;
+    for (size_t i = 0; i < sizeof(n); ++i, n >>= 8)
+        swapped = (swapped << 8) | (n & 0xff);
+    return swapped;
+}
+
+static_assert(sizeof(size_t) == sizeof(uint64_t),
+              "binary dataset files store indexes as 64-bit integers");
+
+inline size_t align_up(size_t n)
+{
+    return (n + BINARY_ALIGNMENT - 1) / BINARY_ALIGNMENT * BINARY_ALIGNMENT;
+}
+
+/// lays out the blocks of a dataset file. Blocks are either borrowed from the
+/// dataset or owned by the writer when they had to be assembled.
+struct BlockWriter
+{
+    vector<std::pair<const char*, size_t>> blocks;
+    std::list<vector<char>> owned;
+    size_t size = 0;
+
+    size_t add(const void* data, size_t bytes)
+    {
+        size_t offset = size;
+        blocks.push_back({static_cast<const char*>(data), bytes});
+        size = align_up(size + bytes);
+        return offset;
+    };
+
+    size_t add(vector<char>&& data)
+    {
+        owned.push_back(std::move(data));
+        return add(owned.back().data(), owned.back().size());
+    };
+
+    void write(std::ofstream& out) const
+    {
+        const char zeros[BINARY_ALIGNMENT] = {};
+        for (const auto& [data, bytes] : blocks)
+        {
+            out.write(data, bytes);
+            out.write(zeros, align_up(bytes) - bytes);
+        }
+    };
+};
+
+template<typename T>
+vector<char> as_bytes(const T* data, size_t n)
+{
+    vector<char> bytes(n*sizeof(T));
+    if (n > 0)
+        std::memcpy(bytes.data(), data, bytes.size());
+    return bytes;
+}
+
+} // anonymous namespace
+
+void DatasetFile::save(const Dataset& d, const std::string& path)
+{
+    BlockWriter writer;
+    json header;
+
+    header["format"] = BINARY_FORMAT;
+    header["version"] = BINARY_VERSION;
+    header["byte_order"] = native_byte_order();
+    header["n_samples"] = d.get_n_samples();
+    header["classification"] = d.classification;
+    header["validation_size"] = d.validation_size;
+    header["use_validation"] = d.use_validation;
+    header["shuffle_split"] = d.shuffle_split;
+    header["contiguous_split"] = d.contiguous_split;
+    header["batch_size"] = d.batch_size;
+    header["use_batch"] = d.use_batch;
+
+    header["y"] = {
+        {"offset", writer.add(d.y.data(), d.y.size()*sizeof(float))},
+        {"size", d.y.size()}
+    };
+    const vector<size_t> training_data_idx = d.training_.indices();
+    const vector<size_t> validation_data_idx = d.validation_.indices();
+    header["training_data_idx"] = {
+        {"offset", writer.add(training_data_idx.data(),
+                              training_data_idx.size()*sizeof(size_t))},
+        {"size", training_data_idx.size()}
+    };
+    header["validation_data_idx"] = {
+        {"offset", writer.add(validation_data_idx.data(),
+                              validation_data_idx.size()*sizeof(size_t))},
+        {"size", validation_data_idx.size()}
+    };
+
+    header["features"] = json::array();
+    for (size_t i = 0; i < d.feature_names.size(); ++i)
+    {
+        json entry = {
+            {"name", d.feature_names.at(i)},
+            {"type", d.feature_types.at(i)}
+        };
+
+        std::visit([&](auto&& arg) {
+            using T = std::decay_t<decltype(arg)>;
+            using Scalar = typename T::Scalar;
+
+            if constexpr (std::is_same_v<T, TimeSeries<Scalar>>)
+            {
+                // sample i spans [offsets[i], offsets[i+1]) of values and time
+                vector<uint64_t> offsets(arg.offsets->begin(), arg.offsets->end());
+                const auto& values = arg.values;
+                const auto& time = *arg.times;
+                entry["offsets"] = writer.add(as_bytes(offsets.data(), offsets.size()));
+                entry["values"] = writer.add(as_bytes(values.data(), values.size()));
+                entry["time"] = writer.add(as_bytes(time.data(), time.size()));
+            }
+            else if constexpr (T::IsVectorAtCompileTime
+                               && (std::is_same_v<Scalar, bool>
+                                   || std::is_same_v<Scalar, int>
+                                   || std::is_same_v<Scalar, float>))
+            {
+                entry["values"] = writer.add(arg.data(), arg.size()*sizeof(Scalar));
+            }
+            else
+            {
+                HANDLE_ERROR_THROW(fmt::format(
+                    "Feature {} has a type that cannot be saved: {}\n",
+                    d.feature_names.at(i), DataTypeName.at(d.feature_types.at(i))));
+            }
+        }, d.columns.at(i));
+
+        header["features"].push_back(entry);
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out.good())
+        HANDLE_ERROR_THROW("Could not open " + path + " for writing\n");
+
+    const string header_str = header.dump();
+    const uint64_t header_size = header_str.size();
+    const size_t blocks_start = align_up(sizeof(BINARY_MAGIC) + sizeof(header_size)
+                                         + header_size);
+
+    out.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    out.write(reinterpret_cast<const char*>(&header_size), sizeof(header_size));
+    out.write(header_str.data(), header_size);
+    const char zeros[BINARY_ALIGNMENT] = {};
+    out.write(zeros, blocks_start - (sizeof(BINARY_MAGIC) + sizeof(header_size)
+                                     + header_size));
+    writer.write(out);
+
+    if (!out.good())
+        HANDLE_ERROR_THROW("Failed to write " + path + "\n");
+}
+
+DatasetFile::DatasetFile(const std::string& path)
+    : path(path)
+    , file(std::make_shared<MappedFile>(path))
+{
+    const char* data = file->data();
+    uint64_t header_size = 0;
+    const size_t prefix = sizeof(BINARY_MAGIC) + sizeof(header_size);
+
+    if (file->size() < prefix
+        || std::memcmp(data, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0)
+        HANDLE_ERROR_THROW(path + " is not a binary dataset file\n");
+
+    std::memcpy(&header_size, data + sizeof(BINARY_MAGIC), sizeof(header_size));
+    if (file->size() < prefix + header_size)
+    {
+        if (file->size() >= prefix + swap_bytes(header_size))
+            HANDLE_ERROR_THROW(path + " was written on a machine with the "
+                               "other byte order\n");
+        HANDLE_ERROR_THROW(path + " is truncated\n");
+    }
+
+    header = json::parse(data + prefix, data + prefix + header_size);
+    blocks = data + align_up(prefix + header_size);
+
+    if (header.value("format", "") != BINARY_FORMAT)
+        HANDLE_ERROR_THROW(path + " is not a binary dataset file\n");
+    if (header.value("version", 0) != BINARY_VERSION)
+        HANDLE_ERROR_THROW(fmt::format("{} has version {} of the binary "
+            "dataset format, which this build does not read (version {})\n",
+            path, header.value("version", 0), BINARY_VERSION));
+    if (header.value("byte_order", "") != native_byte_order())
+        HANDLE_ERROR_THROW(fmt::format("{} was written with {} endian "
+            "numbers, and this machine is {} endian\n", path, 
+            header.value("byte_order", "unknown"), native_byte_order()));
+
+    n_samples = header["n_samples"];
+    for (const auto& entry : header["features"])
+    {
+        feature_names.push_back(entry["name"]);
+        feature_types.push_back(entry["type"]);
+    }
+}
+
+const char* DatasetFile::block(size_t offset, size_t bytes) const
+{
+    size_t start = blocks - file->data();
+    if (start + offset + bytes > file->size())
+        HANDLE_ERROR_THROW(path + " is truncated\n");
+
+    return blocks + offset;
+}
+
+Map<const ArrayXf> DatasetFile::get_y_map() const
+{
+    // datasets without a target store an empty block
+    size_t n = header["y"]["size"];
+    if (n == 0)
+        return Map<const ArrayXf>(nullptr, 0);
+
+    return Map<const ArrayXf>(
+        reinterpret_cast<const float*>(block(header["y"]["offset"], n*sizeof(float))), n);
+}
+
+State DatasetFile::read_column(size_t i, size_t start, size_t n) const
+{
+    const json& entry = header["features"].at(i);
+
+    // the argument of these lambdas only carries the type to read
+    auto read_array = [&](auto tag) -> State {
+        using T = decltype(tag);
+        using Scalar = typename T::Scalar;
+        const Scalar* values = reinterpret_cast<const Scalar*>(
+            block(entry["values"], n_samples*sizeof(Scalar)));
+        return T(Map<const T>(values + start, n));
+    };
+
+    auto read_timeseries = [&](auto tag) -> State {
+        using Scalar = decltype(tag);
+        const uint64_t* offsets = reinterpret_cast<const uint64_t*>(
+            block(entry["offsets"], (n_samples+1)*sizeof(uint64_t)));
+        const uint64_t n_values = offsets[n_samples];
+        const Scalar* values = reinterpret_cast<const Scalar*>(
+            block(entry["values"], n_values*sizeof(Scalar)));
+        const int* time = reinterpret_cast<const int*>(
+            block(entry["time"], n_values*sizeof(int)));
+
+        // rows [start, start+n) are one contiguous block of the flat arrays
+        const uint64_t first = offsets[start];
+        const uint64_t len = offsets[start+n] - first;
+        typename TimeSeries<Scalar>::OffsetType row_offsets(n+1);
+        for (size_t j = 0; j <= n; ++j)
+            row_offsets(j) = offsets[start+j] - first;
+
+        return TimeSeries<Scalar>(
+            Map<const Eigen::Array<Scalar, Dynamic, 1>>(values + first, len),
+            Map<const ArrayXi>(time + first, len),
+            std::move(row_offsets));
+    };
+
+    switch (feature_types.at(i))
+    {
+        case DataType::ArrayB: return read_array(ArrayXb());
+        case DataType::ArrayI: return read_array(ArrayXi());
+        case DataType::ArrayF: return read_array(ArrayXf());
+        case DataType::TimeSeriesB: return read_timeseries(bool());
+        case DataType::TimeSeriesI: return read_timeseries(int());
+        case DataType::TimeSeriesF: return read_timeseries(float());
+        default:
+            HANDLE_ERROR_THROW(fmt::format("Unsupported type for feature {} in {}\n",
+                                           feature_names.at(i), path));
+    }
+    return State();
+}
+
+Dataset DatasetFile::rows(size_t start, size_t n) const
+{
+    if (start + n > n_samples)
+        HANDLE_ERROR_THROW(fmt::format("Rows [{}, {}) are out of range for {} "
+                                       "samples\n", start, start+n, n_samples));
+
+    map<string, State> features;
+    for (size_t i = 0; i < feature_names.size(); ++i)
+        features[feature_names.at(i)] = read_column(i, start, n);
+
+    Dataset d;
+    const auto y = get_y_map();
+    if (y.size() > 0)
+        d.y = y.segment(start, n);
+    d.classification = header["classification"];
+    d.validation_size = 0.0;
+    d.use_validation = false;
+    d.shuffle_split = false;
+    d.contiguous_split = false;
+    d.batch_size = 1.0;
+    d.use_batch = false;
+
+    // keep the saved feature ids
+    d.feature_name_order_ = feature_names;
+    d.init(std::move(features));
+
+    return d;
+}
+
+Dataset DatasetFile::load() const
+{
+    Dataset d = rows(0, n_samples);
+
+    d.validation_size = header["validation_size"];
+    d.use_validation = header["use_validation"];
+    d.shuffle_split = header["shuffle_split"];
+    d.contiguous_split = header["contiguous_split"];
+    d.batch_size = header["batch_size"];
+    d.use_batch = header["use_batch"];
+
+    // restore the partitions instead of drawing new ones
+    auto read_index = [&](const json& entry) {
+        size_t size = entry["size"];
+        const size_t* idx = reinterpret_cast<const size_t*>(
+            block(entry["offset"], size*sizeof(size_t)));
+        return vector<size_t>(idx, idx + size);
+    };
+    d.set_partitions(read_index(header["training_data_idx"]),
+                     read_index(header["validation_data_idx"]));
+
+    return d;
+}
+
+void Dataset::save_binary(const std::string& path) const
+{
+    // a window holds no columns, so its rows are copied
+    if (is_window())
+        DatasetFile::save((*this)(0, get_n_samples()), path);
+    else
+        DatasetFile::save(*this, path);
+}
+
+Dataset Dataset::load_binary(const std::string& path)
+{
+    return DatasetFile(path).load();
+}
+
+} // Brush
@@ -28,6 +28,101 @@ Dataset read_csv (
     char sep=','
 );
 
+/// read-only view of the contents of a file. The file is memory-mapped when
+/// the platform allows it, and read into a buffer otherwise.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    inline const char* data() const { return data_; };
+    inline size_t size() const { return size_; };
+
+private:
+    void* mapped_ = nullptr;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    string buffer_; ///< used when the file could not be mapped
+};
+
+/*!
+* @class DatasetFile
+* @brief a dataset file written by Dataset::save_binary().
+*
+* The file starts with a JSON header (the format, its version and the byte
+* order of the numbers, feature names and types, the number of samples, the
+* split settings and the location of every block), followed by
+* 64-byte aligned blocks holding the target, the training and validation
+* indexes and the feature columns. The file is memory-mapped, so array
+* columns can be read in place with column(), and row blocks can be loaded
+* without reading the rest of the file, which makes the file a ChunkSource
+* for chunked evaluation.
+*/
+class DatasetFile : public ChunkSource
+{
+public:
+    explicit DatasetFile(const std::string& path);
+
+    inline size_t get_n_samples() const override { return n_samples; };
+    inline const vector<string>& get_feature_names() const { return feature_names; };
+    inline const vector<DataType>& get_feature_types() const { return feature_types; };
+
+    /// the target, without copying. Empty if the dataset has none.
+    Map<const ArrayXf> get_y_map() const;
+
+    ArrayXf get_y() const override { return get_y_map(); };
+
+    bool is_classification() const override { return header["classification"]; };
+
+    /// array column `name`, without copying.
+    template<typename T> requires (bool(T::IsVectorAtCompileTime))
+    Map<const T> column(const string& name) const
+    {
+        auto it = std::find(feature_names.begin(), feature_names.end(), name);
+        if (it == feature_names.end())
+            HANDLE_ERROR_THROW(fmt::format("Feature {} not found in {}\n", name, path));
+
+        const auto& entry = header["features"].at(it - feature_names.begin());
+        if (entry["type"].get<DataType>() != DataTypeEnum<T>::value)
+            HANDLE_ERROR_THROW(fmt::format("Feature {} is not of type {}\n", name,
+                                           DataTypeName.at(DataTypeEnum<T>::value)));
+
+        using Scalar = typename T::Scalar;
+        return Map<const T>(
+            reinterpret_cast<const Scalar*>(block(entry["values"], n_samples*sizeof(Scalar))),
+            n_samples);
+    };
+
+    /// the whole dataset, with the training and validation partitions it had
+    /// when it was saved.
+    Dataset load() const;
+
+    /// rows [start, start+n) as a dataset without a validation partition.
+    Dataset rows(size_t start, size_t n) const override;
+
+    /// writes `d` to `path`.
+    static void save(const Dataset& d, const std::string& path);
+
+private:
+    /// start of the block at `offset`, checking that `bytes` fit in the file.
+    const char* block(size_t offset, size_t bytes) const;
+
+    /// rows [start, start+n) of feature i.
+    State read_column(size_t i, size_t start, size_t n) const;
+
+    string path;
+    std::shared_ptr<MappedFile> file;
+    json header;
+    const char* blocks = nullptr;
+    size_t n_samples;
+    vector<string> feature_names;
+    vector<DataType> feature_types;
+};
+
 // ///  load longitudinal csv file into matrix. 
 // void load_longitudinal(const std::string & path,
 //                         std::map<string, std::pair<vector<ArrayXf>, vector<ArrayXf> > > &Z,
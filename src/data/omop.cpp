@@ -3,21 +3,349 @@ copyright 2022 William La Cava
 license: GNU/GPL v3
 */
 #include "omop.h"
+#include "io.h"
+#include <charconv>
+#include <chrono>
+#include <string_view>
+#include <unordered_map>
 
 
 namespace Brush::Data {
 
+const vector<OmopTable>& default_omop_tables()
+{
+    static const vector<OmopTable> tables = {
+        // name, person_id, concept_id, date, value
+        {"measurement",     1, 2, 3, 7},    // value_as_number
+        {"observation",     1, 2, 3, 6},    // value_as_number
+        {"condition_era",   1, 2, 3, 5},    // condition_occurrence_count
+        {"drug_era",        1, 2, 3, 5},    // drug_exposure_count
+        {"device_exposure", 1, 2, 3, -1}
+    };
+    return tables;
+}
 
-OmopData::OmopData(fs::directory_iterator omop_dir) {
+namespace {
+
+/// splits a tab-separated line of a CDM table into its fields.
+void split_fields(std::string_view line, vector<std::string_view>& fields)
+{
+    fields.clear();
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+
+    size_t begin = 0;
+    while (true)
+    {
+        size_t end = line.find('\t', begin);
+        if (end == std::string_view::npos)
+        {
+            fields.push_back(line.substr(begin));
+            return;
+        }
+        fields.push_back(line.substr(begin, end - begin));
+        begin = end + 1;
+    }
+}
+
+/// calls `f` on the fields of every non-empty line of `text`.
+template<typename F>
+void for_each_record(std::string_view text, F&& f)
+{
+    vector<std::string_view> fields;
+    size_t begin = 0;
+    while (begin < text.size())
+    {
+        size_t end = text.find('\n', begin);
+        if (end == std::string_view::npos)
+            end = text.size();
+
+        std::string_view line = text.substr(begin, end - begin);
+        if (!line.empty() && line != "\r")
+        {
+            split_fields(line, fields);
+            f(fields);
+        }
+        begin = end + 1;
+    }
+}
+
+template<typename T>
+bool parse_number(std::string_view field, T& value)
+{
+    auto [ptr, ec] = std::from_chars(field.data(), field.data() + field.size(), value);
+    return !field.empty() && ec == std::errc() && ptr == field.data() + field.size();
+}
+
+/// days since 1970-01-01 of a YYYY-MM-DD date.
+bool parse_date(std::string_view field, int& days)
+{
+    int y, m, d;
+    if (field.size() < 10 || field[4] != '-' || field[7] != '-'
+        || !parse_number(field.substr(0, 4), y)
+        || !parse_number(field.substr(5, 2), m)
+        || !parse_number(field.substr(8, 2), d))
+        return false;
+
+    std::chrono::year_month_day ymd{std::chrono::year(y),
+                                    std::chrono::month(m),
+                                    std::chrono::day(d)};
+    if (!ymd.ok())
+        return false;
+
+    days = std::chrono::sys_days(ymd).time_since_epoch().count();
+    return true;
+}
+
+/// observations of one concept, in the order they were read.
+struct ConceptEvents
+{
+    vector<int> rows;
+    vector<int> times;
+    vector<float> values;
+};
+
+using TableEvents = std::unordered_map<int64_t, ConceptEvents>;
+
+/// gathers the events of a concept into a time series with one sample per
+/// person, sorted by time within each sample.
+TimeSeriesf make_time_series(const ConceptEvents& e, size_t n_persons)
+{
+    using OffsetType = TimeSeriesf::OffsetType;
+
+    OffsetType off = OffsetType::Zero(n_persons+1);
+    for (int r : e.rows)
+        ++off(r+1);
+    for (size_t i = 0; i < n_persons; ++i)
+        off(i+1) += off(i);
+
+    // counting sort by person keeps the order of the file within a person
+    vector<Eigen::Index> order(e.rows.size());
+    {
+        OffsetType next = off.head(n_persons);
+        for (size_t k = 0; k < e.rows.size(); ++k)
+            order[next(e.rows[k])++] = k;
+    }
+
+    ArrayXf values(e.rows.size());
+    ArrayXi times(e.rows.size());
+    for (size_t i = 0; i < n_persons; ++i)
+    {
+        auto first = order.begin() + off(i), last = order.begin() + off(i+1);
+        std::stable_sort(first, last, [&](auto a, auto b){
+            return e.times[a] < e.times[b];
+        });
+        for (auto k = off(i); k < off(i+1); ++k)
+        {
+            values(k) = e.values[order[k]];
+            times(k) = e.times[order[k]];
+        }
+    }
+    return TimeSeriesf(std::move(values), std::move(times), std::move(off));
+}
+
+} // anonymous namespace
+
+OmopData::OmopData(fs::directory_iterator omop_dir,
+                   TimeValues tv,
+                   size_t min_persons,
+                   const vector<OmopTable>& tables)
+    : tv(tv)
+    , min_persons(min_persons)
+{
+    std::map<string, fs::path> files;
     for (fs::directory_entry dir_entry : omop_dir) {
         if (dir_entry.is_regular_file()) {
+            files[dir_entry.path().stem().string()] = dir_entry.path();
+        }
+    }
+
+    if (files.contains("cdm_source"))
+    {
+        MappedFile file(files.at("cdm_source").string());
+        for_each_record({file.data(), file.size()}, [&](const auto& fields){
+            if (cdm_version.empty() && fields.size() > 8)
+                cdm_version = string(fields[8]);
+        });
+    }
 
+    vector<OmopTable> found;
+    for (const auto& t : tables)
+        if (files.contains(t.name))
+            found.push_back(t);
+
+    if (found.empty())
+        HANDLE_ERROR_THROW("No OMOP CDM event tables found\n");
+
+    // build side of the join: person_id -> sample. Persons come from the
+    // person table when there is one, and from the event tables otherwise.
+    if (files.contains("person"))
+    {
+        MappedFile file(files.at("person").string());
+        for_each_record({file.data(), file.size()}, [&](const auto& fields){
+            int64_t id;
+            if (parse_number(fields[0], id))
+                person_ids.push_back(id);
+        });
+    }
+    else
+    {
+        vector<vector<int64_t>> ids(found.size());
+        #pragma omp parallel for schedule(dynamic)
+        for (int t = 0; t < int(found.size()); ++t)
+        {
+            MappedFile file(files.at(found[t].name).string());
+            for_each_record({file.data(), file.size()}, [&](const auto& fields){
+                int64_t id;
+                if (int(fields.size()) > found[t].person_col
+                    && parse_number(fields[found[t].person_col], id))
+                    ids[t].push_back(id);
+            });
+        }
+        for (const auto& v : ids)
+            person_ids.insert(person_ids.end(), v.begin(), v.end());
+    }
+    std::sort(person_ids.begin(), person_ids.end());
+    person_ids.erase(std::unique(person_ids.begin(), person_ids.end()),
+                     person_ids.end());
+
+    std::unordered_map<int64_t, int> person_row;
+    person_row.reserve(person_ids.size());
+    for (size_t i = 0; i < person_ids.size(); ++i)
+        person_row[person_ids[i]] = i;
+
+    // probe side: every table streams its events into per-concept arrays.
+    // exceptions cannot leave the parallel region, so errors are recorded
+    // per table and the first one is thrown afterwards
+    vector<TableEvents> events(found.size());
+    vector<string> errors(found.size());
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < int(found.size()); ++t)
+    {
+        const OmopTable& table = found[t];
+        const int n_fields = std::max({table.person_col, table.concept_col,
+                                       table.date_col, table.value_col}) + 1;
+        try
+        {
+            MappedFile file(files.at(table.name).string());
+            size_t line = 0;
+            for_each_record({file.data(), file.size()}, [&](const auto& fields){
+                ++line;
+                if (!errors[t].empty())
+                    return;
+
+                int64_t person, concept_id;
+                int date;
+                if (int(fields.size()) < n_fields
+                    || !parse_number(fields[table.person_col], person)
+                    || !parse_number(fields[table.concept_col], concept_id)
+                    || !parse_date(fields[table.date_col], date))
+                {
+                    errors[t] = fmt::format("Could not parse line {} of {}",
+                                            line, table.name);
+                    return;
+                }
+
+                auto row = person_row.find(person);
+                if (row == person_row.end())
+                    return;
+
+                float value = 1.0;
+                if (table.value_col >= 0 && !fields[table.value_col].empty()
+                    && !parse_number(fields[table.value_col], value))
+                {
+                    errors[t] = fmt::format("Could not parse value '{}' in line {} of {}",
+                                            fields[table.value_col], line, table.name);
+                    return;
+                }
+
+                auto& e = events[t][concept_id];
+                e.rows.push_back(row->second);
+                e.times.push_back(date);
+                e.values.push_back(value);
+            });
+        }
+        catch (const std::exception& err)
+        {
+            errors[t] = err.what();
         }
     }
+    for (const auto& err : errors)
+        if (!err.empty())
+            HANDLE_ERROR_THROW(err + "\n");
+
+    // keep the concepts seen in enough persons
+    vector<std::pair<string, const ConceptEvents*>> concepts;
+    for (size_t t = 0; t < found.size(); ++t)
+    {
+        for (const auto& [concept_id, e] : events[t])
+        {
+            vector<int> persons = e.rows;
+            std::sort(persons.begin(), persons.end());
+            size_t n = std::unique(persons.begin(), persons.end()) - persons.begin();
+            if (n >= min_persons)
+                concepts.push_back({fmt::format("{}_{}", found[t].name, concept_id), &e});
+        }
+    }
+
+    vector<TimeSeriesf> series(concepts.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < int(concepts.size()); ++c)
+        series[c] = make_time_series(*concepts[c].second, person_ids.size());
+    events.clear();
+
+    if (tv == TimeValues::offset)
+    {
+        ArrayXi first = ArrayXi::Constant(person_ids.size(),
+                                          std::numeric_limits<int>::max());
+        for (const auto& s : series)
+            for (size_t i = 0; i < s.size(); ++i)
+                if (s.length(i) > 0)
+                    first(i) = std::min(first(i), s.time(i)(0));
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int c = 0; c < int(series.size()); ++c)
+        {
+            ArrayXi t = *series[c].times;
+            for (size_t i = 0; i < series[c].size(); ++i)
+                t.segment((*series[c].offsets)(i), series[c].length(i)) -= first(i);
+            series[c].times = std::make_shared<const ArrayXi>(std::move(t));
+        }
+    }
+    else if (tv == TimeValues::delta)
+    {
+        #pragma omp parallel for schedule(dynamic)
+        for (int c = 0; c < int(series.size()); ++c)
+        {
+            const ArrayXi& src = *series[c].times;
+            ArrayXi t(src.size());
+            for (size_t i = 0; i < series[c].size(); ++i)
+            {
+                const auto first = (*series[c].offsets)(i);
+                for (auto k = first; k < (*series[c].offsets)(i+1); ++k)
+                    t(k) = (k == first) ? 0 : src(k) - src(k-1);
+            }
+            series[c].times = std::make_shared<const ArrayXi>(std::move(t));
+        }
+    }
+
+    for (size_t c = 0; c < concepts.size(); ++c)
+        features[concepts[c].first] = std::move(series[c]);
 };
 
 OmopData::OmopData(fs::path json_filename) {
 
 };
 
-}
\ No newline at end of file
+Dataset OmopData::get_dataset(const ArrayXf& y, bool c) const
+{
+    if (y.size() != 0 && size_t(y.size()) != get_n_samples())
+        HANDLE_ERROR_THROW(fmt::format("Target has {} entries, but there are {} "
+                                       "persons\n", y.size(), get_n_samples()));
+
+    std::map<string, State> d = features;
+    return Dataset(d, y, c);
+};
+
+}
@@ -12,6 +12,7 @@ license: GNU/GPL v3
 #include <fstream>
 // #include "../../thirdparty/json.hpp"
 #include "nlohmann/json.hpp"
+#include "data.h"
 
 namespace fs = std::filesystem;
 
@@ -20,9 +21,9 @@ namespace Brush::Data
 
 
 enum class TimeValues {
-    offset,
-    delta,
-    timestamp
+    offset,     ///< days since the first observation of the person
+    delta,      ///< days since the previous observation of the same concept
+    timestamp   ///< days since 1970-01-01
 };
 
 enum class StringFeatures {
@@ -30,22 +31,65 @@ enum class StringFeatures {
     onehot
 };
 
+/// where the fields of an event table of the OMOP CDM are. Columns are
+/// 0-based positions in the (header-less) table files.
+struct OmopTable
+{
+    std::string name;       ///< table name, i.e. the file stem
+    int person_col = 1;     ///< column holding person_id
+    int concept_col = 2;    ///< column holding the concept id of the event
+    int date_col = 3;       ///< column holding the event date, as YYYY-MM-DD
+    int value_col = -1;     ///< numeric value of the event. If negative or
+                            ///< empty, the event is recorded as 1.
+};
+
+/// event tables read by default, with the layout of CDM v5.2.
+const std::vector<OmopTable>& default_omop_tables();
+
+/*!
+* @class OmopData
+* @brief per-person time series features built from OMOP CDM tables.
+*
+* Every table is memory-mapped and parsed in its own thread. Each event is
+* joined to its person through a hash table keyed on `person_id`, and
+* appended to the observations of its concept, so the raw tables are never
+* held in memory. Each concept of each table becomes a `TimeSeriesf` feature
+* named `<table>_<concept_id>`, with one sample per person, sorted by time.
+*/
 struct OmopData
 {
     std::string cdm_version;
     TimeValues tv = TimeValues::timestamp;
     StringFeatures sf = StringFeatures::categorical;
 
+    /// concepts observed in fewer persons than this are dropped
+    size_t min_persons = 1;
+
+    /// person ids, in the order of the samples
+    vector<int64_t> person_ids;
+
+    /// time series features, by name
+    std::map<string, State> features;
+
     /// Initialize OMOP Dataset from a directory of CSVs
-    OmopData(fs::directory_iterator omop_dir);
+    OmopData(fs::directory_iterator omop_dir,
+             TimeValues tv = TimeValues::timestamp,
+             size_t min_persons = 1,
+             const vector<OmopTable>& tables = default_omop_tables());
 
     /// Initialize OMOP Dataset from a JSON file
     OmopData(fs::path json_filename);
 
     /// Initialize OMOP Dataset from a SQL database connection
     // TODO
+
+    inline size_t get_n_samples() const { return person_ids.size(); };
+
+    /// dataset with the features of every person, and target `y`
+    /// (one entry per person, in the order of `person_ids`)
+    Dataset get_dataset(const ArrayXf& y = ArrayXf(), bool c = false) const;
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif
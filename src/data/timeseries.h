@@ -11,16 +11,20 @@ namespace Brush::Data{
 /**
  * @brief Stores time series data and implements operators over it.
  * 
- * `TimeSeries` contains two members: `time` and `value`, that have the same shape. 
- * Both are std::vectors of eigen arrays. 
+ * `TimeSeries` uses a compressed sparse row (CSR) layout: all observations 
+ * of all samples live in one flat `values` array, with a matching flat 
+ * `times` array and `offsets` marking where each sample starts. 
+ * Sample `i` spans `[offsets(i), offsets(i+1))` of `values` and `times`. 
  * 
- * Each element of the vector is intended to represent one person / sample. 
- * The values in that element (an Eigen array) are observations of 
- * `value` at time `t`. 
+ * Each sample is intended to represent one person. The values of a sample
+ * are observations of `value` at time `t`. 
+ * 
+ * Elementwise transforms run once over the flat `values` array and share 
+ * `times` and `offsets` with their input, so a chain of transforms never 
+ * copies the time stamps. Reductions are segmented loops over `offsets`.
  * 
  * @tparam T the scalar type of the underlying values. 
  */
-/// 
 template<class T>
 struct TimeSeries
 {
@@ -29,73 +33,136 @@ struct TimeSeries
     using EntryType = Eigen::Array<T,Dynamic,1>;
     using ValType = std::vector<EntryType>;
     using TimeType = std::vector<Eigen::ArrayXi>;
-    /*! Wraps time and value slices to matrices
-    *  TODO: define begin() and end() iterators? figure out how to handle operators that just use values versus time 
-    */
-    TimeSeries() = default; 
+    using OffsetType = Eigen::Array<Eigen::Index,Dynamic,1>;
 
-    TimeType time;
-    ValType value;
+    /// observed values of all samples, back to back
+    EntryType values;
+    /// observation times, aligned with `values`. Shared between transforms.
+    std::shared_ptr<const ArrayXi> times;
+    /// start of each sample in `values`, followed by `values.size()`.
+    std::shared_ptr<const OffsetType> offsets;
 
+    TimeSeries(): times(std::make_shared<const ArrayXi>()),
+                  offsets(std::make_shared<const OffsetType>(OffsetType::Zero(1))) {}; 
+
+    /// construct from one time and one value array per sample
     TimeSeries(const TimeType& t, 
-               const ValType& v): time(t), value(v) {}
-    // array<TimeSeries, 2> TimeSeries::split(const ArrayXb& mask) const ;
+               const ValType& v)
+    {
+        if (t.size() != v.size())
+            HANDLE_ERROR_THROW(fmt::format("TimeSeries has {} time entries "
+                "but {} value entries\n", t.size(), v.size()));
+
+        OffsetType off(v.size()+1);
+        off(0) = 0;
+        for (size_t i = 0; i < v.size(); ++i)
+        {
+            if (t.at(i).size() != v.at(i).size())
+                HANDLE_ERROR_THROW(fmt::format("Sample {} has {} times but "
+                    "{} values\n", i, t.at(i).size(), v.at(i).size()));
+            off(i+1) = off(i) + v.at(i).size();
+        }
+
+        ArrayXi flat_times(off(v.size()));
+        this->values.resize(off(v.size()));
+        for (size_t i = 0; i < v.size(); ++i)
+        {
+            flat_times.segment(off(i), v.at(i).size()) = t.at(i);
+            this->values.segment(off(i), v.at(i).size()) = v.at(i);
+        }
+        this->times = std::make_shared<const ArrayXi>(std::move(flat_times));
+        this->offsets = std::make_shared<const OffsetType>(std::move(off));
+    };
+
+    /// construct from flat arrays, sharing times and offsets
+    TimeSeries(EntryType v, 
+               std::shared_ptr<const ArrayXi> t,
+               std::shared_ptr<const OffsetType> off)
+        : values(std::move(v)), times(std::move(t)), offsets(std::move(off))
+    {
+        if (this->offsets->size() < 1 
+            || (*this->offsets)(this->offsets->size()-1) != this->values.size()
+            || this->times->size() != this->values.size())
+            HANDLE_ERROR_THROW("TimeSeries offsets, times and values do not match\n");
+    };
+
+    /// construct from flat arrays
+    TimeSeries(EntryType v, ArrayXi t, OffsetType off)
+        : TimeSeries(std::move(v), 
+                     std::make_shared<const ArrayXi>(std::move(t)),
+                     std::make_shared<const OffsetType>(std::move(off)))
+    {};
+
     /// return a slice of the data using indices idx
     template<typename U, typename V>
     TimeSeries operator()(const U& idx, const V& idx2=Eigen::all) const
     {
-        TimeType t = Util::slice(this->time, idx);
-        ValType v = Util::slice(this->value, idx); 
-        return TimeSeries(t, v);
+        OffsetType off(std::size(idx)+1);
+        off(0) = 0;
+        Eigen::Index k = 0;
+        for (const auto& i : idx)
+        {
+            off(k+1) = off(k) + length(i);
+            ++k;
+        }
+
+        EntryType v(off(k));
+        ArrayXi t(off(k));
+        k = 0;
+        for (const auto& i : idx)
+        {
+            v.segment(off(k), length(i)) = value(i);
+            t.segment(off(k), length(i)) = time(i);
+            ++k;
+        }
+        return TimeSeries(std::move(v), std::move(t), std::move(off));
+    };
+
+    /// return the contiguous samples [start, start+n), copying each flat array once
+    TimeSeries middleRows(size_t start, size_t n) const
+    {
+        const Eigen::Index first = (*offsets)(start);
+        const Eigen::Index len = (*offsets)(start+n) - first;
+        return TimeSeries(this->values.segment(first, len),
+                          ArrayXi(this->times->segment(first, len)),
+                          OffsetType(this->offsets->segment(start, n+1) - first));
     };
 
-    inline auto size() const -> size_t { return value.size(); };
-    inline auto rows() const -> size_t { return value.size(); };
-    inline auto cols(int i = 0) const -> size_t { return value.at(i).size(); };
+    inline auto size() const -> size_t { return offsets->size()-1; };
+    inline auto rows() const -> size_t { return size(); };
+    inline auto cols(int i = 0) const -> size_t { return length(i); };
+    /// total number of observations across samples
+    inline auto n_values() const -> size_t { return values.size(); };
+    /// number of observations of sample i
+    inline auto length(size_t i) const -> Eigen::Index { 
+        return (*offsets)(i+1) - (*offsets)(i); 
+    };
+    /// values of sample i
+    inline auto value(size_t i) const { return values.segment((*offsets)(i), length(i)); };
+    inline auto value(size_t i) { return values.segment((*offsets)(i), length(i)); };
+    /// times of sample i
+    inline auto time(size_t i) const { return times->segment((*offsets)(i), length(i)); };
     // TODO: from_json and to_json
 
-    // TODO: custom iterator that iterates over pairs of time and value vectors.
-    // for now these only iterate over values.
-    
-    typename ValType::iterator begin() { return this->value.begin(); };
-    typename ValType::iterator end() { return this->value.end(); };
-    auto cbegin() const { return this->value.cbegin(); };
-    auto cend() const { return this->value.cend(); };
-    typename TimeType::iterator tbegin() { return this->time.begin(); };
-    typename TimeType::iterator tend() { return this->time.end(); };
-    auto ctbegin() const { return this->time.cbegin(); };
-    auto ctend() const { return this->time.cend(); };
-    // auto rowwise() const { return this->value.rowwise(); };
-    // auto colwise() const { return this->value.colwise(); };
-    // return std::visit([](auto v){return v.rowwise().end();}, this->value); }
-
-    //TODO: define overloaded operations?
     /* operators on values */
-    /* transform takes a unary function, and applies it to each entry, 
-     * and returns a TimeSeries.
+    /* transform takes a unary function, applies it to the flat values, 
+     * and returns a TimeSeries that shares this one's times and offsets.
     */
     template<typename ET=EntryType>
-    auto transform(std::function<ET(EntryType)> op) const 
+    auto transform(const auto& op) const 
     {
-        std::vector<ET> dest(this->value.size());
-        // std::vector<ET> dest(this->value.size());
-        std::transform(cbegin(), cend(), 
-                       dest.begin(),
-                       op
-        );
-        return TimeSeries<typename ET::Scalar>(this->time, dest);
+        return TimeSeries<typename ET::Scalar>(ET(op(this->values)), 
+                                               this->times, this->offsets);
     }
-    /* reduce takes a unary aggregating function, applies it to each entry, and returns an Array.*/
+    /* reduce takes a unary aggregating function, applies it to each sample, and returns an Array.*/
     template<typename R=T>
     auto reduce(const auto& op) const 
     {
         using RetType = Array<R,Dynamic,1>;
         // output "dest" has one entry for each sample. 
-        RetType dest(this->value.size());
-        std::transform(cbegin(), cend(), 
-                       dest.begin(),
-                       [&](const EntryType& i){return R(op(i));}
-        );
+        RetType dest(this->size());
+        for (size_t i = 0; i < this->size(); ++i)
+            dest(i) = R(op(value(i)));
         return dest;
     };
 
@@ -128,17 +195,17 @@ struct TimeSeries
     inline auto sqrtabs() const { return this->transform([](const EntryType& i){ return i.abs().sqrt(); } ); };
     inline auto square() const { return this->transform([](const EntryType& i){ return i.square(); } ); };
     // reduction overloads
-    inline auto median() const { return this->reduce([](const EntryType& i){ return Util::median(i); } ); };
-    inline auto mean() const { return this->reduce([](const EntryType& i){ return i.mean(); } ); };
-    inline auto std() const { return this->reduce([](const EntryType& i){ return i.std(); } ); };
-    inline auto max() const { return this->reduce([](const EntryType& i){ return i.maxCoeff(); } ); };
-    inline auto min() const { return this->reduce([](const EntryType& i){ return i.minCoeff(); } ); };
-    inline auto sum() const { return this->reduce<Scalar>([](const EntryType& i){ return i.sum(); } ); };
-    inline auto count() const { return this->reduce<float>([](const EntryType& i){ return i.size(); } ); };
-    inline auto prod() const { return this->reduce<Scalar>([](const EntryType& i){ return i.prod(); } ); };
-
-    /* template<typename V=T> */
-    /* enable_if_t<is_same_v<V,float>,TimeSeries<float>> */
+    inline auto median() const { return this->reduce([](const auto& i){ return Util::median(i); } ); };
+    inline auto mean() const { return this->reduce([](const auto& i){ return i.mean(); } ); };
+    inline auto std() const { return this->reduce([](const auto& i){ return i.std(); } ); };
+    inline auto max() const { return this->reduce([](const auto& i){ return i.maxCoeff(); } ); };
+    inline auto min() const { return this->reduce([](const auto& i){ return i.minCoeff(); } ); };
+    inline auto sum() const { return this->reduce<Scalar>([](const auto& i){ return i.sum(); } ); };
+    inline auto count() const { 
+        const auto n = this->size();
+        return ArrayXf((offsets->tail(n) - offsets->head(n)).template cast<float>()); 
+    };
+    inline auto prod() const { return this->reduce<Scalar>([](const auto& i){ return i.prod(); } ); };
 
     template<typename T2> 
     inline auto operator*(T2 v) //requires(is_same_v<Scalar,float>) 
@@ -146,23 +213,82 @@ struct TimeSeries
         return this->transform<EntryType>([=](const EntryType& i){ return i*v; } ); 
     };
 
+    /**
+     * @brief Keep the observations of each sample selected by a sorted merge 
+     * against the observation times of `t2`.
+     * 
+     * Times are assumed to be sorted within each sample. For every observation 
+     * at time `t`, the merge tracks how many observations of `t2` fall at or 
+     * before `t` (`n_le`) and strictly before `t` (`n_lt`), so each sample costs 
+     * O(n+m) for n observations here and m in `t2`.
+     * 
+     * @param t2 the reference time series, with the same number of samples
+     * @param keep predicate `keep(n_le, n_lt, m)` deciding whether to keep an observation
+     * @return a TimeSeries holding the kept observations
+     */
+    template<typename T2>
+    TimeSeries merge_select(const TimeSeries<T2>& t2, const auto& keep) const
+    {
+        if (t2.size() != this->size())
+            HANDLE_ERROR_THROW(fmt::format("Time series have {} and {} samples\n",
+                this->size(), t2.size()));
+
+        EntryType v(this->n_values());
+        ArrayXi t(this->n_values());
+        OffsetType off(this->size()+1);
+        off(0) = 0;
+        Eigen::Index k = 0;
+        for (size_t i = 0; i < this->size(); ++i)
+        {
+            const Eigen::Index first = (*offsets)(i);
+            const Eigen::Index n = length(i);
+            const int* t1 = times->data() + first;
+            const int* ref = t2.times->data() + (*t2.offsets)(i);
+            const Eigen::Index m = t2.length(i);
+
+            Eigen::Index n_lt = 0, n_le = 0;
+            for (Eigen::Index a = 0; a < n; ++a)
+            {
+                while (n_lt < m && ref[n_lt] < t1[a]) 
+                    ++n_lt;
+                n_le = std::max(n_le, n_lt);
+                while (n_le < m && ref[n_le] <= t1[a]) 
+                    ++n_le;
+
+                if (keep(n_le, n_lt, m))
+                {
+                    v(k) = this->values(first+a);
+                    t(k) = t1[a];
+                    ++k;
+                }
+            }
+            off(i+1) = k;
+        }
+        v.conservativeResize(k);
+        t.conservativeResize(k);
+        return TimeSeries(std::move(v), std::move(t), std::move(off));
+    };
+
+    /// return elements of this that occur before the first element of t2
     template<typename T2>
     inline auto before(const TimeSeries<T2>& t2) const { 
-        // return elements of this that are before elements in t2
-        // TODO
-        return (*this); 
+        return merge_select(t2, [](auto n_le, auto n_lt, auto m){ 
+            return m > 0 && n_le == 0; 
+        });
     };
+    /// return elements of this that occur after the last element of t2
     template<typename T2>
     inline auto after(const TimeSeries<T2>& t2) const { 
-        // return elements of this that are after elements in t2
-        // TODO
-        return (*this); 
+        return merge_select(t2, [](auto n_le, auto n_lt, auto m){ 
+            return m > 0 && n_lt == m; 
+        });
     };
+    /// return elements of this that occur within the window spanned by the elements of t2
     template<typename T2>
     inline auto during(const TimeSeries<T2>& t2) const { 
-        // return elements of this that occur within the window in which elements of t2 occur
-        // TODO
-        return (*this); 
+        return merge_select(t2, [](auto n_le, auto n_lt, auto m){ 
+            return n_le > 0 && n_lt < m; 
+        });
     };
 
     std::string print() const
@@ -175,13 +301,13 @@ struct TimeSeries
          * @return ostream& 
          */
         size_t m = 40;
-        size_t max_len = std::min(m, this->value.size()); 
+        size_t max_len = std::min(m, this->size()); 
         string output = "[";
         for (int i = 0; i < max_len; ++i){
-            size_t max_width = std::min(m, size_t(this->value.at(i).size())); 
+            size_t max_width = std::min(m, size_t(this->length(i))); 
             string dots = max_width < m ? "" : "...";
-            auto val = this->value.at(i)(Eigen::seqN(0,max_width));
-            auto t = this->time.at(i)(Eigen::seqN(0,max_width));
+            auto val = this->value(i)(Eigen::seqN(0,max_width));
+            auto t = this->time(i)(Eigen::seqN(0,max_width));
             output += fmt::format("[value: {}{},\n time: {}{}]\n", val, dots, t, dots); 
         }
         output += "]\n";
@@ -168,7 +168,9 @@ void Engine<T>::calculate_stats()
                  med_size,
                  med_complexity,
                  max_size,
-                 max_complexity);
+                 max_complexity,
+                 evaluator.cache->get_hit_rate(),
+                 evaluator.cache->get_bytes_saved());
 }
 
 
@@ -188,7 +190,9 @@ void Engine<T>::log_stats(std::ofstream& log)
             << "med_size"       << sep 
             << "med_complexity" << sep 
             << "max_size"       << sep 
-            << "max_complexity" << "\n";
+            << "max_complexity" << sep
+            << "cache_hit_rate" << sep
+            << "cache_bytes_saved" << "\n";
     }
     log << params.current_gen          << sep
         << timer.Elapsed().count()     << sep
@@ -199,7 +203,9 @@ void Engine<T>::log_stats(std::ofstream& log)
         << stats.med_size.back()       << sep
         << stats.med_complexity.back() << sep
         << stats.max_size.back()       << sep
-        << stats.max_complexity.back() << "\n"; 
+        << stats.max_complexity.back() << sep
+        << stats.cache_hit_rate.back() << sep
+        << stats.cache_bytes_saved.back() << "\n"; 
 }
 
 template <ProgramType T>
@@ -231,6 +237,7 @@ void Engine<T>::print_stats(std::ofstream& log, float fraction)
               << "Val Loss (Med): " << stats.best_score_v.back() << " (" << stats.med_score_v.back() << ")\n"
               << "Median Size (Max): " << stats.med_size.back() << " (" << stats.max_size.back() << ")\n"
               << "Median complexity (Max): " << stats.med_complexity.back() << " (" << stats.max_complexity.back() << ")\n"
+              << "Subtree cache hit rate (bytes saved): " << stats.cache_hit_rate.back() << " (" << stats.cache_bytes_saved.back() << ")\n"
               << "Time (s): " << timer
               <<"\n\n";
 }
@@ -465,8 +472,20 @@ void Engine<T>::run(Dataset &data)
     }
 
     evaluator.set_scorer(params.scorer);
-
-    Dataset &batch = data;
+    // the budget is set before any island runs, since islands read it 
+    // without holding the lock of the cache
+    evaluator.cache->set_max_bytes(size_t(params.subtree_cache_mb) << 20);
+    evaluator.new_generation(); // drop subtree outputs of a previous fit
+
+    // a view over the rows of the current batch. It is materialized the
+    // first time an island evaluates on it, and shared by the others.
+    // Batches are consecutive slices of one permutation per epoch. The
+    // scheduler keeps a pointer to the data, so it lives only as long as run.
+    BatchScheduler batches(data, data.batch_size, 
+                           params.stratify_batch && data.classification,
+                           params.batch_growth);
+    params.set_current_batch_size(batches.get_batch_size());
+    DatasetView batch(data, 0, data.get_n_samples());
 
     int threads;
     if (params.n_jobs == -1)
@@ -538,7 +557,9 @@ void Engine<T>::run(Dataset &data)
         [&](tf::Subflow& subflow) { // loop body (evolutionary main loop)
             auto prepare_gen = subflow.emplace([&]() { 
                 params.set_current_gen(generation);
-                batch = data.get_batch(); // will return the original dataset if it is set to dont use batch 
+                batch = batches.next(); // will return the original dataset if it is set to dont use batch 
+                params.set_current_batch_size(batches.get_batch_size());
+                evaluator.new_generation(); // subtree outputs are cached for one generation
             }).name("prepare generation");// set generation in params, get batch
 
             auto run_generation = subflow.for_each_index(0, this->params.num_islands, 1, [&](int island) {
@@ -683,6 +704,9 @@ void Engine<T>::run(Dataset &data)
 
     executor.run(taskflow);
     executor.wait_for_all();
+
+    // the copies of the partitions are only needed while training
+    data.release_partitions();
     
     //When you have tasks that are created at runtime (e.g., subflow,
     // cudaFlow), you need to execute the graph first to spawn these tasks and dump the entire graph.
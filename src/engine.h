@@ -14,6 +14,7 @@ license: GNU/GPL v3
 #include "pop/population.h"
 #include "pop/archive.h"
 #include "selection/selection.h"
+#include "data/batch.h"
 
 #include "taskflow/taskflow.hpp"
 #include <taskflow/algorithm/for_each.hpp>
@@ -87,11 +88,17 @@ public:
         // Using constructor 2 to create the dataset
         Dataset d(X,y,params.feature_names,{},params.feature_types,
                 params.classification,params.validation_size,
-                params.batch_size, params.shuffle_split);
+                params.batch_size, params.shuffle_split,
+                params.contiguous_split);
         return fit(d);
     };
 
-    auto predict(const Dataset& data) { return this->best_ind.predict(data); };
+    /// predictions use the precision the model was fitted with
+    auto predict(const Dataset& data) 
+    { 
+        Util::FastMath::Scope precision(params.precision);
+        return this->best_ind.predict(data); 
+    };
     auto predict(const Ref<const ArrayXXf>& X)
     {
         Dataset d(X);
@@ -100,7 +107,11 @@ public:
 
     template <ProgramType P = T>
         requires((P == PT::BinaryClassifier) || (P == PT::MulticlassClassifier))
-    auto predict_proba(const Dataset &d) { return this->best_ind.predict_proba(d); };
+    auto predict_proba(const Dataset &d) 
+    { 
+        Util::FastMath::Scope precision(params.precision);
+        return this->best_ind.predict_proba(d); 
+    };
     template <ProgramType P = T>
         requires((P == PT::BinaryClassifier) || (P == PT::MulticlassClassifier))
     auto predict_proba(const Ref<const ArrayXXf>& X) 
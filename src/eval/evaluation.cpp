@@ -16,6 +16,10 @@ void Evaluation<T>::update_fitness(Population<T>& pop,
 {   
     auto indices = pop.get_island_indexes(island);
 
+    // on row tiles, the island is scored as a batch sharing the tiles
+    const bool batch = params.use_tiles(data.get_training_data().get_n_samples());
+    vector<Individual<T>*> inds;
+
     for (unsigned i = 0; i<indices.size(); ++i)
     {
         auto& ind_ptr = pop.individuals.at(indices.at(i));
@@ -42,12 +46,21 @@ void Evaluation<T>::update_fitness(Population<T>& pop,
             // assign weights to individual
             if (fit && ind.get_is_fitted() == false)
             {
-                ind.program.fit(data.get_training_data());
+                DatasetView train = data.get_training_data();
+                NodeOutputs::Scope retain(params.use_retained_outputs());
+                Util::FastMath::Scope precision(params.precision);
+                ind.program.fit(train, params.eval_tile_size);
             }
 
-            assign_fit(ind, data, params, validation);
+            if (batch)
+                inds.push_back(&ind);
+            else
+                assign_fit(ind, data, params, validation);
         }
     }
+
+    if (!inds.empty())
+        assign_fit_batch(inds, data, params, validation);
 }
 
 // assign loss to program
@@ -58,13 +71,27 @@ void Evaluation<T>::assign_fit(Individual<T>& ind, const Dataset& data,
     VectorXf errors;
     using PT = ProgramType;
     
-    Dataset train = data.get_training_data();
+    // views: the partitions are copied at most once per dataset, not once
+    // per individual
+    DatasetView train = data.get_training_data();
+
+    // subtrees shared with other individuals are read from the cache. Row
+    // tiles of the same rows share an id, so their outputs are cached too.
+    SubtreeCache::Scope scope(cache->get_max_bytes() > 0 ? cache.get() : nullptr);
+
+    // programs read the outputs retained by their parents, and retain 
+    // their own for their offspring
+    NodeOutputs::Scope retain(params.use_retained_outputs());
+
+    // operators evaluate with the precision of the parameters
+    Util::FastMath::Scope precision(params.precision);
+
     float f = S.score(ind, train, errors, params);
     ind.error = errors;
 
     float f_v = f;
     if (data.use_validation) {
-        Dataset validation = data.get_validation_data();
+        DatasetView validation = data.get_validation_data();
 
         // when calculating validation score, we should not let
         // it write in errors vector. That would avoid validation data leakage
@@ -75,6 +102,79 @@ void Evaluation<T>::assign_fit(Individual<T>& ind, const Dataset& data,
         //     ind.error = val_errors;
     }
 
+    set_fitness(ind, f, f_v, params, val);
+}
+
+// assign loss to a batch of programs, scored on shared row tiles
+template<ProgramType T> 
+void Evaluation<T>::assign_fit_batch(const vector<Individual<T>*>& inds, 
+                                     const Dataset& data, 
+                                     const Parameters& params, bool val)
+{
+    if (inds.empty())
+        return;
+
+    DatasetView train = data.get_training_data();
+
+    // tiles are windows of the partition with the same ids in every 
+    // generation, so their outputs are cached and retained as in assign_fit
+    SubtreeCache::Scope scope(cache->get_max_bytes() > 0 ? cache.get() : nullptr);
+    NodeOutputs::Scope retain(params.use_retained_outputs());
+    Util::FastMath::Scope precision(params.precision);
+
+    vector<VectorXf> errors;
+    vector<float> f = score_tiles(inds, train, errors, params);
+    for (size_t i = 0; i < inds.size(); ++i)
+        inds[i]->error = std::move(errors[i]);
+
+    vector<float> f_v = f;
+    if (data.use_validation) {
+        DatasetView validation = data.get_validation_data();
+
+        // validation errors are not kept, see assign_fit
+        vector<VectorXf> val_errors;
+        f_v = score_tiles(inds, validation, val_errors, params);
+    }
+
+    for (size_t i = 0; i < inds.size(); ++i)
+        set_fitness(*inds[i], f[i], f_v[i], params, val);
+}
+
+template<ProgramType T> 
+vector<float> Evaluation<T>::score_tiles(const vector<Individual<T>*>& inds, 
+                                         const Dataset& data, 
+                                         vector<VectorXf>& losses,
+                                         const Parameters& params)
+{
+    using RetType = std::decay_t<decltype(S.predict(*inds.front(), data))>;
+    vector<RetType> y_pred(inds.size());
+
+    const size_t tile_size = params.eval_tile_size > 0 ? 
+        params.eval_tile_size : data.get_n_samples();
+    auto& arena = Util::BufferArena::local();
+    Data::DatasetChunks(data).for_each_chunk(std::max<size_t>(tile_size, 1),
+        [&](size_t start, const Dataset& tile){
+            for (size_t i = 0; i < inds.size(); ++i)
+            {
+                RetType part = S.predict(*inds[i], tile);
+                if (start == 0)
+                    y_pred[i].resize(data.get_n_samples(), part.cols());
+                y_pred[i].middleRows(start, part.rows()) = part;
+                arena.release(std::move(part));
+            }
+        });
+
+    vector<float> f(inds.size());
+    losses.resize(inds.size());
+    for (size_t i = 0; i < inds.size(); ++i)
+        f[i] = S.score(data.y, y_pred[i], losses[i], params);
+    return f;
+}
+
+template<ProgramType T> 
+void Evaluation<T>::set_fitness(Individual<T>& ind, float f, float f_v,
+                                const Parameters& params, bool val)
+{
     float error_weight = Individual<T>::weightsMap[params.scorer];
     if (std::isnan(f) || std::isinf(f))
         f = error_weight > 0 ? -MAX_FLT : MAX_FLT;
@@ -8,6 +8,8 @@
 #include "../ind/individual.h"
 #include "../data/data.h"
 #include "scorer.h"
+#include "../program/subtree_cache.h"
+#include "../program/node_outputs.h"
 #include "../pop/population.h"
 
 using std::string;
@@ -27,6 +29,10 @@ template<ProgramType T>
 class Evaluation {
 public:
     Scorer<T> S;
+
+    /// outputs of the subtrees shared by the individuals of a generation.
+    /// Copies of the evaluator share it.
+    std::shared_ptr<SubtreeCache> cache = std::make_shared<SubtreeCache>();
     /**
      * @brief Constructor for Evaluation class.
      * @details Initializes the scorer based on the program type.
@@ -59,6 +65,9 @@ public:
      * @return The current scorer.
      */
     string get_scorer(){return this->S.get_scorer();};
+
+    /// @brief Drops the subtree outputs of the previous generation.
+    void new_generation(){ this->cache->clear(); };
     
     /**
      * @brief Update the fitness of individuals in a population.
@@ -87,7 +96,38 @@ public:
     void assign_fit(Individual<T>& ind, const Dataset& data,
                     const Parameters& params, bool val=false);
 
+    /**
+     * @brief Assign fitness to a batch of individuals, such as an island,
+     * evaluating them together on row tiles of the data.
+     * @details Tiles are windows that read the rows of the data in place,
+     * so no features are copied. Every individual is evaluated on a tile 
+     * while its rows are in cache, before moving on to the next one.
+     * The fitness is the same as the one assigned by assign_fit on each
+     * individual. See Parameters::eval_tile_size.
+     * @param inds The individuals to assign fitness to.
+     * @param data The dataset for evaluation.
+     * @param params The parameters for evaluation.
+     * @param val Flag indicating whether it is validation fitness.
+     */
+    void assign_fit_batch(const vector<Individual<T>*>& inds, const Dataset& data,
+                          const Parameters& params, bool val=false);
+
     // representation program (TODO: implement)
+
+private:
+    /// scores `inds` on row tiles of `data` shared by all of them, filling
+    /// `losses` with the loss of each sample. The terminals of every program
+    /// read the columns of the tile in place, so the rows are loaded once
+    /// per tile rather than copied per program. Since some scorers are not
+    /// sums over samples, the predictions of every individual are gathered
+    /// before scoring, which takes as much memory as the losses they keep.
+    vector<float> score_tiles(const vector<Individual<T>*>& inds, 
+                              const Dataset& data, vector<VectorXf>& losses,
+                              const Parameters& params);
+
+    /// sets the fitness of `ind` from its training and validation scores
+    void set_fitness(Individual<T>& ind, float f, float f_v,
+                     const Parameters& params, bool val);
 };
 
 extern template class Evaluation<PT::Regressor>;
@@ -3,6 +3,7 @@
 
 #include "metrics.h"
 #include "../util/error.h"
+#include "../util/arena.h"
 #include "../types.h"
 
 // code to evaluate GP programs.
@@ -60,11 +61,44 @@ public:
         }
     };
 
-    float score(Individual<P>& ind, Dataset& data, 
+    float score(Individual<P>& ind, const Dataset& data, 
                 VectorXf& loss, const Parameters& params)
     {
+        // row tiles keep the intermediate outputs of the program in cache
+        if (params.use_tiles(data.get_n_samples()))
+            return score(ind, ind.program.tiles(data), params.eval_tile_size, 
+                         loss, params);
+
         RetType y_pred = ind.predict(data);
-        return score(data.y, y_pred, loss, params.class_weights);
+        float f = score(data.y, y_pred, loss, params.class_weights);
+
+        // the prediction is the output buffer of the program, which the 
+        // next program evaluated by this thread can reuse
+        Util::BufferArena::local().release(std::move(y_pred));
+        return f;
+    }
+
+    /// scores `ind` on row blocks of `source`. Predictions are gathered
+    /// block by block, so the score and loss are the same as on the whole
+    /// dataset, while only one block of features is in memory at a time.
+    float score(Individual<P>& ind, const ChunkSource& source, size_t chunk_size,
+                VectorXf& loss, const Parameters& params)
+    {
+        RetType y_pred = ind.predict(source, chunk_size);
+        return score(source.get_y(), y_pred, loss, params);
+    }
+
+    /// the predictions of `ind` that are scored, on a block of rows
+    RetType predict(Individual<P>& ind, const Dataset& block)
+    {
+        return ind.predict(block);
+    }
+
+    /// scores predictions gathered from blocks of rows with `predict`
+    float score(const ArrayXf& y, const RetType& y_pred, VectorXf& loss,
+                const Parameters& params)
+    {
+        return score(y, y_pred, loss, params.class_weights);
     }
 };
 
@@ -116,11 +150,43 @@ public:
         }
     };
 
-    float score(Individual<P>& ind, Dataset& data, 
+    float score(Individual<P>& ind, const Dataset& data, 
                 VectorXf& loss, const Parameters& params)
     {
+        if (params.use_tiles(data.get_n_samples()))
+            return score(ind, ind.program.tiles(data), params.eval_tile_size, 
+                         loss, params);
+
         RetType y_pred = ind.predict_proba(data); // .template cast<float>();
         
+        float f = score(data.y, y_pred, loss, get_class_weights(data.y, params));
+        Util::BufferArena::local().release(std::move(y_pred));
+        return f;
+    }
+
+    /// scores `ind` on row blocks of `source`, see Scorer::score.
+    float score(Individual<P>& ind, const ChunkSource& source, size_t chunk_size,
+                VectorXf& loss, const Parameters& params)
+    {
+        RetType y_pred = ind.predict_proba(source, chunk_size);
+        return score(source.get_y(), y_pred, loss, params);
+    }
+
+    /// the predictions of `ind` that are scored, on a block of rows
+    RetType predict(Individual<P>& ind, const Dataset& block)
+    {
+        return ind.predict_proba(block);
+    }
+
+    /// scores predictions gathered from blocks of rows with `predict`
+    float score(const ArrayXf& y, const RetType& y_pred, VectorXf& loss,
+                const Parameters& params)
+    {
+        return score(y, y_pred, loss, get_class_weights(y, params));
+    }
+
+    vector<float> get_class_weights(const ArrayXf& y, const Parameters& params)
+    {
         vector<float> class_weights = {};
 
         // calculate class weights based on current data --- instead of using a pre-calculated value.
@@ -131,12 +197,12 @@ public:
             class_weights.resize(params.n_classes);
             for (unsigned i = 0; i < params.n_classes; ++i){
                 // weighting by support 
-                int support = (data.y.cast<int>().array() == i).count();
+                int support = (y.cast<int>().array() == i).count();
 
                 if (support==0)
                     class_weights.at(i) = 0.0f;
                 else
-                    class_weights.at(i) = float(data.y.size()) / float(params.n_classes * support);
+                    class_weights.at(i) = float(y.size()) / float(params.n_classes * support);
             }
         }
         else // else it is either unbalanced or user_defined
@@ -146,7 +212,7 @@ public:
             class_weights = params.class_weights;
         }
         
-        return score(data.y, y_pred, loss, class_weights);
+        return class_weights;
     }
 };
 
@@ -199,30 +265,62 @@ public:
         }
     };
 
-    float score(Individual<P>& ind, Dataset& data, 
+    float score(Individual<P>& ind, const Dataset& data, 
                 VectorXf& loss, const Parameters& params)
     {
+        if (params.use_tiles(data.get_n_samples()))
+            return score(ind, ind.program.tiles(data), params.eval_tile_size, 
+                         loss, params);
+
         RetType y_pred = ind.predict_proba(data); // .template cast<float>();
         
+        float f = score(data.y, y_pred, loss, get_class_weights(data.y, params));
+        Util::BufferArena::local().release(std::move(y_pred));
+        return f;
+    }
+
+    /// scores `ind` on row blocks of `source`, see Scorer::score.
+    float score(Individual<P>& ind, const ChunkSource& source, size_t chunk_size,
+                VectorXf& loss, const Parameters& params)
+    {
+        RetType y_pred = ind.predict_proba(source, chunk_size);
+        return score(source.get_y(), y_pred, loss, params);
+    }
+
+    /// the predictions of `ind` that are scored, on a block of rows
+    RetType predict(Individual<P>& ind, const Dataset& block)
+    {
+        return ind.predict_proba(block);
+    }
+
+    /// scores predictions gathered from blocks of rows with `predict`
+    float score(const ArrayXf& y, const RetType& y_pred, VectorXf& loss,
+                const Parameters& params)
+    {
+        return score(y, y_pred, loss, get_class_weights(y, params));
+    }
+
+    vector<float> get_class_weights(const ArrayXf& y, const Parameters& params)
+    {
         vector<float> class_weights = {};
         if (params.class_weights_type == "support")
         {
             class_weights.resize(params.n_classes);
             for (unsigned i = 0; i < params.n_classes; ++i){
                 // weighting by support 
-                int support = (data.y.cast<int>().array() == i).count();
+                int support = (y.cast<int>().array() == i).count();
 
                 if (support==0)
                     class_weights.at(i) = 0.0;
                 else
-                    class_weights.at(i) = float(data.y.size()) / float(params.n_classes * support);
+                    class_weights.at(i) = float(y.size()) / float(params.n_classes * support);
             }
         } // or else it is either unbalanced or user_defined
         else {
             class_weights = params.class_weights;
         }
 
-        return score(data.y, y_pred, loss, class_weights);
+        return class_weights;
     }
 };
 
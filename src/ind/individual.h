@@ -119,6 +119,18 @@ public:
         return predict_proba(d);
     };
 
+    /// chunked predictions, see Program::predict(source, chunk_size).
+    auto predict(const ChunkSource& source, size_t chunk_size)
+    {
+        return program.predict(source, chunk_size);
+    };
+    template <ProgramType P = T>
+        requires((P == PT::BinaryClassifier) || (P == PT::MulticlassClassifier))
+    auto predict_proba(const ChunkSource& source, size_t chunk_size)
+    {
+        return program.predict_proba(source, chunk_size);
+    };
+
     // just getters
     unsigned int get_size() const { return program.size(); };
     unsigned int get_depth() const { return program.depth(); };
@@ -28,6 +28,10 @@ public:
 
     unsigned int current_gen = 1;
 
+    /// fraction of the training rows in the batches of the current
+    /// generation, set by the engine from its BatchScheduler
+    float current_batch_size = 1.0;
+
     // termination criteria
     int pop_size  = 100;
     int max_gens  = 100;
@@ -77,10 +81,13 @@ public:
 
     // validation partition
     bool shuffle_split = false;
+    bool contiguous_split = false; ///< store train/validation rows as contiguous blocks of a copy of the rows, which doubles the memory held by the dataset. The dataset keeps its rows in their original order
     float validation_size = 0.2;
     vector<string> feature_names = {};
     vector<string> feature_types = {};
     float batch_size = 0.0;
+    bool stratify_batch = false; ///< keep class proportions in each batch (classification only)
+    float batch_growth = 1.0;    ///< batch size multiplier applied at every new epoch
     bool weights_init=true;
 
     string load_population = "";
@@ -88,6 +95,11 @@ public:
 
     string logfile = "";
 
+    unsigned int eval_tile_size = 0; ///< rows evaluated at a time when scoring and fitting weights. 0 evaluates all rows at once
+    unsigned int subtree_cache_mb = 0; ///< memory budget, in MB, of the outputs of subtrees shared by the programs of a generation. 0 disables the cache
+    bool retain_outputs = false; ///< keep the node outputs of each program, so that offspring only evaluate the nodes variation changed. Costs one array per internal node and dataset
+    string precision = "exact"; ///< "exact" evaluates transcendental operators with Eigen, "fast" with vectorized approximations accurate to a few ulp. See Util::FastMath
+
     int n_jobs = 1; ///< number of parallel jobs -1 use all threads; 0 use same as number of islands; positive number specify the amouut of threads
 
     Parameters(){}; 
@@ -131,6 +143,9 @@ public:
     void set_current_gen(unsigned int gen){ current_gen = gen; };
     unsigned int get_current_gen(){ return current_gen; };
 
+    void set_current_batch_size(float b){ current_batch_size = b; };
+    float get_current_batch_size(){ return current_batch_size; };
+
     // TODO: improve vary_and_update to have island working in parallel 
     void set_num_islands(int new_num_islands){ num_islands = new_num_islands; };
     int get_num_islands(){ return num_islands; };
@@ -179,6 +194,9 @@ public:
     void set_shuffle_split(bool shuff){ shuffle_split = shuff; };
     bool get_shuffle_split(){ return shuffle_split; };
 
+    void set_contiguous_split(bool contiguous){ contiguous_split = contiguous; };
+    bool get_contiguous_split(){ return contiguous_split; };
+
     void set_constants_simplification(bool cs){ constants_simplification = cs; };
     bool get_constants_simplification(){ return constants_simplification; };
     
@@ -262,6 +280,45 @@ public:
     void set_batch_size(float c){ batch_size = c; };
     float get_batch_size(){ return batch_size; };
 
+    void set_stratify_batch(bool s){ stratify_batch = s; };
+    bool get_stratify_batch(){ return stratify_batch; };
+
+    void set_batch_growth(float g){ batch_growth = g; };
+    float get_batch_growth(){ return batch_growth; };
+
+    void set_eval_tile_size(unsigned int t){ eval_tile_size = t; };
+    unsigned int get_eval_tile_size(){ return eval_tile_size; };
+
+    void set_subtree_cache_mb(unsigned int m){ subtree_cache_mb = m; };
+    unsigned int get_subtree_cache_mb(){ return subtree_cache_mb; };
+
+    void set_retain_outputs(bool r){ retain_outputs = r; };
+    bool get_retain_outputs(){ return retain_outputs; };
+
+    void set_precision(string p){ 
+        if (p != "exact" && p != "fast")
+            HANDLE_ERROR_THROW("precision must be \"exact\" or \"fast\", not \""
+                               + p + "\"\n");
+        precision = p; 
+    };
+    string get_precision(){ return precision; };
+
+    /// whether programs are evaluated on row tiles of `n_samples` rows
+    /// rather than at once
+    bool use_tiles(size_t n_samples) const { 
+        return eval_tile_size > 0 && n_samples > eval_tile_size; 
+    };
+
+    /// whether programs retain their node outputs. Mini-batches are 
+    /// temporary datasets, so outputs are not retained while the batches of
+    /// the current generation cover only part of the training rows. Row 
+    /// tiles are windows with the same id in every evaluation, so their 
+    /// outputs are.
+    bool use_retained_outputs() const {
+        return retain_outputs
+            && !(current_batch_size > 0.0 && current_batch_size < 1.0);
+    };
+
     void set_mutation_probs(std::map<std::string, float> new_mutation_probs){ mutation_probs = new_mutation_probs; };
     std::map<std::string, float> get_mutation_probs(){ return mutation_probs; };
 
@@ -311,16 +368,24 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Parameters,
     start_from_decision_trees,
 
     shuffle_split,
+    contiguous_split,
     validation_size,
     feature_names,
     feature_types,
     batch_size,
+    stratify_batch,
+    batch_growth,
     weights_init,
 
     load_population,
     save_population,
 
     logfile,
+
+    eval_tile_size,
+    subtree_cache_mb,
+    retain_outputs,
+    precision,
     
     n_jobs
 );
@@ -0,0 +1,528 @@
+/* Brush
+copyright 2020 William La Cava
+license: GNU/GPL v3
+*/
+#ifndef COMPILED_PROGRAM_H
+#define COMPILED_PROGRAM_H
+
+#include "../init.h"
+#include "../data/data.h"
+#include "tree_node.h"
+#include "dispatch_table.h"
+#include "subtree_cache.h"
+#include "node_outputs.h"
+#include "fused_group.h"
+#include "../util/arena.h"
+
+namespace Brush {
+
+/**
+ * @brief A tree flattened into a postfix array of instructions.
+ *
+ * Each instruction holds the kernel of its node, resolved once from the
+ * dispatch table, and the slot its output is written to. The children of a
+ * node write to consecutive slots starting at the slot of their parent, so
+ * running the instructions in order evaluates the tree without recursion,
+ * sibling walks or table lookups.
+ *
+ * Split nodes evaluate their children on partitions of the data, so a split
+ * is a single instruction that evaluates its subtree recursively.
+ *
+ * When a SubtreeCache is active on the calling thread, predictions with the
+ * node weights read the outputs of cached subtrees instead of running their
+ * instructions, and store the outputs the cache asks for.
+ *
+ * Likewise, when NodeOutputs are active, runs with the node weights read the
+ * outputs retained by the program, which a child shares with its parent,
+ * and predictions retain the outputs of their own nodes in their place.
+ * Fitting reads them too: the fit of an unchanged subtree on the same data
+ * sets its nodes as they already are, and outputs what the parent predicted.
+ *
+ * Predictions fuse the maximal subtrees of elementwise operators on float
+ * arrays into groups, which are evaluated tile by tile (see FusedGroup)
+ * rather than node by node, so that only their roots write out an array.
+ * Their nodes are skipped, and the outputs of the instructions they read
+ * are handed over to the group. A cached run only fuses a group if every
+ * one of its nodes runs, and no group when it retains outputs.
+ *
+ * Instructions point into the tree they were compiled from. `run` compiles
+ * the tree when there are no instructions, and reuses them otherwise, so 
+ * whoever edits the tree must clear() them (see Program::tree_changed).
+ * Copies start out empty, with the settings of the copied program.
+ *
+ * @tparam Fit true: fit, false: predict
+ * @tparam W the weight type. fJet evaluates the dual signatures, as done by
+ * the weight optimizer.
+ */
+template<bool Fit, typename W=float>
+class CompiledProgram
+{
+public:
+    using Kernel = typename DispatchTable<Fit>::template Kernel<W>;
+
+    struct Instruction
+    {
+        Kernel kernel;
+        TreeNode* node;
+        /// slot of the output. The i-th child writes to slot+i.
+        size_t slot;
+        /// first instruction of the subtree of the node
+        size_t begin;
+        /// number of nodes in the subtree of the node
+        size_t n_nodes;
+    };
+
+    CompiledProgram() = default;
+    /// copies keep the settings of `other`, but not its instructions, 
+    /// which point into the tree of `other`
+    CompiledProgram(const CompiledProgram& other) : fuse(other.fuse) {};
+    CompiledProgram(CompiledProgram&& other) = default;
+    CompiledProgram& operator=(const CompiledProgram& other)
+    {
+        clear();
+        fuse = other.fuse;
+        return *this;
+    };
+    CompiledProgram& operator=(CompiledProgram&& other) = default;
+
+    /// @brief flattens the tree into instructions.
+    void compile(tree<Node>& t)
+    {
+        clear();
+        if (t.empty())
+            return;
+
+        emit(t.begin().node, 0);
+
+        if constexpr (!Fit && is_same_v<W, float>)
+        {
+            if (fuse)
+                fuse_groups();
+        }
+    };
+
+    /// @brief whether the tree was compiled since the last clear().
+    inline bool is_compiled() const { return !code.empty(); };
+
+    /**
+     * @brief evaluates the tree on the data, compiling it first if it
+     * was not compiled since the last clear().
+     *
+     * @tparam T output type of the tree
+     * @param t the tree
+     * @param d dataset
+     * @param weights optional pointer to a weight array, used in place of node weights
+     * @param outputs optional outputs retained by the program. They are read 
+     * and, on predictions, replaced when NodeOutputs are active.
+     * @return output of the root of the tree
+     */
+    template<typename T>
+    T run(tree<Node>& t, const Dataset& d, const W** weights=nullptr,
+          std::shared_ptr<const NodeOutputs>* outputs=nullptr)
+    {
+        if (code.empty())
+            compile(t);
+
+        // slots are kept between runs, so that they are not reallocated.
+        // Their buffers come from the arena of the thread.
+        slots.resize(n_slots);
+
+        SubtreeCache* cache = nullptr;
+        const NodeOutputs* inherited = nullptr;
+        std::shared_ptr<NodeOutputs> retained;
+        if constexpr (is_same_v<W, float>)
+        {
+            if (weights == nullptr)
+            {
+                if constexpr (!Fit)
+                    cache = SubtreeCache::active();
+
+                if (outputs != nullptr && NodeOutputs::active())
+                {
+                    inherited = outputs->get();
+                    if constexpr (!Fit)
+                        retained = std::make_shared<NodeOutputs>();
+                }
+            }
+        }
+
+        n_loaded = 0;
+        n_fused = 0;
+        if (cache != nullptr || inherited != nullptr || retained != nullptr)
+        {
+            run_cached(cache, inherited, retained.get(), d);
+            if (retained != nullptr)
+                *outputs = std::move(retained);
+        }
+        else if (weights == nullptr && !groups.empty())
+        {
+            for (size_t i = 0; i < code.size(); ++i)
+                run_fused(i, d);
+        }
+        else
+        {
+            for (const auto& instr : code)
+                instr.kernel(d, *instr.node, slots.data() + instr.slot, weights);
+        }
+
+        if (!std::holds_alternative<T>(slots.at(0)))
+            HANDLE_ERROR_THROW(fmt::format("Tried to run a program returning {} "
+                "as one returning {}\n",
+                Data::StateType(slots.at(0)), DataTypeEnum<T>::value));
+
+        return std::get<T>(std::move(slots.at(0)));
+    };
+
+    /// @brief number of instructions
+    inline size_t size() const { return code.size(); };
+    /// @brief number of slots needed to run the instructions
+    inline size_t get_n_slots() const { return n_slots; };
+    /// @brief number of nodes the last run read from cached or retained
+    /// outputs rather than evaluated
+    inline size_t get_n_loaded() const { return n_loaded; };
+    /// @brief number of nodes the last run evaluated in fused groups
+    inline size_t get_n_fused() const { return n_fused; };
+    /// @brief the fused groups of predictions
+    inline const vector<FusedGroup>& get_groups() const { return groups; };
+
+    /// @brief whether predictions fuse elementwise operators. Instructions
+    /// are compiled again on the next run.
+    void set_fuse(bool f)
+    {
+        fuse = f;
+        clear();
+    };
+    inline bool get_fuse() const { return fuse; };
+    inline const vector<Instruction>& get_instructions() const { return code; };
+
+    /// @brief drops the instructions, so that the tree is compiled again on 
+    /// the next run.
+    void clear()
+    {
+        code.clear();
+        slots.clear();
+        hashes.clear();
+        groups.clear();
+        fusion.clear();
+        n_slots = 0;
+        n_loaded = 0;
+        n_fused = 0;
+    };
+
+private:
+    vector<Instruction> code;
+    vector<Data::State> slots;
+    size_t n_slots = 0;
+    size_t n_loaded = 0;
+    size_t n_fused = 0;
+    bool fuse = true;
+
+    /// the part an instruction plays in the fused groups
+    struct Fusion
+    {
+        enum Role : char { None, Root, Member, Input };
+        Role role = None;
+        uint32_t group = 0;
+        /// index of the input, for inputs
+        uint32_t input = 0;
+    };
+    vector<FusedGroup> groups;
+    vector<Fusion> fusion;
+    /// whether a cached run fuses each group
+    vector<char> fused;
+
+    /// what a cached run does with an instruction
+    enum class Action : char { Run, Store, Load, Skip };
+
+    // state of cached runs, kept between runs like the slots
+    vector<std::size_t> hashes;
+    vector<std::size_t> hash_stack;
+    vector<Action> actions;
+    vector<std::shared_ptr<const SubtreeCache::Entry>> hits;
+
+    static inline std::size_t get_sig_hash(const Node& n)
+    {
+        if constexpr (is_same_v<W, fJet>)
+            return n.sig_dual_hash;
+        else
+            return n.sig_hash;
+    };
+
+    static inline Kernel get_kernel(const Node& n)
+    {
+        if constexpr (Fit)
+            return dtable_fit.template GetKernel<W>(n.node_type, get_sig_hash(n));
+        else
+            return dtable_predict.template GetKernel<W>(n.node_type, get_sig_hash(n));
+    };
+
+    /// emits the instructions of the subtree at `tn`, in postfix order.
+    /// Returns the number of nodes of the subtree.
+    size_t emit(TreeNode* tn, size_t slot)
+    {
+        const auto& n = tn->data;
+        const size_t begin = code.size();
+        size_t n_nodes = 1;
+        if (Isnt<NodeType::SplitOn, NodeType::SplitBest>(n.node_type))
+        {
+            TreeNode* sib = tn->first_child;
+            for (size_t i = 0; i < n.get_arg_count(); ++i)
+            {
+                if (sib == nullptr)
+                    HANDLE_ERROR_THROW("bad sibling ptr in compile");
+                n_nodes += emit(sib, slot + i);
+                sib = sib->next_sibling;
+            }
+        }
+        else
+            n_nodes = SubtreeCache::subtree_size(tn);
+
+        n_slots = std::max(n_slots, slot + 1);
+        code.push_back({get_kernel(n), tn, slot, begin, n_nodes});
+        return n_nodes;
+    };
+
+    /// @brief the instructions of the arguments of instruction `i`, in
+    /// order. The last one precedes `i`, and each one is preceded by the 
+    /// subtree of the previous one.
+    vector<size_t> get_args(size_t i) const
+    {
+        vector<size_t> args(code[i].node->data.get_arg_count());
+        size_t j = i;
+        for (size_t a = args.size(); a-- > 0; )
+        {
+            args[a] = j - 1;
+            j = code[j - 1].begin;
+        }
+        return args;
+    };
+
+    /// @brief groups the maximal subtrees of nodes that can be fused. A
+    /// group starts at a node that can be fused below one that can not, and
+    /// spans the nodes under it that can. A node whose arguments can not be
+    /// fused is left to its kernel.
+    void fuse_groups()
+    {
+        fusion.assign(code.size(), {});
+        for (size_t i = code.size(); i-- > 0; )
+        {
+            if (fusion[i].role != Fusion::None
+            ||  !FusedGroup::is_fusable(code[i].node->data))
+                continue;
+
+            const auto args = get_args(i);
+            if (std::none_of(args.begin(), args.end(), [&](size_t a){
+                    return FusedGroup::is_fusable(code[a].node->data); }))
+                continue;
+
+            groups.emplace_back();
+            add_to_group(i, groups.size() - 1);
+            fusion[i].role = Fusion::Root;
+        }
+        if (groups.empty())
+            fusion.clear();
+    };
+
+    /// @brief adds the subtree of instruction `i` to group `g`, in postfix
+    /// order. Nodes that can not be fused are inputs of the group.
+    void add_to_group(size_t i, uint32_t g)
+    {
+        if (!FusedGroup::is_fusable(code[i].node->data))
+        {
+            fusion[i] = {Fusion::Input, g, uint32_t(groups[g].push_input())};
+            return;
+        }
+        for (size_t a : get_args(i))
+            add_to_group(a, g);
+        groups[g].push_node(code[i].node);
+        fusion[i] = {Fusion::Member, g, 0};
+    };
+
+    inline void run_group(uint32_t g, const Dataset& d, Data::State* out)
+    {
+        groups[g].run(d, out);
+        n_fused += groups[g].size();
+    };
+
+    /// @brief hands the output of instruction `i` over to its group, so that
+    /// the instructions that run before the group do not overwrite it
+    inline void hand_over(size_t i)
+    {
+        const auto& f = fusion[i];
+        groups[f.group].input(f.input) = 
+            std::get<ArrayXf>(std::move(slots[code[i].slot]));
+    };
+
+    /// @brief runs instruction `i` with its groups fused
+    void run_fused(size_t i, const Dataset& d)
+    {
+        const auto& instr = code[i];
+        switch (fusion[i].role)
+        {
+        case Fusion::Member:
+            break;
+        case Fusion::Root:
+            run_group(fusion[i].group, d, slots.data() + instr.slot);
+            break;
+        case Fusion::Input:
+            instr.kernel(d, *instr.node, slots.data() + instr.slot, nullptr);
+            hand_over(i);
+            break;
+        case Fusion::None:
+            instr.kernel(d, *instr.node, slots.data() + instr.slot, nullptr);
+            break;
+        }
+    };
+
+    /**
+     * @brief runs the instructions, reading the outputs of subtrees from the
+     * outputs inherited by the program or from the generation cache rather
+     * than running their instructions.
+     *
+     * The subtrees are looked up from the root down, so that a hit skips
+     * every subtree below it. Leaves are not looked up, since reading them
+     * costs as much as a copy.
+     *
+     * @param cache the generation cache, or null
+     * @param inherited outputs retained by the program, or null
+     * @param retained if not null, receives the outputs of the nodes of this
+     * run, and the inherited outputs on other datasets
+     * @param d dataset
+     */
+    void run_cached(SubtreeCache* cache, const NodeOutputs* inherited, 
+                    NodeOutputs* retained, const Dataset& d)
+    {
+        const size_t n = code.size();
+
+        // structural hashes, bottom-up. The hashes of the children of an
+        // instruction are the last ones on the stack. Splits are a single
+        // instruction, and hash their subtree.
+        hashes.resize(n);
+        auto& stack = hash_stack;
+        stack.clear();
+        for (size_t i = 0; i < n; ++i)
+        {
+            const TreeNode* tn = code[i].node;
+            std::size_t h;
+            if (Is<NodeType::SplitOn, NodeType::SplitBest>(tn->data.node_type))
+                h = SubtreeCache::subtree_hash(tn);
+            else
+            {
+                h = SubtreeCache::node_hash(tn->data);
+                const size_t first_arg = stack.size() - tn->data.get_arg_count();
+                for (size_t a = first_arg; a < stack.size(); ++a)
+                    h = SubtreeCache::combine(h, stack[a]);
+                stack.resize(first_arg);
+            }
+            stack.push_back(h);
+            hashes[i] = h;
+        }
+
+        if (retained != nullptr && inherited != nullptr)
+            retained->keep_others(*inherited, d);
+
+        // lookups, from the root down. In postfix order, the instruction 
+        // before a subtree is the root of the previous sibling, or of one 
+        // of its descendants.
+        actions.assign(n, Action::Run);
+        hits.assign(n, nullptr);
+        for (size_t i = n; i-- > 0; )
+        {
+            const auto& instr = code[i];
+            if (instr.n_nodes < 2)
+                continue;
+
+            bool store = false;
+            if (inherited != nullptr)
+                hits[i] = inherited->find(hashes[i], instr.node, d);
+            if (hits[i] == nullptr && cache != nullptr)
+                hits[i] = cache->find(hashes[i], instr.node, d, store);
+
+            if (hits[i] != nullptr)
+            {
+                std::fill(actions.begin() + instr.begin, actions.begin() + i, 
+                          Action::Skip);
+                actions[i] = Action::Load;
+                n_loaded += instr.n_nodes;
+
+                // the outputs below a hit are not needed by this run, but 
+                // they are by children that change the subtree
+                if (retained != nullptr)
+                    retained->insert(hashes[i], hits[i]);
+                if (retained != nullptr && inherited != nullptr)
+                {
+                    for (size_t j = instr.begin; j < i; ++j)
+                        if (code[j].n_nodes > 1)
+                            retained->insert(hashes[j],
+                                inherited->find(hashes[j], code[j].node, d));
+                }
+                i = instr.begin;
+            }
+            else if (store)
+                actions[i] = Action::Store;
+        }
+
+        // groups are fused when all of their nodes run
+        fused.assign(groups.size(), retained == nullptr);
+        for (size_t i = 0; i < fusion.size(); ++i)
+        {
+            const auto& f = fusion[i];
+            if ((f.role == Fusion::Member && actions[i] != Action::Run)
+            ||  (f.role == Fusion::Root && actions[i] != Action::Run
+                                        && actions[i] != Action::Store))
+                fused[f.group] = false;
+        }
+
+        auto& arena = Util::BufferArena::local();
+        for (size_t i = 0; i < n; ++i)
+        {
+            const auto& instr = code[i];
+            Data::State* out = slots.data() + instr.slot;
+            const auto role = fusion.empty() || !fused[fusion[i].group] ?
+                              Fusion::None : fusion[i].role;
+            if (role == Fusion::Member)
+                continue;
+
+            switch (actions[i])
+            {
+            case Action::Skip:
+                break;
+            case Action::Load:
+                std::visit([&](const auto& cached) {
+                    using R = std::decay_t<decltype(cached)>;
+                    if constexpr (Util::is_arena_buffer_v<R>)
+                    {
+                        R buf = arena.template acquire<R>(cached.rows());
+                        buf = cached;
+                        out->template emplace<R>(std::move(buf));
+                    }
+                    else
+                        *out = cached;
+                }, hits[i]->output);
+                break;
+            case Action::Run:
+            case Action::Store:
+                if (role == Fusion::Root)
+                    run_group(fusion[i].group, d, out);
+                else
+                    instr.kernel(d, *instr.node, out, nullptr);
+                if (actions[i] == Action::Store 
+                || (retained != nullptr && instr.n_nodes > 1))
+                {
+                    auto entry = SubtreeCache::make_entry(instr.node, d, *out);
+                    if (actions[i] == Action::Store)
+                        cache->insert(hashes[i], entry);
+                    if (retained != nullptr)
+                        retained->insert(hashes[i], std::move(entry));
+                }
+                break;
+            }
+            if (role == Fusion::Input)
+                hand_over(i);
+        }
+        hits.clear();
+    };
+};
+
+} // Brush
+#endif
@@ -0,0 +1,269 @@
+#include "cpp_model.h"
+
+namespace Brush {
+
+namespace {
+
+/// a float literal that reads back as the same float
+string literal(float w)
+{
+    if (std::isnan(w))
+        return "std::numeric_limits<float>::quiet_NaN()";
+    if (std::isinf(w))
+        return w > 0 ? "std::numeric_limits<float>::infinity()"
+                     : "-std::numeric_limits<float>::infinity()";
+
+    string s = fmt::format("{}", w);
+    if (s.find_first_of(".e") == string::npos)
+        s += ".0";
+    return s + "f";
+}
+
+string scalar_type(DataType dt, const Node& n)
+{
+    switch (dt) {
+        case DataType::ArrayF: return "float";
+        case DataType::ArrayI: return "int";
+        case DataType::ArrayB: return "bool";
+        default:
+            HANDLE_ERROR_THROW(fmt::format("Can't export {} to C++: only "
+                "nodes on arrays are supported, not {}", n.get_name(false), dt));
+    }
+    return "";
+}
+
+/// the C++ code of the body of the loop over the rows
+struct Emitter
+{
+    /// features read by the program, in order of appearance
+    vector<string> features;
+    /// statements of the loop
+    string body;
+    int n_vars = 0;
+    bool uses_median = false;
+
+    /// the expression of feature `f` at row i, as a value of type `dt`
+    string feature(const string& f, DataType dt)
+    {
+        auto it = std::find(features.begin(), features.end(), f);
+        size_t k = std::distance(features.begin(), it);
+        if (it == features.end())
+            features.push_back(f);
+
+        string x = fmt::format("x{}[i]", k);
+        if (dt == DataType::ArrayI)
+            return fmt::format("int({})", x);
+        if (dt == DataType::ArrayB)
+            return fmt::format("({} != 0.0f)", x);
+        return x;
+    }
+
+    /// the mask of a split node, given the value it thresholds
+    string mask(const string& x, DataType dt, float threshold)
+    {
+        // same as Split::threshold_mask
+        if (dt == DataType::ArrayB)
+            return x;
+        if (dt == DataType::ArrayI)
+            return fmt::format("(float({}) == {})", x, literal(threshold));
+        return fmt::format("({} >= {})", x, literal(threshold));
+    }
+
+    /// emits the statements of the subtree of `tn`, returning the name of
+    /// the variable that holds its output
+    string emit(const TreeNode* tn)
+    {
+        const Node& n = tn->data;
+
+        vector<string> args;
+        vector<DataType> arg_types;
+        const TreeNode* child = tn->first_child;
+        for (size_t i = 0; i < n.get_arg_count(); ++i, child = child->next_sibling)
+        {
+            args.push_back(emit(child));
+            arg_types.push_back(child->data.ret_type);
+        }
+
+        const string type = scalar_type(n.ret_type, n);
+        const string W = literal(n.W);
+        auto join = [&](const string& op) {
+            string e = "(";
+            for (size_t i = 0; i < args.size(); ++i)
+            {
+                e += i > 0 ? " " + op + " " : "";
+                e += arg_types.at(i) == DataType::ArrayB ?
+                     fmt::format("float({})", args.at(i)) : args.at(i);
+            }
+            return e + ")";
+        };
+        auto nest = [&](const string& f) {
+            string e = args.back();
+            for (size_t i = args.size()-1; i --> 0; )
+                e = fmt::format("{}({}, {})", f, args.at(i), e);
+            return e;
+        };
+
+        string e;
+        bool weighted = n.get_is_weighted() && n.ret_type == DataType::ArrayF;
+        switch (n.node_type) {
+            // leaves. Their weights are applied by the operators of the
+            // leaves, so they are not applied below
+            case NodeType::Terminal:
+                e = feature(n.get_feature(), n.ret_type);
+                if (weighted)
+                    e = fmt::format("{}*{}", W, e);
+                weighted = false;
+                break;
+            case NodeType::Constant:
+            case NodeType::MeanLabel:
+                if (n.ret_type == DataType::ArrayB)
+                    e = "true";
+                else if (n.ret_type == DataType::ArrayI)
+                    e = fmt::format("{}", int(n.W));
+                else
+                    e = W;
+                weighted = false;
+                break;
+
+            // splits, where the weight is the threshold
+            case NodeType::SplitBest:
+                e = n.get_feature().empty() ? "true" :
+                    mask(feature(n.get_feature(), DataType::ArrayF),
+                         n.get_feature_type(), n.W);
+                e = fmt::format("({} ? {} : {})", e, args.at(0), args.at(1));
+                weighted = false;
+                break;
+            case NodeType::SplitOn:
+                e = fmt::format("({} ? {} : {})",
+                    mask(args.at(0), arg_types.at(0), n.W), args.at(1), args.at(2));
+                weighted = false;
+                break;
+
+            case NodeType::Add:      e = join("+"); break;
+            case NodeType::Sub:      e = join("-"); break;
+            case NodeType::Mul:      e = join("*"); break;
+            case NodeType::Div:      e = join("/"); break;
+            case NodeType::Sum:      e = join("+"); break;
+            case NodeType::Prod:     e = join("*"); break;
+            case NodeType::Mean:
+                e = fmt::format("({}/{}.0f)", join("+"), args.size());
+                break;
+            case NodeType::OffsetSum: e = join("+"); break;
+            case NodeType::Min:
+                e = args.size() == 1 ? args.at(0) : nest("std::min");
+                break;
+            case NodeType::Max:
+                e = args.size() == 1 ? args.at(0) : nest("std::max");
+                break;
+            case NodeType::Median:
+                uses_median = true;
+                e = fmt::format("median<{}>({{{}}})", args.size(),
+                                fmt::join(args, ", "));
+                break;
+
+            case NodeType::Pow:   e = fmt::format("std::pow({}, {})", args.at(0), args.at(1)); break;
+            case NodeType::Abs:
+                e = fmt::format("std::abs({})", args.at(0));
+                break;
+            case NodeType::Acos:  e = fmt::format("std::acos({})", args.at(0)); break;
+            case NodeType::Asin:  e = fmt::format("std::asin({})", args.at(0)); break;
+            case NodeType::Atan:  e = fmt::format("std::atan({})", args.at(0)); break;
+            case NodeType::Cos:   e = fmt::format("std::cos({})", args.at(0)); break;
+            case NodeType::Cosh:  e = fmt::format("std::cosh({})", args.at(0)); break;
+            case NodeType::Sin:   e = fmt::format("std::sin({})", args.at(0)); break;
+            case NodeType::Sinh:  e = fmt::format("std::sinh({})", args.at(0)); break;
+            case NodeType::Tan:   e = fmt::format("std::tan({})", args.at(0)); break;
+            case NodeType::Tanh:  e = fmt::format("std::tanh({})", args.at(0)); break;
+            case NodeType::Ceil:  e = fmt::format("std::ceil({})", args.at(0)); break;
+            case NodeType::Floor: e = fmt::format("std::floor({})", args.at(0)); break;
+            case NodeType::Exp:   e = fmt::format("std::exp({})", args.at(0)); break;
+            case NodeType::Log:   e = fmt::format("std::log({})", args.at(0)); break;
+            case NodeType::Logabs:
+                e = fmt::format("std::log(std::abs({}))", args.at(0));
+                break;
+            case NodeType::Log1p: e = fmt::format("std::log1p({})", args.at(0)); break;
+            case NodeType::Sqrt:  e = fmt::format("std::sqrt({})", args.at(0)); break;
+            case NodeType::Sqrtabs:
+                e = fmt::format("std::sqrt(std::abs({}))", args.at(0));
+                break;
+            case NodeType::Square:
+                e = fmt::format("({0}*{0})", args.at(0));
+                break;
+            case NodeType::Logistic:
+                e = fmt::format("(1.0f/(1.0f + std::exp(-{})))", args.at(0));
+                break;
+
+            case NodeType::And:    e = join("&&"); break;
+            case NodeType::Or:     e = join("||"); break;
+            case NodeType::Not:    e = fmt::format("(!{})", args.at(0)); break;
+            case NodeType::Geq:    e = fmt::format("({} >= {})", args.at(0), args.at(1)); break;
+            case NodeType::Equals: e = fmt::format("({} == {})", args.at(0), args.at(1)); break;
+
+            default:
+                HANDLE_ERROR_THROW(fmt::format("Can't export {} to C++: "
+                    "the node type is not supported", n.get_name(false)));
+        }
+
+        // same as the apply_weight of operators
+        if (weighted)
+        {
+            if (n.node_type == NodeType::OffsetSum)
+                e = fmt::format("({} + {})", e, W);
+            else
+                e = fmt::format("{}*{}", e, W);
+        }
+
+        // unary reductions of one argument do not change its type
+        if (args.size() == 1 && arg_types.at(0) != n.ret_type)
+            e = fmt::format("{}({})", type, e);
+
+        string var = fmt::format("v{}", n_vars++);
+        body += fmt::format("        const {} {} = {};\n", type, var, e);
+        return var;
+    }
+};
+
+} // namespace
+
+string get_cpp_model(const tree<Node>& Tree, const string& name)
+{
+    if (Tree.empty())
+        HANDLE_ERROR_THROW("Can't export an empty program to C++");
+
+    Emitter emitter;
+    const string out = emitter.emit(Tree.begin().node);
+
+    string src = fmt::format("// Generated by Brush from the program\n"
+        "//     {}\n//\n", Tree.begin().node->get_model());
+    src += fmt::format("// {}(X, out, n) writes the outputs of the program "
+        "on n rows to out.\n// X[k] holds the values of the k-th feature:\n",
+        name);
+    for (size_t k = 0; k < emitter.features.size(); ++k)
+        src += fmt::format("//     X[{}]: {}\n", k, emitter.features.at(k));
+
+    src += "\n#include <algorithm>\n"
+           "#include <cmath>\n"
+           "#include <cstddef>\n"
+           "#include <limits>\n\n";
+
+    if (emitter.uses_median)
+        src += "template<std::size_t N>\n"
+               "static inline float median(float (&&v)[N])\n"
+               "{\n"
+               "    std::sort(v, v + N);\n"
+               "    return N % 2 == 0 ? (v[N/2 - 1] + v[N/2])/2.0f : v[N/2];\n"
+               "}\n\n";
+
+    src += fmt::format("extern \"C\" void {}(const float* const* X, float* out, "
+                       "std::size_t n)\n{{\n", name);
+    for (size_t k = 0; k < emitter.features.size(); ++k)
+        src += fmt::format("    const float* const x{0} = X[{0}];\n", k);
+    src += "    for (std::size_t i = 0; i < n; ++i)\n    {\n";
+    src += emitter.body;
+    src += fmt::format("        out[i] = float({});\n", out);
+    src += "    }\n}\n";
+
+    return src;
+}
+
+} // Brush
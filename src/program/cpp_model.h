@@ -0,0 +1,49 @@
+/* Brush
+copyright 2020 William La Cava
+license: GNU/GPL v3
+*/
+#ifndef CPP_MODEL_H
+#define CPP_MODEL_H
+
+#include "../init.h"
+#include "tree_node.h"
+
+namespace Brush {
+
+/**
+ * @brief Emits a program as the source of a self-contained C++ function,
+ * for scoring outside of Brush.
+ *
+ * The function has the signature
+ *
+ *     extern "C" void name(const float* const* X, float* out, size_t n)
+ *
+ * where `X[k]` points to the `n` values of the k-th feature listed in the
+ * header comment of the source, and `out` receives the `n` outputs of the
+ * program. Integer and boolean features are passed as floats. The outputs
+ * are the ones of the tree: probabilities for binary classifiers.
+ *
+ * The nodes are unrolled into straight-line code in a single loop over the
+ * rows, with the weights baked in as constants, so the compiler fuses and
+ * vectorizes the whole program. The source only depends on the standard
+ * library.
+ *
+ * The source evaluates with the functions of the standard library, while
+ * Brush evaluates with the vectorized ones of Eigen. Their outputs may
+ * differ by a few ulp, which ill-conditioned programs magnify. They agree
+ * on infinities and NaNs, but not on subnormal values, which the vectorized
+ * exp, log and square root of Eigen flush to zero or to the smallest
+ * normal float.
+ *
+ * Only programs of elementwise operators on arrays can be exported. Nodes
+ * on matrices or time series, such as the softmax of multiclass
+ * classifiers, throw an error.
+ *
+ * @param Tree the program
+ * @param name name of the function
+ * @return the source code of the function
+ */
+string get_cpp_model(const tree<Node>& Tree, const string& name="brush_predict");
+
+} // Brush
+#endif
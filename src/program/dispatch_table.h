@@ -29,6 +29,8 @@ template<typename R, NodeType NT, typename S, bool Fit, typename W>
 R DispatchOp( const Data::Dataset& d, TreeNode& tn, const W** weights); 
 template<typename R, NodeType NT, typename S, bool Fit> 
 R DispatchOp( const Data::Dataset& d, TreeNode& tn); 
+template<typename R, NodeType NT, typename S, bool Fit, typename W> 
+void ExecOp( const Data::Dataset& d, TreeNode& tn, Data::State* slots, const W** weights); 
 
 ////////////////////////////////////////////////////////////////////////////////
 // Dispatch Table
@@ -67,8 +69,19 @@ struct DispatchTable
     /// @brief maps NodeTypes -> Signature hash -> Dispatch Operator 
     using DTMap = std::unordered_map<NodeType, SigMap>;
 
+    /// @brief an instruction of a compiled program. Reads the outputs of the
+    /// node's children from `slots` and writes its own output to `slots[0]`.
+    template<typename W>
+    using Kernel = void(*)(const Data::Dataset&, TreeNode&, Data::State*, const W**);
+
+    using KernelVariant = std::variant<Kernel<float>, Kernel<fJet>>;
+    /// @brief maps NodeTypes -> Signature hash -> Kernel
+    using KernelMap = std::unordered_map<NodeType, 
+        std::unordered_map<std::size_t,KernelVariant>>;
+
 private:
     DTMap map_;
+    KernelMap kernels_;
 
     template<std::size_t... Is>
     void InitMap(std::index_sequence<Is...> /*unused*/)
@@ -77,6 +90,7 @@ private:
         //TODO: nt(Is) should be a hash, if want to register other functions
         auto nt = [](auto i) { return static_cast<NodeType>(1UL << i); };
         (map_.insert({ nt(Is), MakeOperators<nt(Is)>() }), ...);
+        (kernels_.insert({ nt(Is), MakeKernels<nt(Is)>() }), ...);
     }
 
     template<NodeType NT>
@@ -118,6 +132,41 @@ private:
             return Callable<R>(DispatchOp<R,N,S,Fit,W>);
     }
 
+    template<NodeType NT>
+    auto MakeKernels()  
+    {
+        using signatures = typename Signatures<NT>::type;
+        return AddKernel<NT, signatures>( 
+                     std::make_index_sequence<std::tuple_size_v<signatures>>()
+                     );
+    } 
+
+    /// same as AddOperator, for the kernels of compiled programs
+    template<NodeType NT, typename Sigs, std::size_t... Is>
+    static constexpr auto AddKernel(std::index_sequence<Is...>)
+    {
+        typename KernelMap::mapped_type km;
+        (km.insert({std::tuple_element_t<Is, Sigs>::hash(), 
+            MakeKernel<NT, std::tuple_element_t<Is, Sigs>>()}), ...);
+        if constexpr (is_in_v<NT, NodeType::ArgMax, NodeType::Count>){
+            (km.insert({std::tuple_element_t<Is, Sigs>::DualArgs::hash(), 
+                MakeKernel<NT, typename std::tuple_element_t<Is, Sigs>::DualArgs>()}), ...);
+        }
+        else {
+            (km.insert({std::tuple_element_t<Is, Sigs>::Dual::hash(), 
+                MakeKernel<NT, typename std::tuple_element_t<Is, Sigs>::Dual>()}), ...);
+        }
+        return km;
+    }
+
+    template<NodeType N, typename S>
+    static constexpr auto MakeKernel()  
+    {
+        using R = typename S::RetType;
+        using W = typename S::WeightType;
+        return KernelVariant(Kernel<W>(ExecOp<R,N,S,Fit,W>));
+    }
+
 public:
     DispatchTable()
     {
@@ -144,17 +193,35 @@ public:
     auto operator=(DispatchTable const& other) -> DispatchTable& {
         if (this != &other) {
             map_ = other.map_;
+            kernels_ = other.kernels_;
         }
         return *this;
     }
 
     auto operator=(DispatchTable&& other) noexcept -> DispatchTable& {
         map_ = std::move(other.map_);
+        kernels_ = std::move(other.kernels_);
         return *this;
     }
 
-    DispatchTable(DispatchTable const& other) : map_(other.map_) { }
-    DispatchTable(DispatchTable &&other) noexcept : map_(std::move(other.map_)) { }
+    DispatchTable(DispatchTable const& other) 
+        : map_(other.map_), kernels_(other.kernels_) { }
+    DispatchTable(DispatchTable &&other) noexcept 
+        : map_(std::move(other.map_)), kernels_(std::move(other.kernels_)) { }
+
+    /// @brief find the callable of a node. 
+    /// @return pointer to the callable, or nullptr if there is none.
+    /// It stays valid for the lifetime of the table.
+    inline auto Find(NodeType n, std::size_t sig_hash) const -> const CallVariant*
+    {
+        auto sigmap = map_.find(n);
+        if (sigmap == map_.end())
+            return nullptr;
+        auto callable = sigmap->second.find(sig_hash);
+        if (callable == sigmap->second.end())
+            return nullptr;
+        return &callable->second;
+    }
 
     template<typename T>
     inline auto Get(NodeType n, std::size_t sig_hash) const -> Callable<T> const&
@@ -162,43 +229,129 @@ public:
         // fmt::print("get<Callable<{}>> for {} with hash {}\n",
         //     DataTypeEnum<T>::value, n, sig_hash
         // );
-        if (map_.at(n).find(sig_hash) == map_.at(n).end())
+        const auto& sigmap = map_.at(n);
+        auto callable = sigmap.find(sig_hash);
+        if (callable == sigmap.end())
         {
             string err;
             err += fmt::format("sig_hash={} not in map_.at({})\n",sig_hash,n);
             err += fmt::format("options:\n");
-            for (auto [k, v]: map_.at(n))
+            for (const auto& [k, v]: sigmap)
                 err+= fmt::format("{}\n", k);
             HANDLE_ERROR_THROW(err); 
         }
-        
-        // TODO: is this needed?
-        CallVariant callable = map_.at(n).at(sig_hash);
-
-        if (std::holds_alternative<Callable<T>>(map_.at(n).at(sig_hash)))
-            return std::get<Callable<T>>(map_.at(n).at(sig_hash));
-        else{
-            if (map_.at(n).size() > 1){
-                for (const auto & kv : map_.at(n))
-                {
-                    if (std::holds_alternative<Callable<T>>(kv.second))
-                        return std::get<Callable<T>>(kv.second);
-                }
+
+        if (auto F = std::get_if<Callable<T>>(&callable->second))
+            return *F;
+
+        if (sigmap.size() > 1){
+            for (const auto & kv : sigmap)
+            {
+                if (std::holds_alternative<Callable<T>>(kv.second))
+                    return std::get<Callable<T>>(kv.second);
             }
-            auto msg = fmt::format("Tried get<Callable<{}>> for {} with hash {}. failed"
-            " because map holds index {}\n",
-                DataTypeEnum<T>::value, n, sig_hash, map_.at(n).at(sig_hash).index() 
-            );
-            HANDLE_ERROR_THROW(msg);
         }
+        auto msg = fmt::format("Tried get<Callable<{}>> for {} with hash {}. failed"
+        " because map holds index {}\n",
+            DataTypeEnum<T>::value, n, sig_hash, callable->second.index() 
+        );
+        HANDLE_ERROR_THROW(msg);
         
-        return std::get<Callable<T>>(map_.at(n).at(sig_hash));
+        return std::get<Callable<T>>(callable->second);
+    }
+
+    /// @brief get the kernel of a node for compiled programs. 
+    /// @tparam W weight type of the signature: fJet for dual signatures.
+    template<typename W>
+    inline auto GetKernel(NodeType n, std::size_t sig_hash) const -> Kernel<W>
+    {
+        const auto& km = kernels_.at(n);
+        auto kernel = km.find(sig_hash);
+        if (kernel == km.end() || !std::holds_alternative<Kernel<W>>(kernel->second))
+        {
+            HANDLE_ERROR_THROW(fmt::format("no kernel with weight type {} for "
+                "sig_hash={} in kernels_.at({})\n", 
+                is_same_v<W,fJet> ? "fJet" : "float", sig_hash, n)); 
+        }
+        return std::get<Kernel<W>>(kernel->second);
     }
 
 };
 
 extern DispatchTable<true> dtable_fit;
 extern DispatchTable<false> dtable_predict;
+
+/**
+ * @brief The callables of a node, looked up in the dispatch tables once
+ * instead of at every evaluation. 
+ * 
+ * They are resolved on first use, and again whenever the node type or the
+ * signature of the node changed since.
+ */
+struct NodeOps
+{
+    NodeType node_type;
+    std::size_t sig_hash = 0;
+    std::size_t sig_dual_hash = 0;
+    bool resolved = false;
+
+    const DispatchTable<true>::CallVariant* fit = nullptr;
+    const DispatchTable<false>::CallVariant* predict = nullptr;
+    const DispatchTable<false>::CallVariant* predict_dual = nullptr;
+
+    inline bool is_resolved_for(const Node& n) const
+    {
+        return resolved 
+            && node_type == n.node_type 
+            && sig_hash == n.sig_hash 
+            && sig_dual_hash == n.sig_dual_hash;
+    };
+
+    inline void resolve(const Node& n)
+    {
+        if (is_resolved_for(n))
+            return;
+        node_type = n.node_type;
+        sig_hash = n.sig_hash;
+        sig_dual_hash = n.sig_dual_hash;
+        fit = dtable_fit.Find(node_type, sig_hash);
+        predict = dtable_predict.Find(node_type, sig_hash);
+        predict_dual = dtable_predict.Find(node_type, sig_dual_hash);
+        resolved = true;
+    };
+
+    // The getters fall back on the dispatch table when the cached callable
+    // is missing or returns another type, so that errors are reported there.
+    template<typename T>
+    inline auto get_fit(const Node& n) -> DispatchTable<true>::Callable<T> const&
+    {
+        resolve(n);
+        if (fit)
+            if (auto F = std::get_if<DispatchTable<true>::Callable<T>>(fit))
+                return *F;
+        return dtable_fit.template Get<T>(n.node_type, n.sig_hash);
+    };
+
+    template<typename T>
+    inline auto get_predict(const Node& n) -> DispatchTable<false>::Callable<T> const&
+    {
+        resolve(n);
+        if (predict)
+            if (auto F = std::get_if<DispatchTable<false>::Callable<T>>(predict))
+                return *F;
+        return dtable_predict.template Get<T>(n.node_type, n.sig_hash);
+    };
+
+    template<typename T>
+    inline auto get_predict_dual(const Node& n) -> DispatchTable<false>::Callable<T> const&
+    {
+        resolve(n);
+        if (predict_dual)
+            if (auto F = std::get_if<DispatchTable<false>::Callable<T>>(predict_dual))
+                return *F;
+        return dtable_predict.template Get<T>(n.node_type, n.sig_dual_hash);
+    };
+};
 // // format overload 
 // template <> struct fmt::formatter<Brush::SearchSpace>: formatter<string_view> {
 //   template <typename FormatContext>
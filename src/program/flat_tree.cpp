@@ -0,0 +1,234 @@
+#include "flat_tree.h"
+
+namespace Brush {
+
+FlatTree::FlatTree(const tree<Node>& t)
+{
+    nodes.reserve(t.size());
+    for (const auto& n : t)
+        nodes.push_back(n);
+    set_sizes();
+}
+
+void FlatTree::set_sizes()
+{
+    // the subtree of a node is the node and the subtrees of its arguments,
+    // which follow it. Going backwards, they are the last ones on the stack.
+    sizes.resize(nodes.size());
+    vector<uint32_t> stack;
+    for (size_t i = nodes.size(); i --> 0; )
+    {
+        uint32_t size = 1;
+        for (size_t a = 0; a < nodes.at(i).get_arg_count(); ++a)
+        {
+            if (stack.empty())
+                HANDLE_ERROR_THROW(fmt::format("Node {} has fewer arguments "
+                    "than its signature", nodes.at(i).get_name(false)));
+            size += stack.back();
+            stack.pop_back();
+        }
+        sizes.at(i) = size;
+        stack.push_back(size);
+    }
+    if (stack.size() > 1)
+        HANDLE_ERROR_THROW(fmt::format("A program must have one root, not {}",
+            stack.size()));
+}
+
+tree<Node> FlatTree::to_tree() const
+{
+    tree<Node> t;
+    // the open nodes, and the end of their subtrees
+    vector<std::pair<tree<Node>::pre_order_iterator, size_t>> stack;
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        while (!stack.empty() && stack.back().second <= i)
+            stack.pop_back();
+
+        auto spot = stack.empty() ? t.insert(t.begin(), nodes[i])
+                                      : t.append_child(stack.back().first, nodes[i]);
+        stack.push_back({spot, i + sizes[i]});
+    }
+    return t;
+}
+
+int FlatTree::parent(size_t i) const
+{
+    // the parent is the closest node before `i` whose subtree spans it
+    for (int p = int(i) - 1; p >= 0; --p)
+        if (p + sizes[p] > i)
+            return p;
+    return -1;
+}
+
+template<typename F>
+void FlatTree::for_each_post(F&& f) const
+{
+    // a node comes after the last node of its subtree
+    vector<size_t> stack;
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        stack.push_back(i);
+        while (!stack.empty() && stack.back() + sizes[stack.back()] == i + 1)
+        {
+            f(stack.back());
+            stack.pop_back();
+        }
+    }
+}
+
+int FlatTree::get_size(bool include_weight) const
+{
+    int acc = 0;
+    for (const auto& n : nodes)
+        acc += n.get_size(include_weight);
+    return acc;
+}
+
+int FlatTree::depth() const
+{
+    int max_depth = 0;
+    vector<size_t> ends;
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        while (!ends.empty() && ends.back() <= i)
+            ends.pop_back();
+        ends.push_back(i + sizes[i]);
+        max_depth = std::max(max_depth, int(ends.size()));
+    }
+    return max_depth;
+}
+
+// the conditions on the weights match the ones of Program
+int FlatTree::get_n_weights() const
+{
+    int count = 0;
+    for (const auto& node : nodes)
+    {
+        if (node.weight_is_fixed)
+            continue;
+
+        if (Is<NodeType::OffsetSum>(node.node_type)
+        || (node.get_is_weighted() && IsWeighable(node.ret_type)) )
+            ++count;
+    }
+    return count;
+}
+
+ArrayXf FlatTree::get_weights() const
+{
+    ArrayXf weights(get_n_weights());
+    int j = 0;
+    for_each_post([&](size_t i){
+        const auto& node = nodes[i];
+        if (node.weight_is_fixed)
+            return;
+
+        if ( Is<NodeType::OffsetSum>(node.node_type)
+        ||   (node.get_is_weighted() && IsWeighable(node.ret_type)) )
+            weights(j++) = node.W;
+    });
+    return weights;
+}
+
+void FlatTree::set_weights(const ArrayXf& weights)
+{
+    if (weights.size() != get_n_weights())
+        HANDLE_ERROR_THROW("Tried to set_weights of incorrect size");
+
+    int j = 0;
+    for_each_post([&](size_t i){
+        auto& node = nodes[i];
+        if (node.weight_is_fixed)
+            return;
+
+        if ( Is<NodeType::OffsetSum>(node.node_type)
+        ||   (node.get_is_weighted() && IsWeighable(node.node_type)) )
+            node.W = weights(j++);
+    });
+}
+
+void FlatTree::grow(int i, int delta)
+{
+    while (i >= 0)
+    {
+        sizes[i] += delta;
+        i = parent(i);
+    }
+}
+
+void FlatTree::replace(size_t i, const FlatTree& other, size_t j)
+{
+    if (&other == this)
+        return replace(i, FlatTree(other), j);
+
+    const int p = parent(i);
+    const size_t n_old = sizes.at(i), n_new = other.sizes.at(j);
+
+    auto splice = [&](auto& dst, const auto& src) {
+        auto first = dst.begin() + i;
+        const size_t n_common = std::min(n_old, n_new);
+        std::copy_n(src.begin() + j, n_common, first);
+        if (n_old > n_new)
+            dst.erase(first + n_common, first + n_old);
+        else
+            dst.insert(first + n_common, src.begin() + j + n_common,
+                       src.begin() + j + n_new);
+    };
+    splice(nodes, other.nodes);
+    splice(sizes, other.sizes);
+
+    grow(p, int(n_new) - int(n_old));
+}
+
+void FlatTree::erase(size_t i)
+{
+    const int p = parent(i);
+    const size_t n = sizes.at(i);
+    nodes.erase(nodes.begin() + i, nodes.begin() + i + n);
+    sizes.erase(sizes.begin() + i, sizes.begin() + i + n);
+    grow(p, -int(n));
+}
+
+void FlatTree::insert(size_t parent, size_t n, const FlatTree& other, size_t j)
+{
+    if (&other == this)
+        return insert(parent, n, FlatTree(other), j);
+
+    // skip the subtrees of the first n children
+    size_t i = parent + 1;
+    for (size_t c = 0; c < n; ++c)
+    {
+        if (i >= parent + sizes.at(parent))
+            HANDLE_ERROR_THROW(fmt::format("Node {} has fewer than {} children",
+                parent, n));
+        i += sizes[i];
+    }
+
+    const size_t n_new = other.sizes.at(j);
+    nodes.insert(nodes.begin() + i, other.nodes.begin() + j,
+                 other.nodes.begin() + j + n_new);
+    sizes.insert(sizes.begin() + i, other.sizes.begin() + j,
+                 other.sizes.begin() + j + n_new);
+    grow(parent, n_new);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// serialization, in the same format as tree<Node>
+void to_json(json &j, const FlatTree& t)
+{
+    j = json::array();
+    for (const auto& n : t.get_nodes())
+        j.push_back(n);
+}
+
+void from_json(const json &j, FlatTree& t)
+{
+    t.nodes.clear();
+    t.nodes.reserve(j.size());
+    for (const auto& el : j)
+        t.nodes.push_back(el.get<Node>());
+    t.set_sizes();
+}
+
+} // Brush
@@ -0,0 +1,101 @@
+/* Brush
+copyright 2020 William La Cava
+license: GNU/GPL v3
+*/
+#ifndef FLAT_TREE_H
+#define FLAT_TREE_H
+
+#include <span>
+
+#include "../init.h"
+#include "node.h"
+#include "tree_node.h"
+
+namespace Brush {
+
+/**
+ * @brief A program tree stored as one array of nodes in prefix order.
+ *
+ * Each node is followed by the nodes of its subtree, so a subtree is a
+ * contiguous span of the array, and the size of every subtree is kept next
+ * to it. This is an alternative to the linked `tree<Node>` of a Program:
+ * size, depth and the weights are computed in one linear pass, and replacing,
+ * erasing or inserting a subtree is a single splice of the array.
+ *
+ * The nodes are in the same order as in the json of a `tree<Node>`, so both
+ * serialize to the same json, and convert to each other without loss.
+ */
+class FlatTree
+{
+public:
+    FlatTree() = default;
+    explicit FlatTree(const tree<Node>& t);
+
+    /// @brief builds the linked tree holding the same nodes
+    tree<Node> to_tree() const;
+
+    /// @brief number of nodes
+    inline size_t size() const { return nodes.size(); };
+    inline bool empty() const { return nodes.empty(); };
+
+    /// @brief nodes in prefix order
+    inline const vector<Node>& get_nodes() const { return nodes; };
+    inline Node& operator[](size_t i) { return nodes.at(i); };
+    inline const Node& operator[](size_t i) const { return nodes.at(i); };
+
+    /// @brief number of nodes in the subtree rooted at `i`, including `i`
+    inline size_t subtree_size(size_t i) const { return sizes.at(i); };
+    /// @brief the nodes of the subtree rooted at `i`
+    inline std::span<const Node> subtree(size_t i) const {
+        return {nodes.data() + i, sizes.at(i)};
+    };
+    /// @brief position of the parent of `i`, or -1 for the root
+    int parent(size_t i) const;
+
+    /// @brief same as Program::size
+    int get_size(bool include_weight=true) const;
+    /// @brief same as Program::depth
+    int depth() const;
+
+    /// @brief same as Program::get_n_weights
+    int get_n_weights() const;
+    /// @brief same as Program::get_weights, in post-fix order
+    ArrayXf get_weights() const;
+    /// @brief same as Program::set_weights
+    void set_weights(const ArrayXf& weights);
+
+    /**
+     * @brief Replaces the subtree rooted at `i` with the subtree rooted at
+     * `j` in `other`, e.g. in subtree crossover or mutation.
+     */
+    void replace(size_t i, const FlatTree& other, size_t j=0);
+    /// @brief removes the subtree rooted at `i`. The caller is responsible
+    /// for the arity of its parent.
+    void erase(size_t i);
+    /// @brief inserts the subtree rooted at `j` in `other` as the `n`-th
+    /// child of `parent`. The caller is responsible for the arity of `parent`.
+    void insert(size_t parent, size_t n, const FlatTree& other, size_t j=0);
+
+private:
+    vector<Node> nodes;
+    /// size of the subtree rooted at each node
+    vector<uint32_t> sizes;
+
+    /// calls `f` on the position of each node, in post-fix order
+    template<typename F>
+    void for_each_post(F&& f) const;
+
+    /// adds `delta` to the size of the subtree of `i` and of its ancestors
+    void grow(int i, int delta);
+
+    /// sets the subtree sizes from the arities of the nodes
+    void set_sizes();
+
+    friend void from_json(const json &j, FlatTree& t);
+};
+
+void to_json(json &j, const FlatTree& t);
+void from_json(const json &j, FlatTree& t);
+
+} // Brush
+#endif
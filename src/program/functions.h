@@ -17,6 +17,7 @@ Code below heavily inspired by heal-research/operon
 #include "../util/utils.h"
 #include "../data/data.h"
 #include "node.h"
+#include "../util/fast_math.h"
 using namespace Brush::Util;
 
 using namespace std;
@@ -353,18 +354,32 @@ https://eigen.tuxfamily.org/dox/group__QuickRefPage.html#arrayonly
         inline auto operator()(const T& t) { return t.tanh(); }
     };
 
+    /// square root of float arrays that is inf on inf, like std::sqrt. The
+    /// vectorized square root of Eigen is x*rsqrt(x), which is NaN on inf,
+    /// while the rows after the last full packet use std::sqrt, so the
+    /// output on inf would depend on the position of the row.
+    template<typename T>
+    inline auto ieee_sqrt(const T& t)
+    {
+        if constexpr (std::is_base_of_v<Eigen::ArrayBase<T>, T>
+                  &&  is_same_v<typename T::Scalar, float>)
+            return (t == std::numeric_limits<float>::infinity()).select(t, t.sqrt());
+        else
+            return t.sqrt();
+    }
+
     template<>
     struct Function<NodeType::Sqrt>
     {
         template<typename T>
-        inline auto operator()(const T& t) { return t.sqrt(); }
+        inline auto operator()(const T& t) { return ieee_sqrt(t); }
     };
 
     template<>
     struct Function<NodeType::Sqrtabs>
     {
         template<typename T>
-        inline auto operator()(const T& t) { return t.abs().sqrt(); }
+        inline auto operator()(const T& t) { return ieee_sqrt(t.abs()); }
     };
 
     template<>
@@ -541,5 +556,40 @@ https://eigen.tuxfamily.org/dox/group__QuickRefPage.html#arrayonly
         }
     };
 
+    /* vectorized kernels of the node functions on float arrays, which the
+    operators run in place of Eigen when the precision is "fast". See 
+    Util::FastMath. */
+    template<Brush::NodeType N>
+    struct FastKernel
+    {
+        static constexpr size_t arity = 0;
+    };
+
+    template<auto K>
+    struct UnaryFastKernel
+    {
+        static constexpr size_t arity = 1;
+        static inline void run(const float* x, float* out, size_t n) { K(x, out, n); }
+    };
+
+    template<> struct FastKernel<NodeType::Exp> : UnaryFastKernel<&Util::FastMath::exp> {};
+    template<> struct FastKernel<NodeType::Log> : UnaryFastKernel<&Util::FastMath::log> {};
+    template<> struct FastKernel<NodeType::Logabs> : UnaryFastKernel<&Util::FastMath::logabs> {};
+    template<> struct FastKernel<NodeType::Sin> : UnaryFastKernel<&Util::FastMath::sin> {};
+    template<> struct FastKernel<NodeType::Cos> : UnaryFastKernel<&Util::FastMath::cos> {};
+    template<> struct FastKernel<NodeType::Tanh> : UnaryFastKernel<&Util::FastMath::tanh> {};
+    template<> struct FastKernel<NodeType::Sinh> : UnaryFastKernel<&Util::FastMath::sinh> {};
+    template<> struct FastKernel<NodeType::Cosh> : UnaryFastKernel<&Util::FastMath::cosh> {};
+    template<> struct FastKernel<NodeType::Logistic> : UnaryFastKernel<&Util::FastMath::logistic> {};
+
+    template<>
+    struct FastKernel<NodeType::Pow>
+    {
+        static constexpr size_t arity = 2;
+        static inline void run(const float* x, const float* y, float* out, size_t n) { 
+            Util::FastMath::pow(x, y, out, n); 
+        }
+    };
+
 } // Brush
 #endif
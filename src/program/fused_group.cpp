@@ -0,0 +1,270 @@
+#include "fused_group.h"
+#include "functions.h"
+#include "../util/arena.h"
+
+namespace Brush {
+
+namespace {
+
+using Apply = FusedGroup::Apply;
+
+inline Eigen::Map<const ArrayXf> arg(const float* const* args, size_t i,
+                                     Eigen::Index n)
+{
+    return Eigen::Map<const ArrayXf>(args[i], n);
+}
+
+/// a unary or binary operator, as in Operator::apply
+template<NodeType NT>
+void apply_function(const float* const* args, size_t n_args, float* out,
+                    Eigen::Index n)
+{
+    if constexpr (FastKernel<NT>::arity > 0)
+    {
+        if (Util::FastMath::enabled())
+        {
+            if constexpr (FastKernel<NT>::arity == 1)
+                FastKernel<NT>::run(args[0], out, n);
+            else
+                FastKernel<NT>::run(args[0], args[1], out, n);
+            return;
+        }
+    }
+
+    Function<NT> f;
+    Eigen::Map<ArrayXf> o(out, n);
+    if constexpr (BinaryOp<NT>)
+        o = f(arg(args, 0, n), arg(args, 1, n));
+    else
+        o = f(arg(args, 0, n));
+}
+
+/// an n-ary reduction, folded in the order of its arguments as in
+/// Operator::fold
+template<NodeType NT>
+void apply_fold(const float* const* args, size_t n_args, float* out,
+                Eigen::Index n)
+{
+    Eigen::Map<ArrayXf> o(out, n);
+    if (n_args == 1)
+    {
+        o = arg(args, 0, n);
+        return;
+    }
+
+    auto fold = [](const auto& a, const auto& b) {
+        if constexpr (NT == NodeType::Prod)
+            return a*b;
+        else if constexpr (NT == NodeType::Min)
+            return a.min(b);
+        else if constexpr (NT == NodeType::Max)
+            return a.max(b);
+        else
+            return a + b;
+    };
+    o = fold(arg(args, 0, n), arg(args, 1, n));
+    for (size_t i = 2; i < n_args; ++i)
+        o = fold(o, arg(args, i, n));
+
+    if constexpr (NT == NodeType::Mean)
+        o /= float(n_args);
+}
+
+template<NodeType NT>
+Apply function_of(size_t n_args)
+{
+    return n_args == (BinaryOp<NT> ? 2 : 1) ? &apply_function<NT> : nullptr;
+}
+
+/// the function of an operator that can be fused, or null
+Apply get_apply(const Node& n)
+{
+    const size_t n_args = n.get_arg_count();
+    switch (n.node_type) {
+        case NodeType::Add:      return function_of<NodeType::Add>(n_args);
+        case NodeType::Sub:      return function_of<NodeType::Sub>(n_args);
+        case NodeType::Mul:      return function_of<NodeType::Mul>(n_args);
+        case NodeType::Div:      return function_of<NodeType::Div>(n_args);
+        case NodeType::Pow:      return function_of<NodeType::Pow>(n_args);
+        case NodeType::Abs:      return function_of<NodeType::Abs>(n_args);
+        case NodeType::Acos:     return function_of<NodeType::Acos>(n_args);
+        case NodeType::Asin:     return function_of<NodeType::Asin>(n_args);
+        case NodeType::Atan:     return function_of<NodeType::Atan>(n_args);
+        case NodeType::Cos:      return function_of<NodeType::Cos>(n_args);
+        case NodeType::Cosh:     return function_of<NodeType::Cosh>(n_args);
+        case NodeType::Sin:      return function_of<NodeType::Sin>(n_args);
+        case NodeType::Sinh:     return function_of<NodeType::Sinh>(n_args);
+        case NodeType::Tan:      return function_of<NodeType::Tan>(n_args);
+        case NodeType::Tanh:     return function_of<NodeType::Tanh>(n_args);
+        case NodeType::Ceil:     return function_of<NodeType::Ceil>(n_args);
+        case NodeType::Floor:    return function_of<NodeType::Floor>(n_args);
+        case NodeType::Exp:      return function_of<NodeType::Exp>(n_args);
+        case NodeType::Log:      return function_of<NodeType::Log>(n_args);
+        case NodeType::Logabs:   return function_of<NodeType::Logabs>(n_args);
+        case NodeType::Log1p:    return function_of<NodeType::Log1p>(n_args);
+        case NodeType::Sqrt:     return function_of<NodeType::Sqrt>(n_args);
+        case NodeType::Sqrtabs:  return function_of<NodeType::Sqrtabs>(n_args);
+        case NodeType::Square:   return function_of<NodeType::Square>(n_args);
+        case NodeType::Logistic: return function_of<NodeType::Logistic>(n_args);
+        case NodeType::OffsetSum: return function_of<NodeType::OffsetSum>(n_args);
+        case NodeType::Sum:      return &apply_fold<NodeType::Sum>;
+        case NodeType::Prod:     return &apply_fold<NodeType::Prod>;
+        case NodeType::Min:      return &apply_fold<NodeType::Min>;
+        case NodeType::Max:      return &apply_fold<NodeType::Max>;
+        case NodeType::Mean:     return &apply_fold<NodeType::Mean>;
+        default:                 return nullptr;
+    }
+}
+
+/// the weight of a node, checked as in util::get_weight
+float get_weight(const Node& n)
+{
+    if (std::isnan(n.W) || n.W == std::numeric_limits<float>::lowest())
+        HANDLE_ERROR_THROW("TreeNode weight (W) is not set or is invalid for "
+                           "node: " + n.name.get());
+    return n.W;
+}
+
+} // namespace
+
+bool FusedGroup::is_fusable(const Node& n)
+{
+    if (n.ret_type != DataType::ArrayF)
+        return false;
+    for (auto t : n.get_arg_types())
+        if (t != DataType::ArrayF)
+            return false;
+
+    return Is<NodeType::Terminal, NodeType::Constant>(n.node_type)
+        || get_apply(n) != nullptr;
+}
+
+void FusedGroup::push_node(TreeNode* tn)
+{
+    const Node& n = tn->data;
+    if (!is_fusable(n))
+        HANDLE_ERROR_THROW(fmt::format("{} can not be fused", n.get_name(false)));
+    if (depth < n.get_arg_count())
+        HANDLE_ERROR_THROW(fmt::format("{} has fewer arguments in the group "
+            "than in its signature", n.get_name(false)));
+
+    ops.push_back({tn, get_apply(n), uint32_t(n.get_arg_count()), 0});
+    depth = depth - n.get_arg_count() + 1;
+    max_depth = std::max(max_depth, depth);
+}
+
+size_t FusedGroup::push_input()
+{
+    ops.push_back({nullptr, nullptr, 0, uint32_t(inputs.size())});
+    inputs.emplace_back();
+    max_depth = std::max(max_depth, ++depth);
+    return inputs.size() - 1;
+}
+
+void FusedGroup::run(const Dataset& d, Data::State* out)
+{
+    const Eigen::Index n = d.get_n_samples();
+    auto& arena = Util::BufferArena::local();
+
+    // columns and weights are read once per run, since the data and the
+    // weights of the nodes change between runs
+    columns.assign(ops.size(), nullptr);
+    gathered.reserve(ops.size());
+    weights.assign(ops.size(), 1.0f);
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+        const Op& op = ops[i];
+        if (op.node == nullptr)
+        {
+            columns[i] = inputs[op.input].data();
+            continue;
+        }
+        const Node& node = op.node->data;
+        if (node.node_type == NodeType::Terminal)
+        {
+            const size_t id = d.get_column_id(node.get_feature_id(), 
+                                              node.get_feature_handle());
+            columns[i] = d.visit_column<ArrayXf>(id, [&](const auto& x) {
+                using X = std::decay_t<decltype(x)>;
+                if constexpr (bool(X::Flags & Eigen::DirectAccessBit))
+                    return x.data();
+                else
+                {
+                    // the rows of a window of indices are gathered once
+                    gathered.push_back(arena.template acquire<ArrayXf>(n));
+                    gathered.back() = x;
+                    return static_cast<const float*>(gathered.back().data());
+                }
+            });
+        }
+        if (node.node_type == NodeType::Constant || node.get_is_weighted())
+            weights[i] = get_weight(node);
+    }
+
+    // two tiles per pending output, so that a node never writes over the
+    // outputs of its arguments. The kernels of the fast precision read
+    // their input after writing their output, so they can not run in place.
+    thread_local ArrayXf tiles;
+    if (tiles.size() < Eigen::Index(2*max_depth)*tile_rows)
+        tiles.resize(2*max_depth*tile_rows);
+    auto tile = [&](size_t j){ return tiles.data() + j*tile_rows; };
+
+    ArrayXf y = arena.template acquire<ArrayXf>(n);
+    stack.resize(max_depth);
+    for (Eigen::Index r = 0; r < n; r += tile_rows)
+    {
+        const Eigen::Index len = std::min(tile_rows, n - r);
+        size_t top = 0;
+        for (size_t i = 0; i < ops.size(); ++i)
+        {
+            const Op& op = ops[i];
+            const size_t p = top - op.n_args;
+            top = p + 1;
+
+            // the root writes to the output of the group
+            float* dst = i + 1 == ops.size() ? y.data() + r
+                       : stack[p] == tile(2*p) ? tile(2*p + 1) : tile(2*p);
+            Eigen::Map<ArrayXf> o(dst, len);
+
+            // leaves and inputs are read in place
+            if (op.node == nullptr)
+            {
+                stack[p] = columns[i] + r;
+                continue;
+            }
+            const Node& node = op.node->data;
+            if (node.node_type == NodeType::Terminal)
+            {
+                stack[p] = columns[i] + r;
+                if (!node.get_is_weighted())
+                    continue;
+                o = arg(stack.data(), p, len)*weights[i];
+            }
+            else if (node.node_type == NodeType::Constant)
+                o.setConstant(weights[i]);
+            else
+            {
+                op.apply(stack.data() + p, op.n_args, dst, len);
+                if (node.get_is_weighted())
+                {
+                    if (node.node_type == NodeType::OffsetSum)
+                        o += weights[i];
+                    else
+                        o *= weights[i];
+                }
+            }
+            stack[p] = dst;
+        }
+        if (stack[0] != y.data() + r)
+            std::copy_n(stack[0], len, y.data() + r);
+    }
+
+    for (auto& x : inputs)
+        arena.release(std::move(x));
+    for (auto& x : gathered)
+        arena.release(std::move(x));
+    gathered.clear();
+    out->emplace<ArrayXf>(std::move(y));
+}
+
+} // Brush
@@ -0,0 +1,94 @@
+/* Brush
+copyright 2020 William La Cava
+license: GNU/GPL v3
+*/
+#ifndef FUSED_GROUP_H
+#define FUSED_GROUP_H
+
+#include "../init.h"
+#include "../data/data.h"
+#include "tree_node.h"
+
+namespace Brush {
+
+/**
+ * @brief A subtree of elementwise operators on float arrays, evaluated as
+ * one loop over tiles of rows.
+ *
+ * Evaluated node by node, every node writes an output the size of the data,
+ * which its parent then reads back. A group instead evaluates all of its
+ * nodes on a tile of rows before moving on to the next tile. The outputs of
+ * its inner nodes live in buffers of one tile, which stay in cache, and
+ * only the output of its root is written out. Leaves read the columns of
+ * the data in place.
+ *
+ * The nodes of a group are held in postfix order. Arguments that can not
+ * be fused, such as splits or medians, are inputs of the group: the
+ * compiled program evaluates them beforehand and hands over their outputs.
+ *
+ * Each node evaluates the same functions as its operator, in the same
+ * order, including the kernels of the fast precision and the folds of
+ * n-ary reductions, so a group outputs what its nodes would.
+ */
+class FusedGroup
+{
+public:
+    /// @brief number of rows of a tile
+    static constexpr Eigen::Index tile_rows = 512;
+
+    /// @brief whether the node can be evaluated in a group: an elementwise
+    /// operator or a leaf, on float arrays.
+    static bool is_fusable(const Node& n);
+
+    /// @brief appends a node. Its arguments are the last nodes or inputs
+    /// appended.
+    void push_node(TreeNode* tn);
+
+    /// @brief appends an input, and returns its index
+    size_t push_input();
+
+    /// @brief the output of input `k`, set before the group is run
+    inline ArrayXf& input(size_t k) { return inputs.at(k); };
+
+    /// @brief evaluates the group on the data, and writes the output of its
+    /// root to `out`. The inputs are given back to the arena.
+    void run(const Dataset& d, Data::State* out);
+
+    /// @brief number of nodes in the group
+    inline size_t size() const { return ops.size() - inputs.size(); };
+    inline size_t get_n_inputs() const { return inputs.size(); };
+
+    /// @brief evaluates a node on `n` rows, writing to `out`
+    using Apply = void(*)(const float* const* args, size_t n_args, float* out,
+                          Eigen::Index n);
+
+private:
+    struct Op
+    {
+        /// the node, or null for an input
+        TreeNode* node;
+        Apply apply;
+        uint32_t n_args;
+        /// index of the input
+        uint32_t input;
+    };
+
+    vector<Op> ops;
+    /// largest number of outputs pending at once
+    size_t max_depth = 0;
+    size_t depth = 0;
+
+    // state of runs, kept between runs
+    vector<ArrayXf> inputs;
+    /// column read by a leaf, or input, of each op
+    vector<const float*> columns;
+    /// rows of the columns of a window of indices, which are not contiguous
+    vector<ArrayXf> gathered;
+    /// weight of each op, if it applies one
+    vector<float> weights;
+    /// pending outputs, from the arguments of an op to the last one
+    vector<const float*> stack;
+};
+
+} // Brush
+#endif
@@ -27,7 +27,7 @@ auto Node::get_name(bool include_weight) const noexcept -> std::string
         if (is_weighted && !weight_is_one && include_weight)
             return fmt::format("{:.2f}*{}", W, feature);
         else
-            return feature;
+            return feature.get();
     }
     else if (Is<NodeType::Constant>(node_type) && include_weight)
     {
@@ -51,7 +51,7 @@ auto Node::get_name(bool include_weight) const noexcept -> std::string
         return fmt::format("{:.2f}*{}", W, name);
     }
 
-    return name;
+    return name.get();
 }
 
 
@@ -68,7 +68,7 @@ string Node::get_model(const vector<string>& children) const noexcept
             );
     }
     else if (Is<NodeType::SplitOn>(node_type)){
-        if (arg_types.at(0) == DataType::ArrayB)
+        if (arg_types->at(0) == DataType::ArrayB)
         {
             // booleans dont use thresholds (they are used directly as mask in split)
             return fmt::format("If({},{},{})",
@@ -112,6 +112,29 @@ string Node::get_model(const vector<string>& children) const noexcept
 
 }
 
+int Node::get_size(bool include_weight) const noexcept
+{
+    int acc = 1; // the node operator or terminal
+
+    // SplitBest has an optimizable decision tree consisting of 3 nodes
+    // (terminal, arithmetic comparison, value) that needs to be taken
+    // into account. Split on will have an random decision tree that can 
+    // have different sizes, but will also have the arithmetic comparison
+    // and a value.
+    if (Is<NodeType::SplitBest>(node_type))
+        acc += 3;
+    else if (Is<NodeType::SplitOn>(node_type))
+        acc += 2;
+
+    if ( (include_weight && get_is_weighted()==true)
+    &&   Isnt<NodeType::Constant, NodeType::MeanLabel>(node_type) )
+        // Taking into account the weight and multiplication, if enabled.
+        // weighted constants still count as 1 (simpler than constant terminals)
+        acc += 2;
+
+    return acc;
+}
+
 ////////////////////////////////////////
 // serialization
 // serialization for Node
@@ -120,7 +143,7 @@ string Node::get_model(const vector<string>& children) const noexcept
 void to_json(json& j, const Node& p) 
 {
     j = json{
-        {"name", p.name},
+        {"name", p.name.get()},
         {"center_op", p.center_op}, 
         {"node_is_fixed", p.node_is_fixed}, 
         {"weight_is_fixed", p.weight_is_fixed}, 
@@ -131,7 +154,7 @@ void to_json(json& j, const Node& p)
         {"sig_hash", p.sig_hash}, 
         {"sig_dual_hash", p.sig_dual_hash}, 
         {"ret_type", p.ret_type}, 
-        {"arg_types", p.arg_types}, 
+        {"arg_types", p.get_arg_types()}, 
         {"feature", p.get_feature()},
         {"feature_type", p.get_feature_type()}
         // {"node_hash", p.get_node_hash()} 
@@ -263,7 +286,7 @@ void init_node_with_default_signature(Node& node)
     else if (Is<NT::Constant>(n))
     {
         // "feature" starts with "const"
-        char last_char = node.feature.back();
+        char last_char = node.get_feature().back();
 
         switch (last_char) {
             case 'F':
@@ -315,7 +338,7 @@ void from_json(const json &j, Node& p)
         HANDLE_ERROR_THROW("Node json must contain node_type");
 
     if (j.contains("name"))
-        j.at("name").get_to(p.name);
+        p.name = j.at("name").get<string>();
     else        
         p.name = NodeTypeName[p.node_type];
 
@@ -325,7 +348,7 @@ void from_json(const json &j, Node& p)
     // used in split nodes
     if (j.contains("feature"))
     {
-        j.at("feature").get_to(p.feature);
+        p.feature = j.at("feature").get<string>();
     }
 
     if (j.contains("feature_type"))
@@ -342,7 +365,7 @@ void from_json(const json &j, Node& p)
     else
         make_signature=true;
     if (j.contains("arg_types"))
-        j.at("arg_types").get_to(p.arg_types);
+        p.arg_types = j.at("arg_types").get<vector<DataType>>();
     else
         make_signature=true;
     if (j.contains("sig_hash"))
@@ -12,6 +12,7 @@ https://github.com/heal-research/operon/
 #include "../data/data.h"
 #include "nodetype.h"
 #include "../util/utils.h"
+#include "../util/interned.h"
 #include <iostream>
 // #include "nodes/base.h"
 // #include "nodes/dx.h"
@@ -85,18 +86,21 @@ struct uint32_vector_hasher {
 /**
  * @brief class holding the data for a node in a tree.
  * 
+ * Nodes are trivially copyable: the name, feature and argument types are
+ * interned (see Util::Interned), so copying a tree copies no strings or
+ * vectors.
  */
 struct Node {
 
     /// full name of the node, with types
-    string name;
+    Util::Interned<string> name;
     /// @brief the node type
     NodeType node_type;
 
     /// @brief return data type
     DataType ret_type;
     /// @brief argument data types
-    std::vector<DataType> arg_types;
+    Util::Interned<vector<DataType>> arg_types;
     /// @brief a hash of the signature
     std::size_t sig_hash;
     /// @brief a hash of the dual of the signature (for NLS)
@@ -131,7 +135,7 @@ struct Node {
         UnderlyingNodeType,     // node type
         size_t,                 // sig_hash
         bool,                   // is_weighted
-        string,                 // feature
+        size_t,                 // hash of the feature
         bool,                   // node_is_fixed
         bool,                   // weight_is_fixed
         int                     // rounded W
@@ -146,8 +150,10 @@ struct Node {
     /// @param type node type
     /// @param feature_name name of the terminal 
     /// @param signature signature 
+    /// @param id column of the terminal in the dataset
     template<typename S>
-    explicit Node(NodeType type, S signature, bool weighted=false, string feature_name="") noexcept
+    explicit Node(NodeType type, S signature, bool weighted=false, string feature_name="",
+                  int id=-1) noexcept
         : node_type(type)
         , name(NodeTypeName[type])
         , ret_type(S::get_ret_type())
@@ -156,6 +162,7 @@ struct Node {
         , sig_dual_hash(S::Dual::hash())
         , is_weighted(weighted)
         , feature(feature_name)
+        , feature_id(id)
     {
         init();
     }
@@ -195,12 +202,14 @@ struct Node {
     /// @return string version of the node.
     string get_name(bool include_weight=true) const noexcept; 
     string get_model(const vector<string>&) const noexcept; 
+    /// @brief size of the node alone, without its arguments. See Program::size.
+    int get_size(bool include_weight=true) const noexcept;
 
     // get return type and argument types. 
     inline DataType get_ret_type() const { return ret_type; }; 
     inline std::size_t args_type() const { return sig_hash; };
-    inline auto get_arg_types() const { return arg_types; };
-    inline size_t get_arg_count() const { return arg_types.size(); };
+    inline const vector<DataType>& get_arg_types() const { return arg_types.get(); };
+    inline size_t get_arg_count() const { return arg_types->size(); };
 
     // void set_node_hash(){
     //     node_hash = std::hash<HashTuple>{}(HashTuple{
@@ -221,7 +230,7 @@ struct Node {
                 NodeTypes::GetIndex(node_type),
                 sig_hash,
                 get_is_weighted(),
-                feature,
+                std::hash<string>{}(feature.get()),
                 node_is_fixed,
                 weight_is_fixed,
                 // include weights only if we want exact matches.
@@ -277,8 +286,12 @@ struct Node {
     void set_prob_change(float w){ this->prob_change = w;};
     float get_prob_keep() const { return node_is_fixed ? 1.0 : 1.0-this->prob_change;};
 
-    inline void set_feature(string f){ feature = f; };
-    inline string get_feature() const { return feature; };
+    inline void set_feature(string f, int id=-1){ feature = f; feature_id = id; };
+    inline const string& get_feature() const { return feature.get(); };
+    inline const Util::Interned<string>& get_feature_handle() const { return feature; };
+
+    inline void set_feature_id(int id){ feature_id = id; };
+    inline int get_feature_id() const { return feature_id; };
     
     inline void set_feature_type(DataType ft){ this->feature_type = ft; };
     inline DataType get_feature_type() const { return this->feature_type; };
@@ -300,7 +313,11 @@ struct Node {
 
     // private:
     /// @brief feature name for terminals or splitting nodes
-    string feature; 
+    Util::Interned<string> feature; 
+
+    /// @brief column of the feature in the dataset, or -1 if unknown. Used
+    /// for lookups during evaluation; the name is what gets serialized.
+    int feature_id = -1;
     
     /// @brief feature type for terminals or splitting nodes
     DataType feature_type = DataType::ArrayF; 
@@ -309,6 +326,8 @@ struct Node {
     bool keep_split_feature = false; // TODO: unittests for keep_split_feature
 };
 
+static_assert(std::is_trivially_copyable_v<Node>);
+
 template <NodeType... T>
 inline auto Is(NodeType nt) -> bool { return ((nt == T) || ...); }
 
@@ -0,0 +1,67 @@
+#include "node_outputs.h"
+
+namespace Brush {
+
+thread_local bool NodeOutputs::enabled = false;
+
+NodeOutputs::Scope::Scope(bool enable) : previous(enabled)
+{
+    enabled = enable;
+}
+
+NodeOutputs::Scope::~Scope()
+{
+    enabled = previous;
+}
+
+bool NodeOutputs::active()
+{
+    return enabled;
+}
+
+std::shared_ptr<const NodeOutputs> NodeOutputs::merge(
+    const std::shared_ptr<const NodeOutputs>& a,
+    const std::shared_ptr<const NodeOutputs>& b)
+{
+    if (a == nullptr || a == b)
+        return b;
+    if (b == nullptr)
+        return a;
+
+    auto merged = std::make_shared<NodeOutputs>(*a);
+    merged->entries.insert(b->entries.begin(), b->entries.end());
+    return merged;
+}
+
+std::shared_ptr<const NodeOutputs::Entry> NodeOutputs::find(
+    std::size_t hash, const TreeNode* tn, const Dataset& d) const
+{
+    auto it = entries.find(SubtreeCache::key(hash, d.get_id()));
+    if (it == entries.end() || !SubtreeCache::is_entry_of(*it->second, tn, d))
+        return nullptr;
+    return it->second;
+}
+
+void NodeOutputs::insert(std::size_t hash, std::shared_ptr<const Entry> entry)
+{
+    if (entry == nullptr)
+        return;
+    entries.insert({SubtreeCache::key(hash, entry->data_id), std::move(entry)});
+}
+
+void NodeOutputs::keep_others(const NodeOutputs& other, const Dataset& d)
+{
+    for (const auto& [k, entry] : other.entries)
+        if (entry->data_id != d.get_id())
+            entries.insert({k, entry});
+}
+
+size_t NodeOutputs::get_n_bytes() const
+{
+    size_t n = 0;
+    for (const auto& [k, entry] : entries)
+        n += entry->n_bytes;
+    return n;
+}
+
+} // Brush
@@ -0,0 +1,85 @@
+/* Brush
+copyright 2020 William La Cava
+license: GNU/GPL v3
+*/
+#ifndef NODE_OUTPUTS_H
+#define NODE_OUTPUTS_H
+
+#include "subtree_cache.h"
+
+namespace Brush {
+
+/**
+ * @brief Outputs of the nodes of a program, retained from its last
+ * evaluation so that its offspring only re-evaluate what variation changed.
+ *
+ * Mutation and crossover change the subtree at one spot of a copy of the
+ * parent. Every other subtree of the child is a subtree of the parent, so a
+ * child that starts from the outputs of its parent only runs the nodes of
+ * the new subtree and of its ancestors.
+ *
+ * Outputs are held as SubtreeCache entries, keyed by the structural hash of
+ * their subtree and by dataset, and checked against the nodes stored with
+ * them. A subtree that did change, including a change of weights, is
+ * therefore a miss and is evaluated again.
+ *
+ * A program holds its outputs through a shared pointer, which copies of the
+ * program share, and replaces them with new ones every time it is evaluated.
+ * Outputs are never modified once built, so children evaluated on other
+ * threads can read the outputs of their parents.
+ *
+ * Outputs are only read and retained inside a `Scope`. Evaluation opens one
+ * around the datasets that live as long as the run, since entries are tied
+ * to the id of their dataset (see Dataset::get_id). See Parameters::retain_outputs.
+ */
+class NodeOutputs
+{
+public:
+    using Entry = SubtreeCache::Entry;
+
+    /// @brief enables or disables retained outputs on the calling thread,
+    /// for the lifetime of the scope
+    class Scope
+    {
+    public:
+        explicit Scope(bool enable);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        bool previous;
+    };
+
+    /// @brief whether outputs are retained on the calling thread
+    static bool active();
+
+    /// @brief the outputs of both parents of a crossover
+    static std::shared_ptr<const NodeOutputs> merge(
+        const std::shared_ptr<const NodeOutputs>& a,
+        const std::shared_ptr<const NodeOutputs>& b);
+
+    NodeOutputs() = default;
+
+    /// @brief the output of the subtree at `tn` on `d`, or null
+    std::shared_ptr<const Entry> find(std::size_t hash, const TreeNode* tn,
+                                      const Dataset& d) const;
+
+    /// @brief adds the output of a subtree with structural hash `hash`
+    void insert(std::size_t hash, std::shared_ptr<const Entry> entry);
+
+    /// @brief copies the outputs of `other` on datasets other than `d`
+    void keep_others(const NodeOutputs& other, const Dataset& d);
+
+    inline size_t size() const { return entries.size(); };
+    /// @brief bytes held by the outputs. Entries may be shared with other
+    /// programs.
+    size_t get_n_bytes() const;
+
+private:
+    static thread_local bool enabled;
+
+    std::unordered_map<std::size_t, std::shared_ptr<const Entry>> entries;
+};
+
+} // Brush
+#endif
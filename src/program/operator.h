@@ -4,6 +4,7 @@
 #include "../init.h"
 #include "tree_node.h"
 #include "../util/utils.h"
+#include "../util/arena.h"
 
 namespace Brush{
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -25,7 +26,7 @@ namespace util{
         {
             if constexpr (std::is_floating_point_v<decltype(tn.data.W)> || std::is_integral_v<decltype(tn.data.W)>) {
                 if (std::isnan(tn.data.W) || tn.data.W == std::numeric_limits<decltype(tn.data.W)>::lowest()) {
-                    HANDLE_ERROR_THROW("TreeNode weight (W) is not set or is invalid for node: " + tn.data.name);
+                    HANDLE_ERROR_THROW("TreeNode weight (W) is not set or is invalid for node: " + tn.data.name.get());
                 }
             }
 
@@ -36,7 +37,7 @@ namespace util{
             if (*weights == nullptr) {
                 std::string err_msg = "Null pointer dereference: *weights is nullptr. "
                                     "TreeNode ret_type: " + std::to_string(static_cast<int>(tn.data.ret_type)) +
-                                    ", name: " + tn.data.name;
+                                    ", name: " + tn.data.name.get();
                 HANDLE_ERROR_THROW("Null pointer dereference: *weights is nullptr. " + err_msg);
             }
 
@@ -109,6 +110,13 @@ struct Operator
     /// @brief stores the argument count of the operator
     static constexpr size_t ArgCount = S::ArgCount;
 
+    /// @brief whether the operator reduces its arguments row-wise in an 
+    /// order that does not matter, so that they are folded into the output
+    /// one at a time rather than stacked into an array and reduced.
+    static constexpr bool Fold = is_in_v<NT, NodeType::Sum, NodeType::Prod,
+        NodeType::Min, NodeType::Max, NodeType::Mean> 
+        && (S::ArgCount > 1) && is_same_v<typename S::FirstArg, RetType>;
+
     /// utility for returning the type of the Nth argument
     template <std::size_t N>
     using NthType = typename S::template NthType<N>;
@@ -200,8 +208,76 @@ struct Operator
         return get_kids_seq<T>(d, tn, weights, std::make_index_sequence<ArgCount>{});
     };
 
+    /// @brief get the kids from the slots of a compiled program, where they
+    /// were written by the instructions of the children. The slots are moved
+    /// from. Stacked kids are copied to a buffer of the arena, and the child
+    /// outputs are given back to it.
+    /// @tparam T argument types 
+    /// @param d the dataset
+    /// @param slots outputs of the children, in order
+    /// @return the child arguments
+    template<typename T=ArgTypes> requires(is_std_array_v<T> || is_eigen_array_v<T>) 
+    T get_kids(const Dataset& d, Data::State* slots) const
+    {
+        T child_outputs;
+        using arg_type = std::conditional_t<is_std_array_v<T>,
+            typename T::value_type, Array<typename S::FirstArg::Scalar, -1, 1>>;
+        auto& arena = Util::BufferArena::local();
+        if constexpr (is_eigen_array_v<T>)
+            child_outputs = arena.template acquire<T>(d.get_n_samples());
+
+        for (int i = 0; i < ArgCount; ++i)
+        {
+            if constexpr(is_std_array_v<T>)
+                child_outputs.at(i) = std::get<arg_type>(std::move(slots[i]));
+            else
+            {
+                child_outputs.col(i) = std::get<arg_type>(slots[i]);
+                arena.release(std::get<arg_type>(std::move(slots[i])));
+            }
+        }
+        return child_outputs;
+    };
+
+    template<typename T, size_t ...Is> requires(is_tuple_v<T>) 
+    T get_kids_seq(Data::State* slots, std::index_sequence<Is...>) const 
+    { 
+        return std::make_tuple(std::get<NthType<Is>>(std::move(slots[Is]))...);
+    };
+
+    template<typename T=ArgTypes> requires(is_tuple_v<T>) 
+    T get_kids(const Dataset& d, Data::State* slots) const
+    {
+        return get_kids_seq<T>(slots, std::make_index_sequence<ArgCount>{});
+    };
+
     ///////////////////////////////////////////////////////////////////////////
 
+    /// @brief whether the node function has a vectorized kernel for float
+    /// arguments of type T. See FastKernel.
+    template<typename T>
+    static constexpr bool has_fast_kernel()
+    {
+        if constexpr (is_std_array_v<T> && is_one_of_v<RetType, ArrayXf, ArrayXXf>)
+            return is_same_v<typename T::value_type, RetType>
+                && std::tuple_size_v<T> == FastKernel<NT>::arity;
+        else
+            return false;
+    }
+
+    /// @brief Apply the vectorized kernel of the node function, writing the
+    /// result to `out`
+    template<typename T>
+    void apply_fast(RetType& out, const T& inputs) const
+    {
+        const auto& x = inputs[0];
+        out.resize(x.rows(), x.cols());
+        if constexpr (FastKernel<NT>::arity == 1)
+            FastKernel<NT>::run(x.data(), out.data(), x.size());
+        else
+            FastKernel<NT>::run(x.data(), inputs[1].data(), out.data(), x.size());
+    }
+
     /// @brief Apply node function in a functional style
     /// @tparam T argument types
     /// @param inputs the child node outputs
@@ -209,6 +285,15 @@ struct Operator
     template<typename T=ArgTypes> requires ( is_std_array_v<T> || is_tuple_v<T>)
     RetType apply(const T& inputs) const
     {
+        if constexpr (has_fast_kernel<T>())
+        {
+            if (Util::FastMath::enabled())
+            {
+                RetType out;
+                apply_fast(out, inputs);
+                return out;
+            }
+        }
         return std::apply(F, inputs);
     }
 
@@ -222,17 +307,44 @@ struct Operator
         return F(inputs);
     }
 
-    /// @brief evaluate the operator on the data. main entry point. 
+    /// @brief Apply the node function, writing the result to `out`
+    /// @tparam T argument types
+    /// @param out buffer for the output
+    /// @param inputs the child node outputs
+    template<typename T=ArgTypes> requires ( is_std_array_v<T> || is_tuple_v<T>)
+    void apply(RetType& out, const T& inputs) const
+    {
+        if constexpr (has_fast_kernel<T>())
+        {
+            if (Util::FastMath::enabled())
+            {
+                apply_fast(out, inputs);
+                return;
+            }
+        }
+        out = std::apply(F, inputs);
+    }
+
+    /// @brief Apply the node function, writing the result to `out`
+    /// @tparam T argument types
+    /// @param out buffer for the output
+    /// @param inputs the child node outputs
+    template<typename T=ArgTypes> requires ( is_eigen_array_v<T> && !is_std_array_v<T>)
+    void apply(RetType& out, const T& inputs) const
+    {
+        out = F(inputs);
+    }
+
+    /// @brief apply the node function and then the node weight, if any.
     /// @tparam T argument types
     /// @tparam Scalar the underlying scalar type of the return type
-    /// @param d dataset
+    /// @param inputs the child node outputs
     /// @param tn tree node
     /// @param weights option pointer to a weight array, used in place of node weight
     /// @return output values from applying operator function 
     template<typename T=ArgTypes, typename Scalar=RetType::Scalar>
-    RetType eval(const Dataset& d, TreeNode& tn, const W** weights=nullptr) const
+    RetType apply_weighted(const T& inputs, TreeNode& tn, const W** weights) const
     {
-        auto inputs = get_kids(d, tn, weights);
         if constexpr (is_one_of_v<Scalar,float,fJet>)
         {
             if (tn.data.get_is_weighted())
@@ -247,9 +359,8 @@ struct Operator
     // overloaded version for offset sum
     template<typename T=ArgTypes, typename Scalar=RetType::Scalar>
     requires is_in_v<NT, NodeType::OffsetSum>
-    RetType eval(const Dataset& d, TreeNode& tn, const W** weights=nullptr) const
+    RetType apply_weighted(const T& inputs, TreeNode& tn, const W** weights) const
     {
-        auto inputs = get_kids(d, tn, weights);
         if constexpr (is_one_of_v<Scalar,float,fJet>)
         {
             if (tn.data.get_is_weighted())
@@ -260,6 +371,135 @@ struct Operator
         }
         return this->apply(inputs);
     };
+
+    /// @brief apply the node function and then the node weight, if any, 
+    /// writing the result to `out`.
+    template<typename T=ArgTypes>
+    void apply_weighted(RetType& out, const T& inputs, TreeNode& tn, const W** weights) const
+    {
+        this->apply(out, inputs);
+        this->apply_weight(out, tn, weights);
+    };
+
+    /// @brief apply the node weight, if any, to the output of the node
+    template<typename Scalar=RetType::Scalar>
+    void apply_weight(RetType& out, TreeNode& tn, const W** weights) const
+    {
+        if constexpr (is_one_of_v<Scalar,float,fJet>)
+        {
+            if (tn.data.get_is_weighted())
+            {
+                auto w = util::get_weight<RetType,Scalar,W>(tn, weights);
+                if constexpr (NT == NodeType::OffsetSum)
+                    out += w;
+                else
+                    out *= w;
+            }
+        }
+    };
+
+    /// @brief folds the output of the next argument into `out`, which holds
+    /// the reduction of the previous ones. See Fold.
+    void fold(RetType& out, const RetType& x) const requires(Fold)
+    {
+        if constexpr (NT == NodeType::Prod)
+            out *= x;
+        else if constexpr (NT == NodeType::Min)
+            out = out.min(x);
+        else if constexpr (NT == NodeType::Max)
+            out = out.max(x);
+        else
+            out += x;
+    };
+
+    /// @brief completes the fold of all arguments into `out`
+    void end_fold(RetType& out) const requires(Fold)
+    {
+        if constexpr (NT == NodeType::Mean)
+            out /= typename RetType::Scalar(ArgCount);
+    };
+
+    /// @brief evaluate the operator on the data. main entry point. 
+    /// @param d dataset
+    /// @param tn tree node
+    /// @param weights option pointer to a weight array, used in place of node weight
+    /// @return output values from applying operator function 
+    RetType eval(const Dataset& d, TreeNode& tn, const W** weights=nullptr) const
+    {
+        if constexpr (Fold)
+        {
+            // each child is folded into the output as soon as it is evaluated
+            RetType out;
+            TreeNode* sib = tn.first_child;
+            for (int i = 0; i < ArgCount; ++i)
+            {
+                if (sib == nullptr)
+                    HANDLE_ERROR_THROW("bad sibling ptr in eval");
+                RetType x;
+                if constexpr (Fit)
+                    x = sib->fit<RetType>(d);
+                else
+                    x = sib->predict<RetType>(d, weights);
+
+                if (i == 0)
+                    out = std::move(x);
+                else
+                    this->fold(out, x);
+                sib = sib->next_sibling;
+            }
+            this->end_fold(out);
+            this->apply_weight(out, tn, weights);
+            return out;
+        }
+        else
+            return this->apply_weighted(get_kids(d, tn, weights), tn, weights);
+    };
+
+    /// @brief evaluate the operator on child outputs stored in the slots of
+    /// a compiled program. 
+    RetType eval(const Dataset& d, TreeNode& tn, Data::State* slots, 
+                 const W** weights=nullptr) const
+    {
+        if constexpr (Fold)
+        {
+            RetType out;
+            this->eval(d, tn, slots, out, weights);
+            return out;
+        }
+        else
+            return this->apply_weighted(get_kids(d, slots), tn, weights);
+    };
+
+    /// @brief evaluate the operator on child outputs stored in the slots of
+    /// a compiled program, writing to `out`. The child outputs are given
+    /// back to the arena once they are used.
+    ///
+    /// Folds start from the buffer of the first child, and accumulate the
+    /// others into it, so that they never stack their arguments.
+    void eval(const Dataset& d, TreeNode& tn, Data::State* slots, RetType& out,
+              const W** weights=nullptr) const
+    {
+        auto& arena = Util::BufferArena::local();
+        if constexpr (Fold)
+        {
+            arena.release(std::move(out));
+            out = std::get<RetType>(std::move(slots[0]));
+            for (int i = 1; i < ArgCount; ++i)
+            {
+                const auto& x = std::get<RetType>(slots[i]);
+                this->fold(out, x);
+                arena.release(std::get<RetType>(std::move(slots[i])));
+            }
+            this->end_fold(out);
+            this->apply_weight(out, tn, weights);
+        }
+        else
+        {
+            auto inputs = get_kids(d, slots);
+            this->apply_weighted(out, inputs, tn, weights);
+            arena.release(std::move(inputs));
+        }
+    };
 };
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -275,15 +515,17 @@ struct Operator<NodeType::Terminal, S, Fit>
         requires (is_one_of_v<Scalar,bool,int,float>)
     RetType eval(const Dataset& d, const TreeNode& tn, const W** weights=nullptr) const 
     { 
-        if constexpr (is_one_of_v<Scalar,float,fJet>)
-        {
-            if (tn.data.get_is_weighted())
+        return this->get<RetType>(d, tn, [&](const auto& x) -> RetType {
+            if constexpr (is_one_of_v<Scalar,float,fJet>)
             {
-                auto w = util::get_weight<RetType,Scalar,W>(tn, weights);
-                return this->get<RetType>(d, tn.data.get_feature())*w;
+                if (tn.data.get_is_weighted())
+                {
+                    auto w = util::get_weight<RetType,Scalar,W>(tn, weights);
+                    return x*w;
+                }
             }
-        }
-        return this->get<RetType>(d,tn.data.get_feature());
+            return x;
+        });
     };
 
     // Jet types
@@ -292,31 +534,46 @@ struct Operator<NodeType::Terminal, S, Fit>
     RetType eval(const Dataset &d, const TreeNode &tn, const W **weights = nullptr) const
     {
         using nonJetType = UnJetify_t<RetType>; 
+        return this->get<nonJetType>(d, tn, [&](const auto& x) -> RetType {
+            if constexpr (is_one_of_v<Scalar,float,fJet>)
+            {
+                if (tn.data.get_is_weighted())
+                {
+                    auto w = util::get_weight<RetType,Scalar,W>(tn, weights);
+                    return x.template cast<Scalar>()*w;
+                }
+            }
+            return x.template cast<Scalar>();
+        });
+    };
+
+    /// @brief evaluate the leaf, writing to `out`
+    void eval(const Dataset& d, const TreeNode& tn, RetType& out, 
+              const W** weights=nullptr) const 
+    { 
+        using Scalar = typename RetType::Scalar;
+        if constexpr (is_one_of_v<Scalar, bJet, iJet, fJet>)
+            this->get<UnJetify_t<RetType>>(d, tn, [&](const auto& x){ 
+                out = x.template cast<Scalar>(); });
+        else
+            this->get<RetType>(d, tn, [&](const auto& x){ out = x; });
+
         if constexpr (is_one_of_v<Scalar,float,fJet>)
         {
             if (tn.data.get_is_weighted())
-            {
-                auto w = util::get_weight<RetType,Scalar,W>(tn, weights);
-                return this->get<nonJetType>(d, tn.data.get_feature()).template cast<Scalar>()*w;
-            }
+                out *= util::get_weight<RetType,Scalar,W>(tn, weights);
         }
-        return this->get<nonJetType>(d, tn.data.get_feature()).template cast<Scalar>();
     };
 
-    // Accessing dataset directly
-    template<typename T>
-    auto get(const Dataset& d, const string& feature) const
+    // Accessing dataset directly. The rows are borrowed, also from windows
+    // (see Dataset::visit_column), so the only allocation made by a leaf is
+    // its output.
+    template<typename T, typename F>
+    auto get(const Dataset& d, const TreeNode& tn, F&& f) const
     {
-        if (std::holds_alternative<T>(d[feature]))
-            return std::get<T>(d[feature]); 
-
-        HANDLE_ERROR_THROW(fmt::format("Failed to return type {} for '{}'. The feature's original ret type is {}.\n",
-            DataTypeEnum<T>::value,
-            feature,
-            DataTypeName.at(d.get_feature_type(feature))
-        ));
-
-        return T(); 
+        return d.template visit_column<T>(
+            d.get_column_id(tn.data.get_feature_id(), tn.data.get_feature_handle()),
+            std::forward<F>(f));
     }
 };
 
@@ -344,7 +601,15 @@ struct Operator<NodeType::Constant, S, Fit>
         else
             return RetType::Constant(d.get_n_samples(), d.get_n_features(), w); 
     };
-    
+
+    /// @brief evaluate the constant, writing to `out`
+    void eval(const Dataset& d, TreeNode& tn, RetType& out, 
+              const W** weights=nullptr) const 
+    { 
+        using Scalar = typename RetType::Scalar;
+        out.setConstant(d.get_n_samples(), 
+                        util::get_weight<RetType,Scalar,W>(tn, weights)); 
+    };
 };
 
 ////////////////////////////////////////////////////////////////////////////
@@ -423,6 +688,33 @@ inline R DispatchOp(const Dataset& d, TreeNode& tn)
     return op.eval(d, tn);
 };
 
+/// @brief instruction of a compiled program. Leaves have no child outputs,
+/// and splits evaluate their children on partitions of the data, so both
+/// are evaluated like in DispatchOp.
+///
+/// Array outputs are written to a buffer drawn from the arena of the 
+/// thread, and the children give their buffers back once they are used.
+template<typename R, NodeType NT, typename S, bool Fit, typename W> 
+inline void ExecOp(const Dataset& d, TreeNode& tn, Data::State* slots, const W** weights) 
+{
+    const auto op = Operator<NT,S,Fit>{};
+    constexpr bool recursive = is_in_v<NT, NodeType::SplitOn, NodeType::SplitBest, 
+                                       NodeType::MeanLabel>;
+    if constexpr (!recursive && Util::is_arena_buffer_v<R>)
+    {
+        R out = Util::BufferArena::local().template acquire<R>(d.get_n_samples());
+        if constexpr (S::ArgCount == 0)
+            op.eval(d, tn, out, weights);
+        else
+            op.eval(d, tn, slots, out, weights);
+        slots[0].template emplace<R>(std::move(out));
+    }
+    else if constexpr (S::ArgCount == 0 || recursive)
+        slots[0].template emplace<R>(op.eval(d, tn, weights));
+    else
+        slots[0].template emplace<R>(op.eval(d, tn, slots, weights));
+};
+
 } // Brush
 
 #endif
@@ -32,9 +32,23 @@ struct ResidualEvaluator {
     typedef float Scalar; 
     ResidualEvaluator(PT& program, Dataset const& dataset)
         : program_(program)
-        , dataset_(dataset)
+        , dataset_(&dataset)
         , numParameters_(program.get_weights().size())
-        , y_true_(dataset.y)
+        , classification_(dataset.classification)
+        , y_true_(dataset.y.data(), dataset.y.size())
+    {}
+
+    /// evaluates the residuals on row blocks of `source`, so that only one
+    /// block of features is in memory at a time. Only the target, the
+    /// residuals and the jacobian span every sample.
+    ResidualEvaluator(PT& program, ChunkSource const& source, size_t chunk_size)
+        : program_(program)
+        , source_(&source)
+        , chunkSize_(chunk_size)
+        , numParameters_(program.get_weights().size())
+        , classification_(source.is_classification())
+        , y_owned_(std::make_shared<ArrayXf>(source.get_y()))
+        , y_true_(y_owned_->data(), y_owned_->size())
     {}
 
     template<typename T>
@@ -45,19 +59,48 @@ struct ResidualEvaluator {
 
     template <typename T>
     auto operator()(T const* parameters, T* residuals) const -> bool
+    {
+        using ArrayType = Array<T, Dynamic, 1>; // ColMajor?
+        auto residualMap = ArrayType::Map(residuals, NumResiduals());
+
+        if (source_ == nullptr)
+        {
+            compute_residuals(*dataset_, GetTarget(), parameters, residualMap);
+        }
+        else
+        {
+            source_->for_each_chunk(chunkSize_, [&](size_t start, const Dataset& chunk){
+                const size_t n = chunk.get_n_samples();
+                auto residualSegment = residualMap.segment(start, n);
+                compute_residuals(chunk, GetTarget().segment(start, n), parameters,
+                                  residualSegment);
+            });
+        }
+
+        return true;
+    }
+
+    [[nodiscard]] auto NumParameters() const -> size_t { return numParameters_; }
+    [[nodiscard]] auto NumResiduals() const -> size_t { return y_true_.size(); }
+    inline auto GetProgram() const { return program_.get();};
+    inline const Dataset& GetDataset() const { return *dataset_;};
+    inline const auto& GetTarget() const { return y_true_;};
+
+private:
+    template <typename T, typename Y, typename R>
+    void compute_residuals(const Dataset& data, const Y& y, T const* parameters,
+                           R& residualMap) const
     {
         using ArrayType = Array<T, Dynamic, 1>; // ColMajor?
         const T ** new_weights = &parameters; 
 
         ArrayType y_pred = GetProgram().template predict_with_weights<ArrayType>(
-            GetDataset(), 
+            data, 
             new_weights
         );
 
-        auto residualMap = ArrayType::Map(residuals, GetDataset().get_n_samples());
-
         // how we calculate the residuals
-        if (GetDataset().classification) // classification
+        if (classification_) // classification
         {
             // tolerance to avoid numeric errors.
 
@@ -70,8 +113,6 @@ struct ResidualEvaluator {
             // we are biasing the predictions away from 0 and 1
             float eps = 1e-6f;
 
-            auto y = GetTarget();
-
             // cout << T(1.0) << ", " << T(eps) << endl;
 
             // clamp values and avoid log(0)
@@ -82,23 +123,18 @@ struct ResidualEvaluator {
             residualMap = -(y*log(y_pred) + (T(1.0)-y)*log(T(1.0)-y_pred));
         }
         else { // This is MSE, default behavior
-            residualMap = (y_pred - GetTarget()); 
+            residualMap = (y_pred - y); 
         }
-
-        return true;
     }
 
-    [[nodiscard]] auto NumParameters() const -> size_t { return numParameters_; }
-    [[nodiscard]] auto NumResiduals() const -> size_t { return y_true_.get().size(); }
-    inline auto GetProgram() const { return program_.get();};
-    inline auto GetDataset() const { return dataset_.get();};
-    inline auto GetTarget() const { return y_true_.get();};
-
-private:
     std::reference_wrapper<PT> program_;
-    std::reference_wrapper<Dataset const> dataset_;
-    std::reference_wrapper<ArrayXf const> y_true_;
+    Dataset const* dataset_ = nullptr;
+    ChunkSource const* source_ = nullptr;
+    size_t chunkSize_ = 0;
     size_t numParameters_; // cache the number of parameters in the tree
+    bool classification_;
+    std::shared_ptr<ArrayXf> y_owned_; // the target of a chunk source
+    Map<const ArrayXf> y_true_;
 };
 
 // TODO: see this struct and try to understand how to make non-templated classes
@@ -114,11 +150,34 @@ struct WeightOptimizer
         if (program.get_n_weights() == 0)
             return;
             
+        ResidualEvaluator<PT> evaluator(program, dataset);
+        solve(program, evaluator);
+    }
+
+    /// @brief Update program weights using non-linear least squares, 
+    /// evaluating the program on row blocks of a source.
+    /// @tparam PT the program type 
+    /// @param program the program 
+    /// @param source the rows, e.g. a DatasetFile
+    /// @param chunk_size number of rows evaluated at a time
+    template<typename PT>
+    void update(PT& program, const ChunkSource& source, size_t chunk_size)
+    {
+        if (program.get_n_weights() == 0)
+            return;
+
+        ResidualEvaluator<PT> evaluator(program, source, chunk_size);
+        solve(program, evaluator);
+    }
+
+private:
+    template<typename PT>
+    void solve(PT& program, ResidualEvaluator<PT>& evaluator)
+    {
         // fmt::print("number of weights: {}\n",program.get_n_weights());
         auto init_weights = program.get_weights();
 
         using CFType = Brush::TinyCostFunction<ResidualEvaluator<PT>> ; 
-        ResidualEvaluator<PT> evaluator(program, dataset);
         CFType cost_function(evaluator);
         ceres::TinySolver<CFType> solver;
         solver.options.max_num_iterations = 10;
@@ -16,11 +16,14 @@ license: GNU/GPL v3
 // #include "data/data.h"
 #include "../init.h"
 #include "tree_node.h"
+#include "flat_tree.h"
+#include "cpp_model.h"
 #include "node.h"
 #include "../vary/search_space.h"
 #include "../params.h"
 #include "../util/utils.h"
 #include "functions.h"
+#include "compiled_program.h"
 // #include "../variation.h"
 // #include "weight_optimizer.h"
 
@@ -28,6 +31,8 @@ license: GNU/GPL v3
 using std::cout;
 using std::string;
 using Brush::Data::Dataset;
+using Brush::Data::DatasetView;
+using Brush::Data::ChunkSource;
 using Brush::SearchSpace;
 
 namespace Brush {
@@ -74,15 +79,40 @@ template<PT PType> struct Program
     /// reference to search space
     std::optional<std::reference_wrapper<SearchSpace>> SSref;
 
+    /// postfix versions of the tree used for fitting and prediction, 
+    /// regenerated lazily when the tree changes
+    CompiledProgram<true> compiled_fit;
+    CompiledProgram<false> compiled_predict;
+    /// postfix version of the dual tree, used by the weight optimizer
+    CompiledProgram<false,fJet> compiled_dual;
+
+    /// outputs of the nodes from the last prediction, retained when 
+    /// Parameters::retain_outputs is set. Copies of the program, such as the
+    /// offspring made by variation, share them until they are evaluated.
+    std::shared_ptr<const NodeOutputs> outputs;
+
     Program() = default;
     Program(const std::reference_wrapper<SearchSpace> s, const tree<Node> t)
         : Tree(t), is_fitted_(false)
     {
         SSref = std::optional<std::reference_wrapper<SearchSpace>>{s};
     }
+    Program(const std::reference_wrapper<SearchSpace> s, const FlatTree& t)
+        : Program(s, t.to_tree())
+    {}
 
     Program<PType> copy() { return Program<PType>(*this); }
 
+    /// @brief drops the compiled versions of the tree, which point into its
+    /// nodes. Call it after editing `Tree` in place; they are compiled again
+    /// on the next evaluation.
+    void tree_changed()
+    {
+        compiled_fit.clear();
+        compiled_predict.clear();
+        compiled_dual.clear();
+    }
+
     inline void set_search_space(const std::reference_wrapper<SearchSpace> s)
     {
         SSref = std::optional<std::reference_wrapper<SearchSpace>>{s};
@@ -149,13 +179,40 @@ template<PT PType> struct Program
 
     Program<PType>& fit(const Dataset& d)
     {
-        TreeType out =  Tree.begin().node->fit<TreeType>(d);
+        TreeType out = compiled_fit.template run<TreeType>(Tree, d, nullptr, &outputs);
         this->is_fitted_ = true;
         update_weights(d);
         // this->valid = true;
         return *this;
     };
 
+    /**
+     * @brief fit the program, optimizing its weights on row tiles of the data
+     * (see Parameters::eval_tile_size). Thresholds of splits and other 
+     * node parameters are still fitted on all rows at once.
+     * 
+     * @param d the data
+     * @param tile_size number of rows evaluated at a time. 0 fits on all rows.
+     * @return reference to the program
+     */
+    Program<PType>& fit(const Dataset& d, size_t tile_size)
+    {
+        if (tile_size == 0 || size_t(d.get_n_samples()) <= tile_size)
+            return fit(d);
+
+        TreeType out = compiled_fit.template run<TreeType>(Tree, d, nullptr, &outputs);
+        this->is_fitted_ = true;
+        update_weights(tiles(d), tile_size);
+        return *this;
+    };
+
+    /// @brief row tiles of `d`, for use with the chunked versions of predict
+    /// and update_weights. Tiles read the columns of `d` in place.
+    Data::DatasetChunks tiles(const Dataset& d) const
+    {
+        return Data::DatasetChunks(d);
+    };
+
     /**
      * @brief Replace the current program with a new program, invalidating fitness.
      * 
@@ -166,6 +223,7 @@ template<PT PType> struct Program
     {
         this->Tree = new_program.Tree;
         this->is_fitted_ = false;
+        tree_changed();
         
         // Update search space reference if the new program has one, otherwise keep current
         if (new_program.SSref.has_value())
@@ -187,13 +245,34 @@ template<PT PType> struct Program
         return replace_program(new_program);
     };
 
+    /**
+     * @brief Replace the current program tree with a flat one, invalidating fitness.
+     * 
+     * @param t the new program, as an array of nodes
+     * @return reference to this program
+     */
+    Program<PType>& replace_program(const FlatTree& t)
+    {
+        this->Tree = t.to_tree();
+        this->is_fitted_ = false;
+        tree_changed();
+        return *this;
+    };
+
+    /// @brief the program tree as a contiguous array of nodes in prefix
+    /// order. Its json is the same as the one of `Tree`.
+    FlatTree flatten() const { return FlatTree(Tree); };
+
     template <typename R, typename W>
     R predict_with_weights(const Dataset &d, const W** weights)
     {
         if (!is_fitted_)
             HANDLE_ERROR_THROW("Program is not fitted. Call 'fit' first.\n");
 
-        return Tree.begin().node->predict<R>(d, weights);
+        if constexpr (is_same_v<W, float>)
+            return compiled_predict.template run<R>(Tree, d, weights);
+        else
+            return compiled_dual.template run<R>(Tree, d, weights);
     };
 
     auto predict_with_weights(const Dataset &d, const ArrayXf& weights)
@@ -216,7 +295,7 @@ template<PT PType> struct Program
         if (!is_fitted_)
             HANDLE_ERROR_THROW("Program is not fitted. Call 'fit' first.\n");
 
-        return Tree.begin().node->predict<TreeType>(d);
+        return compiled_predict.template run<TreeType>(Tree, d, nullptr, &outputs);
     };
 
     /// @brief Specialized predict function for binary classification. 
@@ -229,7 +308,7 @@ template<PT PType> struct Program
         if (!is_fitted_)
             HANDLE_ERROR_THROW("Program is not fitted. Call 'fit' first.\n");
             
-        return (Tree.begin().node->predict<TreeType>(d) > 0.5);
+        return (compiled_predict.template run<TreeType>(Tree, d, nullptr, &outputs) > 0.5);
     };
 
     /// @brief Specialized predict function for multiclass classification. 
@@ -242,7 +321,7 @@ template<PT PType> struct Program
         if (!is_fitted_)
             HANDLE_ERROR_THROW("Program is not fitted. Call 'fit' first.\n");
 
-        TreeType out = Tree.begin().node->predict<TreeType>(d);
+        TreeType out = compiled_predict.template run<TreeType>(Tree, d, nullptr, &outputs);
         auto argmax = Function<NodeType::ArgMax>{};
         return argmax(out);
     };
@@ -255,6 +334,30 @@ template<PT PType> struct Program
         return predict<TreeType>(d); 
     };
 
+    /**
+     * @brief predict from row blocks of a source, keeping one block of
+     * features in memory at a time. The predictions are the same as those of
+     * predict() on the whole dataset.
+     * 
+     * @param source the rows, e.g. a DatasetFile
+     * @param chunk_size number of rows evaluated at a time
+     * @return predictions for every sample of the source
+     */
+    RetType predict(const ChunkSource& source, size_t chunk_size)
+    {
+        return gather_chunks<RetType>(source, chunk_size,
+            [&](const Dataset& chunk){ return this->predict(chunk); });
+    };
+
+    /// @brief chunked version of predict_proba. See predict(source, chunk_size).
+    template <PT P = PType>
+        requires((P == PT::BinaryClassifier) || (P == PT::MulticlassClassifier))
+    TreeType predict_proba(const ChunkSource& source, size_t chunk_size)
+    {
+        return gather_chunks<TreeType>(source, chunk_size,
+            [&](const Dataset& chunk){ return this->predict_proba(chunk); });
+    };
+
     /// @brief Convenience function to call fit directly from X,y data.
     /// @param X : Input features
     /// @param y : Labels
@@ -296,6 +399,15 @@ template<PT PType> struct Program
      */
     void update_weights(const Dataset& d);
 
+    /**
+     * @brief Updates the program's weights, evaluating it on row blocks of
+     * a source.
+     * 
+     * @param source the rows, e.g. a DatasetFile
+     * @param chunk_size number of rows evaluated at a time
+     */
+    void update_weights(const ChunkSource& source, size_t chunk_size);
+
     /// @brief returns the number of weights in the program.
     int get_n_weights() const
     {
@@ -462,11 +574,12 @@ template<PT PType> struct Program
     /**
      * @brief Get the model as a string
      * 
-     * @param fmt one of "compact", "tree", or "dot". Default "compact".  
+     * @param fmt one of "compact", "tree", "dot", or "cpp". Default "compact".  
      * 
      *  - *compact* : the program as an equation. 
      *  - *tree* : the program as a (small batch, artisinal) tree. 
      *  - *dot* : the program in the dot language for downstream visualization.
+     *  - *cpp* : the program as the source of a C++ function, for scoring outside of Brush.
      * 
      * @param pretty currently unused. 
      * @return string the model in string form.  
@@ -476,11 +589,25 @@ template<PT PType> struct Program
         auto head = Tree.begin(); 
         if (fmt=="tree")
             return head.node->get_tree_model(pretty);
+        else if (fmt=="cpp")
+            return get_cpp_model();
         else if (fmt=="dot")
             return get_dot_model(); ;
         return head.node->get_model(pretty);
     }
 
+    /**
+     * @brief Get the model as the source of a self-contained C++ function,
+     * with the weights as constants. See Brush::get_cpp_model.
+     * 
+     * @param name name of the function
+     * @return string the model in C++. 
+     */
+    string get_cpp_model(string name="brush_predict") const
+    {
+        return Brush::get_cpp_model(Tree, name);
+    }
+
     /**
      * @brief Get the model as a dot object
      * 
@@ -661,6 +788,20 @@ template<PT PType> struct Program
             linear_program.push_back(i.node->data);
         return linear_program;
     }
+
+    /// @brief evaluates `f` on row blocks of `source` and stacks the outputs.
+    template<typename R, typename F>
+    static R gather_chunks(const ChunkSource& source, size_t chunk_size, F&& f)
+    {
+        R out;
+        source.for_each_chunk(chunk_size, [&](size_t start, const Dataset& chunk){
+            R part = f(chunk);
+            if (start == 0)
+                out.resize(source.get_n_samples(), part.cols());
+            out.middleRows(start, part.rows()) = part;
+        });
+        return out;
+    }
 }; // Program
 } // Brush
 
@@ -680,6 +821,13 @@ void Program<PType>::update_weights(const Dataset& d)
     WO.update((*this), d);
 };
 
+template<ProgramType PType> 
+void Program<PType>::update_weights(const ChunkSource& source, size_t chunk_size)
+{
+    auto WO = WeightOptimizer(); 
+    WO.update((*this), source, chunk_size);
+};
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // serialization
@@ -695,6 +843,7 @@ void from_json(const json &j, Program<PType>& p)
 {
     j.at("Tree").get_to(p.Tree);
     j.at("is_fitted_").get_to(p.is_fitted_);
+    p.tree_changed();
 }
 
 }//namespace Brush
@@ -337,11 +337,18 @@ struct Signatures<N, enable_if_t<is_in_v<N,
     NodeType::After,
     NodeType::During
     >>>{ 
-        //TODO: Fix
+        // the first argument is filtered by the times of the second, 
+        // which may hold any type of time series
         using type = std::tuple<
             Signature<TimeSeriesf(TimeSeriesf,TimeSeriesf)>,
+            Signature<TimeSeriesf(TimeSeriesf,TimeSeriesi)>,
+            Signature<TimeSeriesf(TimeSeriesf,TimeSeriesb)>,
             Signature<TimeSeriesi(TimeSeriesi,TimeSeriesi)>,
-            Signature<TimeSeriesb(TimeSeriesb,TimeSeriesb)>
+            Signature<TimeSeriesi(TimeSeriesi,TimeSeriesf)>,
+            Signature<TimeSeriesi(TimeSeriesi,TimeSeriesb)>,
+            Signature<TimeSeriesb(TimeSeriesb,TimeSeriesb)>,
+            Signature<TimeSeriesb(TimeSeriesb,TimeSeriesf)>,
+            Signature<TimeSeriesb(TimeSeriesb,TimeSeriesi)>
         >;
     }; 
 
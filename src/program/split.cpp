@@ -65,6 +65,20 @@ ArrayXb threshold_mask<State>(const State& x, const float& threshold) {
         x
     );
 }
+ArrayXb threshold_mask(const Dataset& d, size_t id, const float& threshold) { 
+    return std::visit(
+        [&](const auto& column) -> ArrayXb { 
+            using T = std::decay_t<decltype(column)>;
+            if constexpr (T::NumDimensions == 1)
+                return d.template visit_column<T>(id, [&](const auto& x) -> ArrayXb {
+                    return threshold_mask(x, threshold); 
+                });
+            else
+                return ArrayXb::Constant(d.get_n_samples(), true);
+        },
+        d.get_root().columns.at(id)
+    );
+}
 float gain(const ArrayXf& lsplit, 
             const ArrayXf& rsplit, 
             bool classification, vector<float> unique_classes)
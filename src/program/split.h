@@ -50,6 +50,9 @@ namespace Split{
         );
         return ret;
     }
+    /// Applies a learned threshold to feature `id` of d, reading its rows in
+    /// place.
+    ArrayXb threshold_mask(const Dataset& d, size_t id, const float& threshold);
     float gini_impurity_index(const ArrayXf& classes, const vector<float>& uc);
     float gain(const ArrayXf& lsplit, const ArrayXf& rsplit, bool classification, 
             vector<float> unique_classes);
@@ -114,6 +117,20 @@ namespace Split{
 
     }
 
+    /// best threshold of feature `id` of d, which holds a T.
+    template<typename T>
+    tuple<float,float> best_threshold(const Dataset& d, size_t id)
+    {
+        return d.template visit_column<T>(id, [&](const auto& x){
+            // the rows of a window are copied, since thresholds are found
+            // on a T
+            if constexpr (std::is_same_v<std::decay_t<decltype(x)>, T>)
+                return best_threshold(x, d.y, d.classification);
+            else
+                return best_threshold(T(x), d.y, d.classification);
+        });
+    }
+
     template<typename T>
     void get_best_threshold_by_type(const Dataset& d, auto& results)
     {
@@ -126,8 +143,9 @@ namespace Split{
         float threshold=0.0;
         int i = 0;
 
-        if (d.features_of_type.find(DT) != d.features_of_type.end())
-            keys = d.features_of_type.at(DT);
+        const auto& features_of_type = d.get_root().features_of_type;
+        if (features_of_type.find(DT) != features_of_type.end())
+            keys = features_of_type.at(DT);
         else
         {
             /* fmt::print("didn't find features of type {} in data\n",DT); */
@@ -138,7 +156,7 @@ namespace Split{
         {
             float tmp_thresh, score;
 
-            tie(tmp_thresh, score) = best_threshold(std::get<T>(d[key]), d.y, d.classification);
+            tie(tmp_thresh, score) = best_threshold<T>(d, d.get_feature_id(key));
             // fmt::print("best threshold for {} = {:.3f}, score = {:.3f}\n",key,tmp_thresh,score);
             if (score < best_score | i == 0)
             {
@@ -213,7 +231,9 @@ struct Operator<NT, S, Fit, enable_if_t<is_in_v<NT, NodeType::SplitOn, NodeType:
 
         for (int i = 0; i < 2; ++i)
         {
-            if (d.at(i).get_n_samples() > 0)
+            // when the weights come from an array, empty branches are still 
+            // evaluated so that the weights of their subtree are consumed
+            if (d.at(i).get_n_samples() > 0 || (!Fit && weights != nullptr))
             {
                 if constexpr (Fit)
                     child_outputs.at(i) = sib->fit<arg_type>(d.at(i));
@@ -245,16 +265,18 @@ struct Operator<NT, S, Fit, enable_if_t<is_in_v<NT, NodeType::SplitOn, NodeType:
             {
                 // TODO: I think the if-else clausules could be simplified
 
-                auto values = d[tn.data.get_feature()];
+                const size_t id = d.get_column_id(tn.data.get_feature_id(), 
+                                                  tn.data.get_feature_handle());
+                const DataType type = d.get_root().feature_types.at(id);
 
                 if (!tn.data.weight_is_fixed){
                     // Threshold will be optimized regardless.
-                    if (std::holds_alternative<ArrayXf>(values))
-                        tie(threshold, ignore) = Split::best_threshold(std::get<ArrayXf>(values), d.y, d.classification);
-                    else if (std::holds_alternative<ArrayXi>(values))
-                        tie(threshold, ignore) = Split::best_threshold(std::get<ArrayXi>(values), d.y, d.classification);
-                    else if (std::holds_alternative<ArrayXb>(values))
-                        tie(threshold, ignore) = Split::best_threshold(std::get<ArrayXb>(values), d.y, d.classification);
+                    if (type == DataType::ArrayF)
+                        tie(threshold, ignore) = Split::best_threshold<ArrayXf>(d, id);
+                    else if (type == DataType::ArrayI)
+                        tie(threshold, ignore) = Split::best_threshold<ArrayXi>(d, id);
+                    else if (type == DataType::ArrayB)
+                        tie(threshold, ignore) = Split::best_threshold<ArrayXb>(d, id);
                 }
                 
             }
@@ -264,7 +286,7 @@ struct Operator<NT, S, Fit, enable_if_t<is_in_v<NT, NodeType::SplitOn, NodeType:
                     string feature = "";
                     tie(feature, threshold) = Split::get_best_variable_and_threshold(d, tn);
     
-                    tn.data.set_feature(feature);
+                    tn.data.set_feature(feature, d.get_feature_id(feature));
                     tn.data.set_feature_type(d.get_feature_type(feature));
                 }
             }
@@ -286,7 +308,11 @@ struct Operator<NT, S, Fit, enable_if_t<is_in_v<NT, NodeType::SplitOn, NodeType:
             mask.fill(true);
         }
         else if constexpr (NT==NodeType::SplitBest)
-            mask = Split::threshold_mask(d[feature], threshold);
+        {
+            const size_t id = d.get_column_id(tn.data.get_feature_id(), 
+                                              tn.data.get_feature_handle());
+            mask = Split::threshold_mask(d, id, threshold);
+        }
         else {
             auto split_feature = tn.first_child->predict<FirstArg>(d, weights);
             mask = Split::threshold_mask(split_feature, threshold);
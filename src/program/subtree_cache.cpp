@@ -0,0 +1,224 @@
+#include <bit>
+
+#include "subtree_cache.h"
+
+namespace Brush {
+
+thread_local SubtreeCache* SubtreeCache::current = nullptr;
+
+/// nodes whose output depends on their weight even when it is not a
+/// multiplier: constants and split thresholds
+static bool uses_weight(const Node& n)
+{
+    return n.get_is_weighted() 
+        || Is<NodeType::Constant, NodeType::MeanLabel, 
+              NodeType::SplitOn, NodeType::SplitBest>(n.node_type);
+}
+
+static uint32_t weight_bits(const Node& n)
+{
+    return uses_weight(n) ? std::bit_cast<uint32_t>(n.W) : 0;
+}
+
+/// appends the keys of the subtree at `tn` to `nodes`, in pre-order
+static void add_nodes(const TreeNode* tn, vector<SubtreeCache::NodeKey>& nodes)
+{
+    nodes.emplace_back(tn->data);
+    for (auto c = tn->first_child; c != nullptr; c = c->next_sibling)
+        add_nodes(c, nodes);
+}
+
+SubtreeCache::NodeKey::NodeKey(const Node& n)
+    : node_type(n.node_type)
+    , sig_hash(n.sig_hash)
+    , is_weighted(n.get_is_weighted())
+    , W(weight_bits(n))
+    , feature(n.get_feature_handle())
+{}
+
+bool SubtreeCache::NodeKey::matches(const Node& n) const
+{
+    return node_type == n.node_type
+        && sig_hash == n.sig_hash
+        && is_weighted == n.get_is_weighted()
+        && W == weight_bits(n)
+        && feature == n.get_feature_handle();
+}
+
+SubtreeCache::Scope::Scope(SubtreeCache* cache) : previous(current)
+{
+    current = cache;
+}
+
+SubtreeCache::Scope::~Scope()
+{
+    current = previous;
+}
+
+SubtreeCache* SubtreeCache::active()
+{
+    return current;
+}
+
+std::size_t SubtreeCache::node_hash(const Node& n)
+{
+    std::size_t h = std::hash<std::size_t>{}(n.sig_hash);
+    h = combine(h, std::hash<int>{}(static_cast<int>(n.node_type)));
+    h = combine(h, std::hash<bool>{}(n.get_is_weighted()));
+    h = combine(h, std::hash<uint32_t>{}(weight_bits(n)));
+    // features are interned, so equal names share an address
+    h = combine(h, std::hash<const string*>{}(&n.get_feature_handle().get()));
+    return h;
+}
+
+std::size_t SubtreeCache::combine(std::size_t seed, std::size_t child_hash)
+{
+    return seed ^ (child_hash + 0x9e3779b9 + (seed<<6) + (seed>>2));
+}
+
+std::size_t SubtreeCache::subtree_hash(const TreeNode* tn)
+{
+    std::size_t h = node_hash(tn->data);
+    for (auto c = tn->first_child; c != nullptr; c = c->next_sibling)
+        h = combine(h, subtree_hash(c));
+    return h;
+}
+
+size_t SubtreeCache::subtree_size(const TreeNode* tn)
+{
+    size_t n = 1;
+    for (auto c = tn->first_child; c != nullptr; c = c->next_sibling)
+        n += subtree_size(c);
+    return n;
+}
+
+std::size_t SubtreeCache::key(std::size_t hash, uint64_t data_id)
+{
+    return combine(hash, std::hash<uint64_t>{}(data_id));
+}
+
+bool SubtreeCache::matches(const TreeNode* tn, const vector<NodeKey>& nodes,
+                           size_t& i)
+{
+    if (i >= nodes.size() || !nodes.at(i).matches(tn->data))
+        return false;
+    ++i;
+    for (auto c = tn->first_child; c != nullptr; c = c->next_sibling)
+        if (!matches(c, nodes, i))
+            return false;
+    return true;
+}
+
+std::shared_ptr<const SubtreeCache::Entry> SubtreeCache::make_entry(
+    const TreeNode* tn, const Dataset& d, const Data::State& output)
+{
+    const size_t output_bytes = std::visit([](const auto& out) -> size_t {
+        using T = std::decay_t<decltype(out)>;
+        if constexpr (is_eigen_array_v<T>)
+            return out.size()*sizeof(typename T::Scalar);
+        else
+            return 0;
+    }, output);
+
+    // only arrays are stored
+    if (output_bytes == 0)
+        return nullptr;
+
+    auto entry = std::make_shared<Entry>();
+    entry->data_id = d.get_id();
+    entry->output = output;
+    entry->n_bytes = output_bytes;
+    entry->nodes.reserve(subtree_size(tn));
+    add_nodes(tn, entry->nodes);
+    return entry;
+}
+
+bool SubtreeCache::is_entry_of(const Entry& entry, const TreeNode* tn, 
+                               const Dataset& d)
+{
+    size_t i = 0;
+    return entry.data_id == d.get_id() && matches(tn, entry.nodes, i) 
+        && i == entry.nodes.size();
+}
+
+std::shared_ptr<const SubtreeCache::Entry> SubtreeCache::find(
+    std::size_t hash, const TreeNode* tn, const Dataset& d, bool& store)
+{
+    const auto k = key(hash, d.get_id());
+
+    std::shared_ptr<const Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        ++n_lookups;
+        store = false;
+
+        auto it = entries.find(k);
+        if (it == entries.end())
+        {
+            store = !seen.insert(k).second;
+            return nullptr;
+        }
+        entry = it->second;
+    }
+
+    // entries are immutable, so the nodes are compared without the lock.
+    // On a hash collision, the stored subtree keeps its entry.
+    if (!is_entry_of(*entry, tn, d))
+        return nullptr;
+
+    ++n_hits;
+    bytes_saved += entry->n_bytes*entry->nodes.size();
+    return entry;
+}
+
+void SubtreeCache::insert(std::size_t hash, std::shared_ptr<const Entry> entry)
+{
+    if (entry == nullptr)
+        return;
+
+    const auto k = key(hash, entry->data_id);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (entry->n_bytes > max_bytes || entries.find(k) != entries.end())
+        return;
+
+    evict(entry->n_bytes);
+    n_bytes += entry->n_bytes;
+    entries.insert({k, std::move(entry)});
+    order.push_back(k);
+}
+
+void SubtreeCache::evict(size_t n_new_bytes)
+{
+    while (!order.empty() && n_bytes + n_new_bytes > max_bytes)
+    {
+        auto it = entries.find(order.front());
+        if (it != entries.end())
+        {
+            n_bytes -= it->second->n_bytes;
+            entries.erase(it);
+        }
+        order.pop_front();
+    }
+}
+
+void SubtreeCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    entries.clear();
+    seen.clear();
+    order.clear();
+    n_bytes = 0;
+    n_lookups = 0;
+    n_hits = 0;
+    bytes_saved = 0;
+}
+
+void SubtreeCache::set_max_bytes(size_t m)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    max_bytes = m;
+    evict(0);
+}
+
+} // Brush
@@ -0,0 +1,163 @@
+/* Brush
+copyright 2020 William La Cava
+license: GNU/GPL v3
+*/
+#ifndef SUBTREE_CACHE_H
+#define SUBTREE_CACHE_H
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_set>
+
+#include "../init.h"
+#include "../data/data.h"
+#include "tree_node.h"
+
+namespace Brush {
+
+/**
+ * @brief Outputs of the subtrees shared by the programs of a generation.
+ *
+ * Crossover and cloning leave many identical subtrees in a population. This
+ * cache keeps their outputs, so that each one is evaluated once per dataset
+ * rather than once per program.
+ *
+ * Entries are keyed by a structural hash of the subtree, which covers the
+ * node types, signatures, features and weights of its nodes, and by the
+ * dataset it was evaluated on. A hit is checked against the nodes stored
+ * with the entry, so hash collisions are misses.
+ *
+ * A subtree is only stored the second time it is looked up, so that
+ * subtrees that occur once do not pay for a copy of their output. Once the
+ * stored outputs exceed `max_bytes`, the oldest entries are evicted.
+ *
+ * The cache is shared by the threads that evaluate a generation, and is
+ * cleared between generations. Evaluation makes it active on the calling
+ * thread with a `Scope`, and compiled programs read from the active cache
+ * when they predict with the weights stored in their nodes.
+ */
+class SubtreeCache
+{
+public:
+    /// @brief the parts of a node its output depends on, besides its children
+    struct NodeKey
+    {
+        NodeType node_type;
+        std::size_t sig_hash;
+        bool is_weighted;
+        /// bits of the weight, or 0 if the node does not use it
+        uint32_t W;
+        /// interned name of the feature, compared by pointer
+        Util::Interned<string> feature;
+
+        explicit NodeKey(const Node& n);
+        bool matches(const Node& n) const;
+    };
+
+    /// @brief the output of a subtree on a dataset
+    struct Entry
+    {
+        /// Dataset::get_id of the dataset
+        uint64_t data_id;
+        vector<NodeKey> nodes; ///< nodes of the subtree, in pre-order
+        Data::State output;
+        size_t n_bytes;
+    };
+
+    /// @brief makes a cache the active cache of the calling thread for its
+    /// lifetime. A null cache disables caching in the scope.
+    class Scope
+    {
+    public:
+        explicit Scope(SubtreeCache* cache);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        SubtreeCache* previous;
+    };
+
+    /// @brief the active cache of the calling thread, or null
+    static SubtreeCache* active();
+
+    /// @brief structural hash of a node, not including its children
+    static std::size_t node_hash(const Node& n);
+    /// @brief combines the hash of a node with the hash of one of its children
+    static std::size_t combine(std::size_t seed, std::size_t child_hash);
+    /// @brief structural hash of the subtree at `tn`
+    static std::size_t subtree_hash(const TreeNode* tn);
+    /// @brief number of nodes of the subtree at `tn`
+    static size_t subtree_size(const TreeNode* tn);
+
+    /// @brief key of the output of a subtree with structural hash `hash` on
+    /// the dataset with id `data_id`
+    static std::size_t key(std::size_t hash, uint64_t data_id);
+    /// @brief an entry holding a copy of `output`, the output of the subtree
+    /// at `tn` on `d`. Null if the output is not an array.
+    static std::shared_ptr<const Entry> make_entry(const TreeNode* tn, 
+        const Dataset& d, const Data::State& output);
+    /// @brief whether `entry` holds the output of the subtree at `tn` on `d`
+    static bool is_entry_of(const Entry& entry, const TreeNode* tn, 
+                            const Dataset& d);
+
+    SubtreeCache(size_t max_bytes = 0) : max_bytes(max_bytes) {};
+
+    /**
+     * @brief looks up the output of the subtree at `tn` on `d`.
+     *
+     * @param hash structural hash of the subtree
+     * @param tn root of the subtree
+     * @param d dataset
+     * @param store set to true on a miss, if the subtree was looked up
+     * before and its output should be stored with `insert`
+     * @return the entry, or null on a miss
+     */
+    std::shared_ptr<const Entry> find(std::size_t hash, const TreeNode* tn,
+                                      const Dataset& d, bool& store);
+
+    /// @brief stores an entry made with `make_entry`, evicting the oldest 
+    /// entries to stay within the memory budget.
+    void insert(std::size_t hash, std::shared_ptr<const Entry> entry);
+
+    /// @brief drops all entries and resets the statistics
+    void clear();
+
+    /// @brief sets the memory budget. Evaluation reads the budget without
+    /// the lock, so it is set before the threads that share the cache start.
+    void set_max_bytes(size_t m);
+    size_t get_max_bytes() const { return max_bytes; };
+
+    /// @brief bytes held by stored outputs
+    size_t get_n_bytes() const { return n_bytes; };
+    size_t get_n_entries() const { return entries.size(); };
+    size_t get_n_lookups() const { return n_lookups; };
+    size_t get_n_hits() const { return n_hits; };
+    /// @brief fraction of lookups that were hits
+    float get_hit_rate() const {
+        return n_lookups > 0 ? float(n_hits)/n_lookups : 0.0f;
+    };
+    /// @brief bytes of node outputs read from the cache rather than computed
+    size_t get_bytes_saved() const { return bytes_saved; };
+
+private:
+    static thread_local SubtreeCache* current;
+
+    static bool matches(const TreeNode* tn, const vector<NodeKey>& nodes,
+                        size_t& i);
+    void evict(size_t n_new_bytes);
+
+    std::mutex mtx;
+    std::unordered_map<std::size_t, std::shared_ptr<const Entry>> entries;
+    std::unordered_set<std::size_t> seen; ///< keys looked up at least once
+    std::deque<std::size_t> order;        ///< keys of entries, oldest first
+
+    size_t max_bytes;
+    size_t n_bytes = 0;
+    size_t n_lookups = 0;
+    std::atomic<size_t> n_hits = 0;       ///< counted outside the lock
+    std::atomic<size_t> bytes_saved = 0;
+};
+
+} // Brush
+#endif
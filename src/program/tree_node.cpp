@@ -49,7 +49,7 @@ string TreeNode::get_tree_model(bool pretty, string offset) const
         }
     }
     else if (Is<NodeType::SplitOn>(data.node_type)){
-        if (data.arg_types.at(0) == DataType::ArrayB)
+        if (data.arg_types->at(0) == DataType::ArrayB)
         {
             // booleans dont use thresholds (they are used directly as mask in split)
             return "If" + child_outputs;
@@ -86,7 +86,7 @@ void from_json(const json &j, tree<Node> &t)
         auto node = j.at(i).get<Node>();
         tree<Node> subtree;
         auto root = subtree.insert(subtree.begin(), node);
-        for (auto at : node.arg_types)
+        for (auto at : node.get_arg_types())
         {
             auto spot = subtree.append_child(root);
             auto arg = stack.back();
@@ -225,23 +225,7 @@ int TreeNode::get_complexity() const
 
 int TreeNode::get_size(bool include_weight) const 
 {
-    int acc = 1; // the node operator or terminal
-
-    // SplitBest has an optimizable decision tree consisting of 3 nodes
-    // (terminal, arithmetic comparison, value) that needs to be taken
-    // into account. Split on will have an random decision tree that can 
-    // have different sizes, but will also have the arithmetic comparison
-    // and a value.
-    if (Is<NodeType::SplitBest>(data.node_type))
-        acc += 3;
-    else if (Is<NodeType::SplitOn>(data.node_type))
-        acc += 2;
-
-    if ( (include_weight && data.get_is_weighted()==true)
-    &&   Isnt<NodeType::Constant, NodeType::MeanLabel>(data.node_type) )
-        // Taking into account the weight and multiplication, if enabled.
-        // weighted constants still count as 1 (simpler than constant terminals)
-        acc += 2;
+    int acc = data.get_size(include_weight);
 
     auto child = first_child;
     for(int i = 0; i < data.get_arg_count(); ++i)
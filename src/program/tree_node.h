@@ -8,6 +8,7 @@
 #include "node.h"
 #include "functions.h"
 #include "nodetype.h"
+#include "dispatch_table.h"
 #include "../../thirdparty/tree.hh"
 
 using std::string;
@@ -37,6 +38,8 @@ class tree_node_<Node> { // size: 5*4=20 bytes (on 32 bit arch), can be reduced
 	    tree_node_<Node> *first_child, *last_child;
 		tree_node_<Node> *prev_sibling, *next_sibling;
 		Node data;
+        /// callables of the node, resolved on first evaluation
+        Brush::NodeOps ops;
 
         template<typename T>
         auto fit(const Dataset& d); 
@@ -60,27 +63,22 @@ using TreeNode = class tree_node_<Node>;
 //////////////////////////////////////////////////////////////////////////////////
 // fit, eval, predict
 
-#include "dispatch_table.h"
-
 template<typename T>
 auto TreeNode::fit(const Dataset& d)
 { 
-    auto F = dtable_fit.template Get<T>(data.node_type, data.sig_hash);
-    return F(d, (*this));
+    return ops.template get_fit<T>(data)(d, (*this));
 };
 
 template<typename T> 
 auto TreeNode::predict(const Dataset& d, const float** weights)
 { 
-    auto F = dtable_predict.template Get<T>(data.node_type, data.sig_hash);
-    return F(d, (*this), weights);
+    return ops.template get_predict<T>(data)(d, (*this), weights);
 };
 
 template<typename T, typename W> 
 auto TreeNode::predict(const Dataset& d, const W** weights)
 { 
-    auto F = dtable_predict.template Get<T>(data.node_type, data.sig_dual_hash);
-    return F(d, (*this), weights);
+    return ops.template get_predict_dual<T>(data)(d, (*this), weights);
 };
 
 // serialization functions
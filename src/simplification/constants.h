@@ -75,6 +75,7 @@ namespace Brush { namespace Simpl{
                     ++spot;
                 }
                 program.Tree = simplified_program.Tree;
+                program.tree_changed();
                 return simplified_program;
             }
 
@@ -39,7 +39,7 @@ void Inexact_simplifier::init(int hashSize, const Dataset &data, int numPlanes)
     }
 
     equivalentExpressions.clear();
-    for (const auto& dtype : data.unique_data_types)
+    for (const auto& dtype : data.get_root().unique_data_types)
         equivalentExpressions[dtype] = HashStorage(numPlanes);
 }
 
@@ -213,6 +213,7 @@ class Inexact_simplifier
                                 simplified_program.Tree.erase_children(spot);
 
                                 spot = simplified_program.Tree.move_ontop(spot, simplified_branch.begin());
+                                simplified_program.tree_changed();
                                 
                                 auto new_predictions = simplified_program.predict(d);
                                 
@@ -226,6 +227,7 @@ class Inexact_simplifier
                                 // rollback
                                 simplified_program.Tree.erase_children(spot);
                                 spot = simplified_program.Tree.move_ontop(spot, original_branch.begin());
+                                simplified_program.tree_changed();
                             }
                             if (best_distance < threshold) {
 
@@ -236,6 +238,7 @@ class Inexact_simplifier
                                 // cout << " with " << best_branch_copy.begin().node->get_model() << endl;
                                 
                                 spot = simplified_program.Tree.move_ontop(spot, best_branch_copy.begin());
+                                simplified_program.tree_changed();
 
                                 // learning the simplifications made here
                                 analyze_tree(simplified_program, ss, d);
@@ -246,6 +249,7 @@ class Inexact_simplifier
                 ++spot;
             }    
             program.Tree = simplified_program.Tree;
+            program.tree_changed();
 
             return simplified_program;
         }
@@ -0,0 +1,130 @@
+/* Brush
+copyright 2020 William La Cava
+license: GNU/GPL v3
+*/
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "../init.h"
+#include "../types.h"
+
+namespace Brush {
+namespace Util {
+
+/// @brief true for the buffers kept by the arena: Eigen arrays with a fixed
+/// number of columns
+template<typename T, typename E=void>
+struct is_arena_buffer : std::false_type {};
+template<typename T>
+struct is_arena_buffer<T, enable_if_t<is_eigen_array_v<T>>>
+    : std::bool_constant<T::ColsAtCompileTime != Eigen::Dynamic> {};
+template<typename T>
+static constexpr bool is_arena_buffer_v = is_arena_buffer<T>::value;
+
+/**
+ * @brief A per-thread pool of the buffers that hold the intermediate outputs
+ * of node evaluations.
+ *
+ * Buffers are Eigen arrays with a fixed number of columns, kept by type and
+ * number of rows. `acquire` reuses a buffer that was released with the same
+ * type and number of rows, and only allocates when there is none. Compiled programs draw the output of each
+ * instruction from the arena and release the outputs of its children once
+ * they are consumed, so evaluating programs on data of a size that was seen
+ * before does not allocate.
+ *
+ * Each worker thread has its own arena, returned by `local()`, so buffers
+ * are never shared between threads. The arena keeps at most `max_bytes` of
+ * released buffers, and frees the rest.
+ */
+class BufferArena
+{
+public:
+    /// @brief the arena of the calling thread
+    static BufferArena& local()
+    {
+        thread_local BufferArena arena;
+        return arena;
+    };
+
+    /// @brief returns a buffer of `n` rows. Its values are not initialized.
+    template<typename T> requires (is_arena_buffer_v<T>)
+    T acquire(Eigen::Index n)
+    {
+        auto& free = pool<T>()[n];
+        if (!free.empty())
+        {
+            T buf = std::move(free.back());
+            free.pop_back();
+            n_bytes -= buffer_bytes(buf);
+            ++n_reused;
+            return buf;
+        }
+        ++n_allocations;
+        return T(n, T::ColsAtCompileTime);
+    };
+
+    /// @brief gives a buffer back to the arena. Buffers of other types, 
+    /// which `acquire` does not return, are left to free themselves.
+    template<typename T> requires (!std::is_lvalue_reference_v<T>)
+    void release(T&& buf)
+    {
+        using B = std::decay_t<T>;
+        if constexpr (is_arena_buffer_v<B>)
+        {
+            if (buf.size() == 0 || n_bytes + buffer_bytes(buf) > max_bytes)
+                return;
+            n_bytes += buffer_bytes(buf);
+            pool<B>()[buf.rows()].push_back(std::move(buf));
+        }
+        else if constexpr (is_std_array_v<B>)
+        {
+            for (auto& b : buf)
+                release(std::move(b));
+        }
+        else if constexpr (is_tuple_v<B>)
+        {
+            std::apply([this](auto&... b){ (release(std::move(b)), ...); }, buf);
+        }
+    };
+
+    /// @brief number of buffers allocated by `acquire`
+    inline size_t get_n_allocations() const { return n_allocations; };
+    /// @brief number of buffers `acquire` returned without allocating
+    inline size_t get_n_reused() const { return n_reused; };
+    /// @brief bytes held by released buffers
+    inline size_t get_n_bytes() const { return n_bytes; };
+
+    inline void set_max_bytes(size_t m) { max_bytes = m; };
+    inline size_t get_max_bytes() const { return max_bytes; };
+
+    inline void reset_counters() { n_allocations = 0; n_reused = 0; };
+
+private:
+    BufferArena() = default;
+    BufferArena(const BufferArena&) = delete;
+    BufferArena& operator=(const BufferArena&) = delete;
+
+    /// released buffers of type T, by number of rows. There is one pool per
+    /// type and thread, just like there is one arena per thread.
+    template<typename T>
+    static std::unordered_map<Eigen::Index, vector<T>>& pool()
+    {
+        thread_local std::unordered_map<Eigen::Index, vector<T>> buffers;
+        return buffers;
+    };
+
+    template<typename T>
+    static size_t buffer_bytes(const T& buf)
+    {
+        return buf.size()*sizeof(typename T::Scalar);
+    };
+
+    size_t n_allocations = 0;
+    size_t n_reused = 0;
+    size_t n_bytes = 0;
+    size_t max_bytes = size_t(1) << 26;
+};
+
+} // Util
+} // Brush
+#endif
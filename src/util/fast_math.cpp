@@ -0,0 +1,320 @@
+#include <bit>
+#include <cmath>
+#include <cfloat>
+
+#include "fast_math.h"
+#include "error.h"
+
+// One clone of each kernel per instruction set, dispatched at load time
+#if defined(__x86_64__) && defined(__linux__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define BRUSH_TARGET_CLONES __attribute__((target_clones("avx512f","avx2","default")))
+#endif
+#endif
+#ifndef BRUSH_TARGET_CLONES
+#define BRUSH_TARGET_CLONES
+#endif
+
+// the helpers are inlined in each clone, so they are compiled for its 
+// instruction set
+#define BRUSH_INLINE inline __attribute__((always_inline))
+
+namespace Brush { namespace Util { namespace FastMath {
+
+Scope::Scope(const string& precision) : previous(fast_precision)
+{
+    if (precision != "exact" && precision != "fast")
+        HANDLE_ERROR_THROW("precision must be \"exact\" or \"fast\", not \""
+                           + precision + "\"\n");
+
+    fast_precision = precision == "fast";
+}
+
+Scope::~Scope()
+{
+    fast_precision = previous;
+}
+
+string get_isa()
+{
+#if defined(__x86_64__) && defined(__linux__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+    if (__builtin_cpu_supports("avx512f"))
+        return "avx512f";
+    if (__builtin_cpu_supports("avx2"))
+        return "avx2";
+#endif
+#endif
+    return "default";
+}
+
+namespace {
+
+// Scalar approximations, after the Cephes single precision library. They are
+// inlined in the loops of the kernels, and only see inputs in their domain.
+
+/// 2^n, for n in [-126, 127]
+BRUSH_INLINE float pow2(int32_t n)
+{
+    return std::bit_cast<float>((n + 127) << 23);
+}
+
+/// round to nearest, without a call to libm
+BRUSH_INLINE int32_t round_int(float x)
+{
+    return int32_t(x + std::copysign(0.5f, x));
+}
+
+/// a if c, else b. A ternary on floats may be compiled to a branch, which
+/// stops the loop from being vectorized.
+BRUSH_INLINE float select(bool c, float a, float b)
+{
+    const int32_t m = -int32_t(c);
+    return std::bit_cast<float>((std::bit_cast<int32_t>(a) & m)
+                              | (std::bit_cast<int32_t>(b) & ~m));
+}
+
+/// exp, for x in [-87.3, 88.3]
+BRUSH_INLINE float exp1(float x)
+{
+    const int32_t n = round_int(x*1.44269504088896341f);
+    const float fn = float(n);
+    float r = x - fn*0.693359375f;
+    r = r - fn*(-2.12194440e-4f);
+
+    float p = 1.9875691500E-4f;
+    p = p*r + 1.3981999507E-3f;
+    p = p*r + 8.3334519073E-3f;
+    p = p*r + 4.1665795894E-2f;
+    p = p*r + 1.6666665459E-1f;
+    p = p*r + 5.0000001201E-1f;
+    return (p*r*r + r + 1.0f)*pow2(n);
+}
+
+/// log, for normal, finite x > 0
+BRUSH_INLINE float log1(float x)
+{
+    const int32_t bits = std::bit_cast<int32_t>(x);
+    int32_t e = ((bits >> 23) & 0xff) - 126;
+    // mantissa in [0.5, 1)
+    float m = std::bit_cast<float>((bits & 0x807fffff) | 0x3f000000);
+    const bool below = m < 0.707106781186547524f;
+    e -= below ? 1 : 0;
+    m = below ? m + m - 1.0f : m - 1.0f;
+
+    const float fe = float(e);
+    const float z = m*m;
+    float y = 7.0376836292E-2f;
+    y = y*m - 1.1514610310E-1f;
+    y = y*m + 1.1676998740E-1f;
+    y = y*m - 1.2420140846E-1f;
+    y = y*m + 1.4249322787E-1f;
+    y = y*m - 1.6668057665E-1f;
+    y = y*m + 2.0000714765E-1f;
+    y = y*m - 2.4999993993E-1f;
+    y = y*m + 3.3333331174E-1f;
+    y = y*m*z;
+    y += fe*(-2.12194440e-4f);
+    y += -0.5f*z;
+    return (m + y) + fe*0.693359375f;
+}
+
+/// sine or cosine, for |x| <= 8192
+template<bool Cos>
+BRUSH_INLINE float sincos1(float x)
+{
+    const float ax = std::fabs(x);
+    // octant of ax, rounded up to an even one
+    int32_t j = int32_t(ax*1.27323954473516f);
+    j = (j + 1) & ~1;
+    const float y = float(j);
+    const float r = ((ax - y*0.78515625f) - y*2.4187564849853515625e-4f)
+                  - y*3.77489497744594108e-8f;
+    const float z = r*r;
+
+    const float c = ((2.443315711809948E-005f*z - 1.388731625493765E-003f)*z
+                    + 4.166664568298827E-002f)*z*z - 0.5f*z + 1.0f;
+    const float s = ((-1.9515295891E-4f*z + 8.3321608736E-3f)*z
+                    - 1.6666654611E-1f)*z*r + r;
+
+    // the octant picks the polynomial and the sign, which is flipped by
+    // xor-ing the sign bit
+    int32_t sign;
+    if constexpr (Cos)
+    {
+        j -= 2;
+        sign = (~j & 4) << 29;
+    }
+    else
+        sign = ((j & 4) << 29) ^ (std::bit_cast<int32_t>(x) & 0x80000000);
+
+    const float v = (j & 2) == 0 ? s : c;
+    return std::bit_cast<float>(std::bit_cast<int32_t>(v) ^ sign);
+}
+
+/// tanh, for finite x
+BRUSH_INLINE float tanh1(float x)
+{
+    const float ax = std::fabs(x);
+    const float z = x*x;
+    const float p = ((((-5.70498872745E-3f*z + 2.06390887954E-2f)*z
+                    - 5.37397155531E-2f)*z + 1.33314422036E-1f)*z
+                    - 3.33332819422E-1f)*z*x + x;
+
+    // tanh rounds to 1 above 9
+    const float t = 1.0f - 2.0f/(exp1(2.0f*std::min(ax, 9.0f)) + 1.0f);
+    return select(ax < 0.625f, p, std::copysign(t, x));
+}
+
+/// sinh, for |x| <= 88.3
+BRUSH_INLINE float sinh1(float x)
+{
+    const float ax = std::fabs(x);
+    const float z = x*x;
+    const float p = ((2.03721912945E-4f*z + 8.33028376239E-3f)*z
+                    + 1.66667160211E-1f)*z*x + x;
+    const float e = exp1(ax);
+    const float s = 0.5f*(e - 1.0f/e);
+    return select(ax < 1.0f, p, std::copysign(s, x));
+}
+
+/// cosh, for |x| <= 88.3
+BRUSH_INLINE float cosh1(float x)
+{
+    const float e = exp1(std::fabs(x));
+    return 0.5f*(e + 1.0f/e);
+}
+
+/**
+ * @brief evaluates `fast` on the elements of `x` for which `ok` holds, and
+ * `exact` on the others. Elements outside the domain are passed to `fast`
+ * as `safe`, and overwritten in a second pass, which only runs if there is
+ * any of them.
+ */
+template<typename Ok, typename Fast, typename Exact>
+BRUSH_INLINE void map(const float* x, float* out, size_t n, float safe,
+                Ok ok, Fast fast, Exact exact)
+{
+    int n_outside = 0;
+    #pragma omp simd reduction(+:n_outside)
+    for (size_t i = 0; i < n; ++i)
+    {
+        const bool in = ok(x[i]);
+        out[i] = fast(in ? x[i] : safe);
+        n_outside += in ? 0 : 1;
+    }
+
+    if (n_outside == 0)
+        return;
+
+    for (size_t i = 0; i < n; ++i)
+        if (!ok(x[i]))
+            out[i] = exact(x[i]);
+}
+
+/// domain of exp1. Comparisons with NaN are false.
+BRUSH_INLINE bool exp_domain(float x) { return (x >= -87.3f) & (x <= 88.3f); }
+
+} // namespace
+
+BRUSH_TARGET_CLONES
+void exp(const float* x, float* out, size_t n)
+{
+    map(x, out, n, 0.0f, exp_domain,
+        [](float v){ return exp1(v); },
+        [](float v){ return std::exp(v); });
+}
+
+BRUSH_TARGET_CLONES
+void log(const float* x, float* out, size_t n)
+{
+    map(x, out, n, 1.0f, [](float v){ return (v >= FLT_MIN) & (v <= FLT_MAX); },
+        [](float v){ return log1(v); },
+        [](float v){ return std::log(v); });
+}
+
+BRUSH_TARGET_CLONES
+void logabs(const float* x, float* out, size_t n)
+{
+    map(x, out, n, 1.0f,
+        [](float v){ return (std::fabs(v) >= FLT_MIN) & (std::fabs(v) <= FLT_MAX); },
+        [](float v){ return log1(std::fabs(v)); },
+        [](float v){ return std::log(std::fabs(v)); });
+}
+
+BRUSH_TARGET_CLONES
+void sin(const float* x, float* out, size_t n)
+{
+    map(x, out, n, 0.0f, [](float v){ return std::fabs(v) <= 8192.0f; },
+        [](float v){ return sincos1<false>(v); },
+        [](float v){ return std::sin(v); });
+}
+
+BRUSH_TARGET_CLONES
+void cos(const float* x, float* out, size_t n)
+{
+    map(x, out, n, 0.0f, [](float v){ return std::fabs(v) <= 8192.0f; },
+        [](float v){ return sincos1<true>(v); },
+        [](float v){ return std::cos(v); });
+}
+
+BRUSH_TARGET_CLONES
+void tanh(const float* x, float* out, size_t n)
+{
+    map(x, out, n, 0.0f, [](float v){ return std::fabs(v) <= FLT_MAX; },
+        [](float v){ return tanh1(v); },
+        [](float v){ return std::tanh(v); });
+}
+
+BRUSH_TARGET_CLONES
+void sinh(const float* x, float* out, size_t n)
+{
+    map(x, out, n, 0.0f, [](float v){ return std::fabs(v) <= 88.3f; },
+        [](float v){ return sinh1(v); },
+        [](float v){ return std::sinh(v); });
+}
+
+BRUSH_TARGET_CLONES
+void cosh(const float* x, float* out, size_t n)
+{
+    map(x, out, n, 0.0f, [](float v){ return std::fabs(v) <= 88.3f; },
+        [](float v){ return cosh1(v); },
+        [](float v){ return std::cosh(v); });
+}
+
+BRUSH_TARGET_CLONES
+void logistic(const float* x, float* out, size_t n)
+{
+    map(x, out, n, 0.0f, [](float v){ return exp_domain(-v); },
+        [](float v){ return 1.0f/(1.0f + exp1(-v)); },
+        [](float v){ return 1.0f/(1.0f + std::exp(-v)); });
+}
+
+BRUSH_TARGET_CLONES
+void pow(const float* x, const float* y, float* out, size_t n)
+{
+    // x^y = exp(y*log(x)) for positive x, as long as the result is a normal
+    // float. Other bases and exponents are left to libm.
+    int n_outside = 0;
+    #pragma omp simd reduction(+:n_outside)
+    for (size_t i = 0; i < n; ++i)
+    {
+        const bool positive = (x[i] >= FLT_MIN) & (x[i] <= FLT_MAX);
+        const float t = y[i]*log1(positive ? x[i] : 1.0f);
+        const bool in = positive & exp_domain(t);
+        out[i] = exp1(in ? t : 0.0f);
+        n_outside += in ? 0 : 1;
+    }
+
+    if (n_outside == 0)
+        return;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const bool positive = (x[i] >= FLT_MIN) & (x[i] <= FLT_MAX);
+        if (!(positive & exp_domain(y[i]*log1(positive ? x[i] : 1.0f))))
+            out[i] = std::pow(x[i], y[i]);
+    }
+}
+
+} } } // Brush::Util::FastMath
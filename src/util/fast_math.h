@@ -0,0 +1,66 @@
+/* Brush
+copyright 2020 William La Cava
+license: GNU/GPL v3
+*/
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+#include "../init.h"
+
+namespace Brush { namespace Util { namespace FastMath {
+
+/**
+ * Vectorized kernels for the transcendental functions of the operators, on
+ * arrays of floats.
+ *
+ * Each kernel evaluates a polynomial approximation of its function, written
+ * as a branch-free loop so that the compiler vectorizes it. The kernels are
+ * compiled once per instruction set (AVX-512, AVX2 and a baseline), and the
+ * best one the CPU supports is picked at load time. Elements outside the
+ * range where the approximation holds, including infinities and NaNs, are
+ * evaluated with libm, so the kernels agree with libm on special values.
+ *
+ * The approximations are accurate to a few ulp, except `pow`, whose
+ * relative error grows with |y*log(x)| up to about 1e-5. Sine and cosine
+ * are accurate to about 1e-7 in absolute terms.
+ *
+ * Operators use the kernels in place of Eigen when the precision is "fast"
+ * (see Parameters::precision). The precision is set per thread by a `Scope`,
+ * which evaluation opens with the precision of its parameters.
+ */
+
+/// true when operators evaluate with the kernels below on the calling thread
+inline thread_local bool fast_precision = false;
+
+inline bool enabled() { return fast_precision; };
+
+/// @brief sets the precision of the operators on the calling thread, for the
+/// lifetime of the scope: "exact" evaluates with Eigen and libm, "fast" with
+/// the kernels below.
+class Scope
+{
+public:
+    explicit Scope(const string& precision);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+private:
+    bool previous;
+};
+
+/// @brief the instruction set the kernels run with on this CPU
+string get_isa();
+
+void exp(const float* x, float* out, size_t n);
+void log(const float* x, float* out, size_t n);
+void logabs(const float* x, float* out, size_t n);
+void sin(const float* x, float* out, size_t n);
+void cos(const float* x, float* out, size_t n);
+void tanh(const float* x, float* out, size_t n);
+void sinh(const float* x, float* out, size_t n);
+void cosh(const float* x, float* out, size_t n);
+void logistic(const float* x, float* out, size_t n);
+void pow(const float* x, const float* y, float* out, size_t n);
+
+} } } // Brush::Util::FastMath
+#endif
@@ -0,0 +1,51 @@
+/* Brush
+copyright 2020 William La Cava
+license: GNU/GPL v3
+*/
+
+#include "interned.h"
+#include <mutex>
+#include <unordered_set>
+
+namespace Brush {
+namespace Util {
+
+namespace {
+
+struct DataTypesHash {
+    std::size_t operator()(const vector<DataType>& v) const {
+        std::size_t seed = v.size();
+        for (auto t : v)
+            seed ^= uint32_t(t) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        return seed;
+    }
+};
+
+// the elements of a node based set keep their address when others are
+// inserted, so handles stay valid. The pools are never freed, so handles held
+// by static objects are valid during their destruction.
+template<typename T, typename Hash=std::hash<T>>
+const T& intern_in(std::unordered_set<T, Hash>& pool, std::mutex& m, const T& v)
+{
+    std::lock_guard<std::mutex> lock(m);
+    return *pool.insert(v).first;
+}
+
+}
+
+const string& intern(const string& s)
+{
+    static std::mutex m;
+    static auto& pool = *new std::unordered_set<string>();
+    return intern_in(pool, m, s);
+}
+
+const vector<DataType>& intern(const vector<DataType>& v)
+{
+    static std::mutex m;
+    static auto& pool = *new std::unordered_set<vector<DataType>, DataTypesHash>();
+    return intern_in(pool, m, v);
+}
+
+} // Util
+} // Brush
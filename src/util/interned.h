@@ -0,0 +1,66 @@
+/* Brush
+copyright 2020 William La Cava
+license: GNU/GPL v3
+*/
+#ifndef INTERNED_H
+#define INTERNED_H
+
+#include "../init.h"
+#include "../types.h"
+
+namespace Brush {
+namespace Util {
+
+/// @brief returns the pooled copy of `s`, adding it to the pool if needed.
+/// The pools live for the whole process, and are shared by all threads.
+const string& intern(const string& s);
+/// @brief returns the pooled copy of `v`, adding it to the pool if needed.
+const vector<DataType>& intern(const vector<DataType>& v);
+
+/**
+ * @brief A handle to an interned value of type T.
+ *
+ * Equal values share one copy in a process-wide pool, and the handle only
+ * holds a pointer to it. Handles are therefore trivially copyable, and
+ * compare in constant time. Creating a handle from a value locks the pool,
+ * so they should be made once (when building the search space or reading a
+ * program) and copied afterwards.
+ */
+template<typename T>
+class Interned
+{
+public:
+    Interned() : value(&empty()) {};
+    Interned(const T& v) : value(&intern(v)) {};
+    Interned(const char* v) requires std::is_same_v<T, string>
+        : value(&intern(string(v))) {};
+
+    inline const T& get() const { return *value; };
+    inline operator const T&() const { return *value; };
+    inline const T* operator->() const { return value; };
+
+    inline bool operator==(const Interned& rhs) const { return value == rhs.value; };
+    inline bool operator==(const T& rhs) const { return *value == rhs; };
+
+private:
+    const T* value;
+
+    static const T& empty()
+    {
+        static const T& e = intern(T());
+        return e;
+    };
+};
+
+} // Util
+} // Brush
+
+// format overload for interned values
+template <typename T> struct fmt::formatter<Brush::Util::Interned<T>>: formatter<T> {
+  template <typename FormatContext>
+  auto format(const Brush::Util::Interned<T>& x, FormatContext& ctx) const {
+    return formatter<T>::format(x.get(), ctx);
+  }
+};
+
+#endif
@@ -233,7 +233,9 @@ void Log_Stats::update(int index,
                        unsigned md_size,
                        unsigned md_complexity,
                        unsigned mx_size,
-                       unsigned mx_complexity
+                       unsigned mx_complexity,
+                       float cch_hit_rate,
+                       size_t cch_bytes_saved
                        )
 {
     generation.push_back(index+1);
@@ -249,6 +251,9 @@ void Log_Stats::update(int index,
 
     max_size.push_back(mx_size);
     max_complexity.push_back(mx_complexity);
+
+    cache_hit_rate.push_back(cch_hit_rate);
+    cache_bytes_saved.push_back(cch_bytes_saved);
 }
 
 /* array<ArrayXf, 2> split(ArrayXf& v, ArrayXb& mask) */
@@ -201,6 +201,9 @@ bool in(const V& v, const T& i)
 template<typename T, typename Scalar=T::Scalar>
 Scalar median(const T& v) 
 {
+    // empty samples, e.g. of time series, have no median
+    if (v.size() == 0)
+        return std::numeric_limits<Scalar>::quiet_NaN();
     // instantiate a vector
     vector<Scalar> x(v.size());
     x.assign(v.data(),v.data()+v.size());
@@ -409,6 +412,9 @@ struct Log_Stats
     vector<unsigned> max_size;
     vector<unsigned> max_complexity;
 
+    vector<float> cache_hit_rate;     ///< hit rate of the subtree cache
+    vector<size_t> cache_bytes_saved; ///< bytes of node outputs read from the subtree cache
+
         // Keep stats vectors non-empty so .back() calls are always safe for logging/printing.
         Log_Stats()
                 : generation{0},
@@ -420,7 +426,9 @@ struct Log_Stats
                     med_size{0},
                     med_complexity{0},
                     max_size{0},
-                    max_complexity{0}
+                    max_complexity{0},
+                    cache_hit_rate{0.0f},
+                    cache_bytes_saved{0}
         {}
 
     void update(int index,
@@ -434,7 +442,10 @@ struct Log_Stats
                 unsigned md_size,
                 unsigned md_complexity,
                 unsigned mx_size,
-                unsigned mx_complexity
+                unsigned mx_complexity,
+
+                float cch_hit_rate=0.0f,
+                size_t cch_bytes_saved=0
                 );
 };
 
@@ -452,7 +463,10 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Log_Stats,
     med_size,
     med_complexity,
     max_size,
-    max_complexity
+    max_complexity,
+
+    cache_hit_rate,
+    cache_bytes_saved
 );
 
 /// limits the output to finite real numbers
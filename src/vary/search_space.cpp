@@ -52,8 +52,15 @@ vector<Node> generate_terminals(const Dataset& d, const bool weights_init)
 {
     vector<Node> terminals;
     int i = 0;
-    for ( const auto &[feature_name, value]: d.features ) 
+
+    // visit the columns in name order, so the terminal set does not depend on
+    // how the columns happen to be laid out
+    vector<string> names(d.feature_names);
+    std::sort(names.begin(), names.end());
+    for ( const auto& feature_name: names ) 
     {
+        const int feature_id = d.get_feature_id(feature_name);
+        const auto& value = d.columns.at(feature_id);
         std::visit(
             [&](auto&& arg) {
                 using T = std::decay_t<decltype(arg)>;
@@ -64,7 +71,8 @@ vector<Node> generate_terminals(const Dataset& d, const bool weights_init)
                     NodeType::Terminal, 
                     Signature<T()>{}, 
                     weighted,
-                    feature_name
+                    feature_name,
+                    feature_id
                 );
 
                 float prob_change = 1.0; // default value
@@ -339,7 +347,7 @@ tree<Node>& SearchSpace::PTC2(tree<Node>& Tree,
         s += 2;
         
     //For each argument position a of n, Enqueue(a; g) 
-    for (auto a : root.arg_types)
+    for (auto a : root.get_arg_types())
     { 
         auto child_spot = Tree.append_child(spot);
         queue.push_back(make_tuple(child_spot, a, d));
@@ -423,7 +431,7 @@ tree<Node>& SearchSpace::PTC2(tree<Node>& Tree,
             auto newspot = Tree.replace(qspot, n);
 
             // For each arg of n, add to queue
-            for (auto a : n.arg_types)
+            for (auto a : n.get_arg_types())
             {
                 auto child_spot = Tree.append_child(newspot);
 
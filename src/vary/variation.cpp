@@ -183,7 +183,7 @@ public:
         
         // now fill the arguments of n appropriately
         bool spot_filled = false;
-        for (auto a: (*n).arg_types)
+        for (auto a: (*n).get_arg_types())
         {
             if (spot_filled)
             {
@@ -581,6 +581,10 @@ std::optional<Individual<T>> Variation<T>::cross(
             // fmt::print("other_spot : {}\n",other_spot.node->data);
             // swap subtrees at child_spot and other_spot
             child.Tree.move_ontop(child_spot, other_spot);
+            child.tree_changed();
+
+            // the subtree taken from the other parent has outputs there
+            child.outputs = NodeOutputs::merge(child.outputs, other.outputs);
             
             Individual<T> ind(child);
             ind.set_variation(mutation_type_to_string(MutationType::Crossover));
@@ -735,6 +739,7 @@ std::optional<Individual<T>> Variation<T>::mutate(
                 success = false;
                 break;
         }
+        child.tree_changed();
 
         if (// strict mutation --- returns only valid solutions.
             ( success
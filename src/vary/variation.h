@@ -136,7 +136,7 @@ public:
                     if (weight > 0.0)
                     {
                         // Attempt to emplace; if the key exists, do nothing
-                        auto [it, inserted] = node_probs.try_emplace(node.name, weight);
+                        auto [it, inserted] = node_probs.try_emplace(node.name.get(), weight);
 
                         // If the key already existed, update its value
                         if (!inserted) {
@@ -227,6 +227,10 @@ public:
         // TODO: rewrite this entire function to avoid repetition (this is a frankenstein)
         auto indices = pop.get_island_indexes(island);
 
+        // offspring are fitted, simplified and scored with the precision of
+        // the run
+        Util::FastMath::Scope precision(parameters.precision);
+
         vector<std::shared_ptr<Individual<T>>> aux_individuals;
         for (unsigned i = 0; i < indices.size(); ++i)
         {
@@ -343,7 +347,13 @@ public:
             assert(ind.program.size() > 0);
             assert(ind.fitness.valid() == false);
 
-            ind.program.fit(data.get_training_data());
+            {
+                // the child starts from the outputs retained by its parents,
+                // so only the changed subtree and its ancestors are fitted
+                DatasetView train = data.get_training_data();
+                NodeOutputs::Scope retain(parameters.use_retained_outputs());
+                ind.program.fit(train, parameters.eval_tile_size);
+            }
 
             // simplify before calculating fitness (order matters, as they are not refitted and constants simplifier does not replace with the right value.)
             // simplify constants first to avoid letting the lsh simplifier to visit redundant branches
@@ -451,7 +461,7 @@ public:
                         else {
                             auto ret_type = node.get_ret_type();
                             auto args_type = node.args_type();
-                            auto name = node.name;
+                            auto name = node.name.get();
 
                             this->op_bandits[ret_type][args_type].update(name, r);
                         }
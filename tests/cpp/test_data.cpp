@@ -1,4 +1,8 @@
 #include "testsHeader.h"
+#include <filesystem>
+#include "../../src/data/io.h"
+#include "../../src/data/omop.h"
+#include "../../src/data/batch.h"
 // #include "../../src/bandit/bandit.cpp"
 
 TEST(Data, ErrorHandling)
@@ -202,3 +206,742 @@ TEST(Data, ShuffleTrueFalse)
     ASSERT_EQ(dt6.get_training_data().get_n_samples(), total);
     ASSERT_EQ(dt6.get_validation_data().get_n_samples(), total);
 }
+
+TEST(Data, DatasetViews)
+{
+    MatrixXf X(10,2);
+    X.col(0) << 0.25, 1.25, 2.25, 3.25, 4.25, 5.25, 6.25, 7.25, 8.25, 9.25;
+    X.col(1) << 0.5, 1.5, 2.5, 3.5, 4.5, 5.5, 6.5, 7.5, 8.5, 9.5;
+    ArrayXf y = X.col(1).array();
+
+    // no validation: both partitions are the parent dataset itself
+    Dataset dt(X, y);
+    ASSERT_TRUE(dt.get_training_data().is_identity());
+    ASSERT_EQ(&dt.get_training_data().get(), &dt);
+    ASSERT_EQ(&dt.get_validation_data().get(), &dt);
+
+    // consecutive indices are stored as a range
+    DatasetView v = dt.view({2, 3, 4, 5});
+    ASSERT_TRUE(v.is_contiguous());
+    ASSERT_EQ(v.get_start(), 2);
+    ASSERT_TRUE(v.get_y().isApprox(y.segment(2, 4)));
+
+    // and resolve to a window, which reads the columns of the parent in place
+    const Dataset& c = v.get();
+    ASSERT_TRUE(c.is_window());
+    ASSERT_EQ(&c.get_root(), &dt);
+    auto data_of = [](const auto& x) -> const float* {
+        if constexpr (requires { x.data(); })
+            return x.data();
+        else
+            return nullptr;
+    };
+    ASSERT_EQ(c.visit_column<ArrayXf>(0, data_of), std::get<ArrayXf>(dt["x_0"]).data() + 2);
+    ASSERT_TRUE(c.y.isApprox(y.segment(2, 4)));
+    ASSERT_THROW(c["x_0"], std::runtime_error);
+
+    // views of views index into the parent
+    DatasetView w = v.view({0, 3});
+    ASSERT_FALSE(w.is_contiguous());
+    ASSERT_EQ(w.get_indices(), vector<size_t>({2, 5}));
+
+    const Dataset& m = w.get();
+    ASSERT_EQ(m.get_n_samples(), 2);
+    ASSERT_EQ(&m.get_root(), &dt);
+    ArrayXf x_1 = m.visit_column<ArrayXf>(1, [](const auto& x){ return ArrayXf(x); });
+    ASSERT_TRUE(x_1.isApprox(y(vector<size_t>{2, 5})));
+
+    // a view is resolved only once
+    ASSERT_EQ(&w.get(), &m);
+
+    // windows of the same rows share their id, splits read their rows in place
+    ASSERT_EQ(dt.window(2, 4).get_id(), c.get_id());
+    ASSERT_NE(dt.window(2, 3).get_id(), c.get_id());
+    ArrayXb mask(4);
+    mask << true, false, false, true;
+    size_t before_split = Dataset::n_bytes_copied;
+    auto halves = c.split(mask);
+    ASSERT_EQ(&halves[0].get_root(), &dt);
+    ASSERT_TRUE(halves[0].y.isApprox(y(vector<size_t>{2, 5})));
+    ASSERT_TRUE(halves[1].y.isApprox(y(vector<size_t>{3, 4})));
+    ASSERT_EQ(Dataset::n_bytes_copied - before_split, 4*sizeof(float));
+
+    // validation partitions are shared between calls
+    Dataset dv(X, y, {}, {}, {}, false, 0.3, 1.0, true);
+    ASSERT_EQ(&dv.get_training_data().get(), &dv.get_training_data().get());
+    ASSERT_EQ(dv.get_training_data().get_n_samples() 
+              + dv.get_validation_data().get_n_samples(), 10);
+
+    // once released, the windows of the partitions are built again, and
+    // views made before keep theirs
+    DatasetView train = dv.get_training_data();
+    const Dataset& before = train.get();
+    size_t start = Dataset::n_bytes_copied;
+    dv.release_partitions();
+    ASSERT_EQ(Dataset::n_bytes_copied, start);
+    ASSERT_EQ(&train.get(), &before);
+    ASSERT_NE(&dv.get_training_data().get(), &before);
+    ASSERT_TRUE(dv.get_training_data().get().y.isApprox(before.y));
+    ASSERT_EQ(Dataset::n_bytes_copied - start, before.y.size()*sizeof(float));
+}
+
+TEST(Data, DatasetViewsBytesCopied)
+{
+    // bytes copied by one generation of fitness evaluation: each individual
+    // requests the training and validation partitions once.
+    const int n_samples = bench_size(20000, 2000);
+    const int n_features = 10;
+    const int pop_size = 100;
+
+    MatrixXf X = MatrixXf::Random(n_samples, n_features);
+    ArrayXf y = X.rowwise().sum().array();
+
+    Dataset data(X, y, {}, {}, {}, false, 0.25, 1.0, true);
+
+    Util::Timer timer;
+
+    // copying accessors (previous behavior)
+    size_t start = Dataset::n_bytes_copied;
+    timer.Reset();
+    for (int i = 0; i < pop_size; ++i)
+    {
+        Dataset train = data.get_training_data().materialize();
+        Dataset validation = data.get_validation_data().materialize();
+        ASSERT_EQ(train.get_n_samples() + validation.get_n_samples(), n_samples);
+    }
+    size_t bytes_copying = Dataset::n_bytes_copied - start;
+    auto time_copying = timer.Elapsed().count();
+
+    // views
+    start = Dataset::n_bytes_copied;
+    timer.Reset();
+    for (int i = 0; i < pop_size; ++i)
+    {
+        const Dataset& train = data.get_training_data();
+        const Dataset& validation = data.get_validation_data();
+        ASSERT_EQ(train.get_n_samples() + validation.get_n_samples(), n_samples);
+    }
+    size_t bytes_views = Dataset::n_bytes_copied - start;
+    auto time_views = timer.Elapsed().count();
+
+    if (run_benchmarks())
+        fmt::print("bytes copied per generation ({} individuals, {} bytes of data):\n"
+                   "  copies: {} bytes in {:.4f}s\n"
+                   "  views:  {} bytes in {:.4f}s\n",
+                   pop_size, data.get_n_bytes(),
+                   bytes_copying, time_copying, bytes_views, time_views);
+
+    // views copy the target of each partition once, and no feature
+    ASSERT_EQ(bytes_copying, pop_size*data.get_n_bytes());
+    ASSERT_EQ(bytes_views, data.y.size()*sizeof(float));
+}
+
+TEST(Data, ContiguousSplit)
+{
+    const int n_samples = 50;
+    MatrixXf X(n_samples, 2);
+    X.col(0) = VectorXf::LinSpaced(n_samples, 0.5, n_samples-0.5);
+    X.col(1) = VectorXf::Random(n_samples);
+    ArrayXf y = 2*X.col(0).array();
+
+    for (bool classification : {false, true})
+    {
+        ArrayXf target = classification ? ArrayXf((y > float(n_samples)).cast<float>()) : y;
+
+        Dataset dt(X, target, {}, {}, {}, classification, 0.3, 1.0, true, true);
+
+        DatasetView train = dt.get_training_data();
+        DatasetView validation = dt.get_validation_data();
+
+        // partitions are adjacent blocks of a copy of the rows
+        ASSERT_TRUE(train.is_contiguous());
+        ASSERT_TRUE(validation.is_contiguous());
+        ASSERT_EQ(train.get_start(), 0);
+        ASSERT_EQ(validation.get_start(), train.get_n_samples());
+        ASSERT_EQ(train.get_n_samples() + validation.get_n_samples(), n_samples);
+        const Dataset& layout = train.get_parent();
+        ASSERT_EQ(&validation.get_parent(), &layout);
+        ASSERT_NE(&layout, &dt);
+
+        // rows were copied together with the target
+        auto x_0 = train.segment<ArrayXf>("x_0");
+        ASSERT_TRUE(x_0.data() == std::get<ArrayXf>(layout["x_0"]).data());
+        if (!classification)
+            ASSERT_TRUE(train.y_segment().isApprox(2*x_0));
+
+        // every row is kept exactly once
+        ArrayXf all_x = std::get<ArrayXf>(layout["x_0"]);
+        std::sort(all_x.begin(), all_x.end());
+        ASSERT_TRUE(all_x.isApprox(X.col(0).array()));
+
+        // the dataset keeps the original row order
+        ASSERT_TRUE(std::get<ArrayXf>(dt["x_0"]).isApprox(X.col(0).array()));
+        ASSERT_TRUE(dt.y.isApprox(target));
+
+        // contiguous views materialize to the same rows as index views
+        Dataset m = train.materialize();
+        Dataset g = layout(train.get_indices());
+        ASSERT_TRUE(std::get<ArrayXf>(m["x_1"]).isApprox(std::get<ArrayXf>(g["x_1"])));
+        ASSERT_TRUE(m.y.isApprox(g.y));
+    }
+}
+
+TEST(Data, FeatureIds)
+{
+    MatrixXf X(6,2);
+    X << 0.0, 1.5,
+         0.5, 2.5,
+         1.0, 3.5,
+         1.5, 4.5,
+         2.0, 5.5,
+         2.5, 6.5;
+    ArrayXf y = X.col(0).array() + X.col(1).array();
+
+    Dataset d(X, y, {"b", "a"});
+
+    // columns are stored in the order of the feature names
+    for (size_t i = 0; i < d.feature_names.size(); ++i)
+    {
+        ASSERT_EQ(d.get_feature_id(d.feature_names.at(i)), i);
+        ASSERT_EQ(&d[d.feature_names.at(i)], &d.columns.at(i));
+    }
+    ASSERT_THROW(d.get_feature_id("c"), std::runtime_error);
+
+    // ids are checked against interned names, and looked up when stale
+    Util::Interned<string> a("a");
+    ASSERT_EQ(d.get_column_id(d.get_feature_id("a"), a), d.get_feature_id("a"));
+    ASSERT_EQ(d.get_column_id(d.get_feature_id("b"), a), d.get_feature_id("a"));
+    ASSERT_EQ(d.get_column_id(-1, a), d.get_feature_id("a"));
+
+    // terminals carry the id of their column
+    SearchSpace ss(d);
+    for (const auto& n : ss.terminal_map.at(DataType::ArrayF))
+    {
+        if (n.get_feature() == "a" || n.get_feature() == "b")
+            ASSERT_EQ(n.get_feature_id(), d.get_feature_id(n.get_feature()));
+    }
+
+    tree<Node> leaf;
+    leaf.set_head(Node(NodeType::Terminal, Signature<ArrayXf()>{}, false,
+                       "a", d.get_feature_id("a")));
+    ASSERT_TRUE(leaf.begin().node->predict<ArrayXf>(d).isApprox(X.col(1).array()));
+
+    // a dataset with a different column layout is still evaluated by name
+    MatrixXf X_swapped(6,2);
+    X_swapped << X.col(1), X.col(0);
+    Dataset d_swapped(X_swapped, y, {"a", "b"});
+    ASSERT_NE(d_swapped.get_feature_id("a"), d.get_feature_id("a"));
+    ASSERT_TRUE(leaf.begin().node->predict<ArrayXf>(d_swapped).isApprox(X.col(1).array()));
+}
+
+TEST(Data, ReadCsv)
+{
+    const string path = (std::filesystem::temp_directory_path()
+                         / "brush_test_read_csv.csv").string();
+    {
+        std::ofstream out(path);
+        out << "a, target ,b,c\r\n"
+            << "1.5, 0, 1, 3\r\n"
+            << "\n"
+            << "-2e-1, 1, 0, +2\r\n"
+            << "3, 1, 1, 4";
+    }
+    Dataset d = Data::read_csv(path, "target");
+
+    ASSERT_EQ(d.get_n_samples(), 3);
+    ASSERT_EQ(d.feature_names, vector<string>({"a", "b", "c"}));
+    ASSERT_TRUE(d.classification);
+    ASSERT_TRUE(d.y.isApprox(Eigen::Array3f(0, 1, 1)));
+    ASSERT_TRUE(d.get<ArrayXf>("a").isApprox(Eigen::Array3f(1.5, -0.2, 3)));
+    ASSERT_TRUE((d.get<ArrayXb>("b") == Eigen::Array<bool,3,1>(true, false, true)).all());
+    ASSERT_TRUE((d.get<ArrayXi>("c") == Eigen::Array3i(3, 2, 4)).all());
+
+    {
+        std::ofstream out(path);
+        out << "a,target\n1,0\nx,1\n";
+    }
+    ASSERT_THROW(Data::read_csv(path, "target"), std::runtime_error);
+    ASSERT_THROW(Data::read_csv(path, "label"), std::runtime_error);
+
+    std::filesystem::remove(path);
+}
+
+TEST(Data, ReadCsvThroughput)
+{
+    const int n_samples = bench_size(100000, 1000);
+    const int n_features = 10;
+    const string path = (std::filesystem::temp_directory_path()
+                         / "brush_test_read_csv_throughput.csv").string();
+
+    MatrixXf X = MatrixXf::Random(n_samples, n_features);
+    {
+        std::ofstream out(path);
+        for (int j = 0; j < n_features; ++j)
+            out << "x_" << j << ",";
+        out << "target\n";
+        for (int i = 0; i < n_samples; ++i)
+        {
+            for (int j = 0; j < n_features; ++j)
+                out << fmt::format("{:.6f},", X(i,j));
+            out << fmt::format("{:.6f}\n", X.row(i).sum());
+        }
+    }
+    const float mb = std::filesystem::file_size(path) / (1024.0*1024.0);
+
+    Util::Timer timer;
+    timer.Reset();
+    Dataset d = Data::read_csv(path, "target");
+    float t_read = timer.Elapsed().count();
+
+    if (run_benchmarks())
+        fmt::print("read_csv: {:.1f} MB in {:.4f}s ({:.1f} MB/s, {} threads)\n",
+                   mb, t_read, mb/t_read, omp_get_max_threads());
+
+    // the same data in the binary format
+    const string bin_path = path + ".bin";
+    d.save_binary(bin_path);
+    timer.Reset();
+    Dataset loaded = Dataset::load_binary(bin_path);
+    float t_load = timer.Elapsed().count();
+
+    if (run_benchmarks())
+        fmt::print("load_binary: {:.1f} MB in {:.4f}s ({:.1f}x faster than read_csv)\n",
+                   std::filesystem::file_size(bin_path) / (1024.0*1024.0), t_load,
+                   t_read/t_load);
+    ASSERT_TRUE(loaded.get<ArrayXf>("x_0").isApprox(d.get<ArrayXf>("x_0")));
+    std::filesystem::remove(bin_path);
+
+    ASSERT_EQ(d.get_n_samples(), n_samples);
+    ASSERT_EQ(d.get_n_features(), n_features);
+    for (int j = 0; j < n_features; ++j)
+        ASSERT_TRUE(d.get<ArrayXf>(fmt::format("x_{}", j)).isApprox(
+                    X.col(j).array(), 1e-4));
+
+    std::filesystem::remove(path);
+}
+
+TEST(Data, BinaryRoundTrip)
+{
+    const int n_samples = 12;
+    MatrixXf X(n_samples, 2);
+    X.col(0) = VectorXf::LinSpaced(n_samples, -1.0, 1.0);
+    for (int i = 0; i < n_samples; ++i)
+        X(i, 1) = i % 2;
+    ArrayXf y = 2*X.col(0).array();
+
+    // a time series feature with samples of varying length
+    TimeSeriesf::TimeType time;
+    TimeSeriesf::ValType value;
+    for (int i = 0; i < n_samples; ++i)
+    {
+        time.push_back(ArrayXi::LinSpaced(i % 4, 0, 10*i));
+        value.push_back(ArrayXf::Constant(i % 4, float(i)));
+    }
+    map<string, State> Z = {{"ts", TimeSeriesf(time, value)}};
+
+    Dataset d(X, y, {"z", "a"}, Z, {}, false, 0.25, 1.0, true);
+
+    const string path = (std::filesystem::temp_directory_path()
+                         / "brush_test_binary_round_trip.bin").string();
+    d.save_binary(path);
+    Dataset loaded = Dataset::load_binary(path);
+
+    // feature ids, types and partitions are kept
+    ASSERT_EQ(loaded.feature_names, d.feature_names);
+    ASSERT_EQ(loaded.feature_types, d.feature_types);
+    ASSERT_EQ(loaded.classification, d.classification);
+    ASSERT_EQ(loaded.get_training_data().get_indices(),
+              d.get_training_data().get_indices());
+    ASSERT_EQ(loaded.get_validation_data().get_indices(),
+              d.get_validation_data().get_indices());
+    ASSERT_TRUE(loaded.y.isApprox(d.y));
+
+    ASSERT_TRUE(loaded.get<ArrayXf>("z").isApprox(d.get<ArrayXf>("z")));
+    ASSERT_TRUE((loaded.get<ArrayXb>("a") == d.get<ArrayXb>("a")).all());
+
+    const auto& ts = loaded.get<TimeSeriesf>("ts");
+    ASSERT_EQ(ts.size(), n_samples);
+    for (int i = 0; i < n_samples; ++i)
+    {
+        ASSERT_TRUE((ts.time(i) == time.at(i)).all());
+        ASSERT_TRUE((ts.value(i) == value.at(i)).all());
+    }
+
+    // columns can be read in place, and row blocks loaded on their own
+    DatasetFile file(path);
+    ASSERT_EQ(file.get_n_samples(), n_samples);
+    ASSERT_TRUE(file.column<ArrayXf>("z").isApprox(d.get<ArrayXf>("z")));
+    ASSERT_THROW(file.column<ArrayXi>("z"), std::runtime_error);
+
+    Dataset block = file.rows(4, 5);
+    ASSERT_EQ(block.get_n_samples(), 5);
+    ASSERT_TRUE(block.get<ArrayXf>("z").isApprox(d.get<ArrayXf>("z").segment(4, 5)));
+    ASSERT_EQ(block.get<TimeSeriesf>("ts").length(0), 0);
+    ASSERT_EQ(block.get<TimeSeriesf>("ts").length(1), 1);
+    ASSERT_THROW(file.rows(10, 5), std::runtime_error);
+
+    // files of another version or byte order are rejected
+    auto load_edited = [&](auto edit) {
+        std::ifstream in(path, std::ios::binary);
+        string bytes((std::istreambuf_iterator<char>(in)), {});
+        edit(bytes);
+        const string edited_path = path + ".edited";
+        std::ofstream(edited_path, std::ios::binary) << bytes;
+        Dataset::load_binary(edited_path);
+    };
+    ASSERT_THROW(load_edited([](string& bytes) { 
+        bytes.replace(bytes.find("\"version\":1"), 11, "\"version\":2"); 
+    }), std::runtime_error);
+    ASSERT_THROW(load_edited([](string& bytes) { 
+        bytes.at(bytes.find("\"byte_order\":\"") + 14) = 'X';
+    }), std::runtime_error);
+    ASSERT_THROW(load_edited([](string& bytes) { 
+        std::reverse(bytes.begin() + 8, bytes.begin() + 16);
+    }), std::runtime_error);
+    std::filesystem::remove(path + ".edited");
+
+    std::filesystem::remove(path);
+    ASSERT_THROW(Dataset::load_binary(path), std::runtime_error);
+}
+
+TEST(Data, BinaryRoundTripWithoutTarget)
+{
+    const int n_samples = 8;
+    MatrixXf X(n_samples, 2);
+    X.col(0) = VectorXf::LinSpaced(n_samples, -1.0, 1.0);
+    X.col(1) = VectorXf::LinSpaced(n_samples, 0.0, 7.5);
+
+    Dataset d(X, vector<string>{"a", "b"});
+    ASSERT_EQ(d.y.size(), 0);
+
+    const string path = (std::filesystem::temp_directory_path()
+                         / "brush_test_binary_no_target.bin").string();
+    d.save_binary(path);
+
+    Dataset loaded = Dataset::load_binary(path);
+    ASSERT_EQ(loaded.get_n_samples(), n_samples);
+    ASSERT_EQ(loaded.y.size(), 0);
+    ASSERT_TRUE(loaded.get<ArrayXf>("a").isApprox(d.get<ArrayXf>("a")));
+    ASSERT_TRUE(loaded.get<ArrayXf>("b").isApprox(d.get<ArrayXf>("b")));
+
+    DatasetFile file(path);
+    ASSERT_EQ(file.get_y().size(), 0);
+    Dataset block = file.rows(2, 3);
+    ASSERT_EQ(block.get_n_samples(), 3);
+    ASSERT_EQ(block.y.size(), 0);
+
+    std::filesystem::remove(path);
+}
+
+TEST(Data, TypeSniffing)
+{
+    ArrayXf binary(6), categorical(6), continuous(6);
+    binary << 0, 1, 1, 0, 1, 0;
+    categorical << 0, 1, 2, -3, 4, 2;
+    continuous << 0, 1, 2, 3, 4.5, 5;
+
+    ASSERT_TRUE(std::holds_alternative<ArrayXb>(check_type(binary, "")));
+    ASSERT_TRUE(std::holds_alternative<ArrayXi>(check_type(categorical, "")));
+    ASSERT_TRUE(std::holds_alternative<ArrayXf>(check_type(continuous, "")));
+
+    // integers with more than 10 distinct values are continuous
+    ArrayXf many_ints = ArrayXf::LinSpaced(11, 0, 10);
+    ASSERT_TRUE(std::holds_alternative<ArrayXf>(check_type(many_ints, "")));
+    ASSERT_TRUE(std::holds_alternative<ArrayXi>(check_type(many_ints.head(10), "")));
+
+    // sampled sniffing only inspects evenly spaced rows: here every other row
+    ArrayXf mostly_binary = ArrayXf::Zero(100);
+    mostly_binary(1) = 2.5;
+    ASSERT_TRUE(std::holds_alternative<ArrayXf>(check_type(mostly_binary, "")));
+    ASSERT_TRUE(std::holds_alternative<ArrayXb>(check_type(mostly_binary, "", 50)));
+    ASSERT_TRUE(std::holds_alternative<ArrayXf>(check_type(mostly_binary, "", 100)));
+
+    // unknown types are reported before any column is converted
+    MatrixXf X = MatrixXf::Zero(4, 2);
+    ASSERT_THROW(Dataset(X, vector<string>{"a", "b"}, vector<string>{"ArrayF", "Foo"}),
+                 std::runtime_error);
+}
+
+TEST(Data, WideDatasetConstruction)
+{
+    // construction time for a wide table of continuous, binary and
+    // categorical features
+    const int n_samples = 200;
+    const int n_features = bench_size(10000, 300);
+
+    MatrixXf X = MatrixXf::Random(n_samples, n_features);
+    for (int j = 0; j < n_features; j += 3)
+        X.col(j) = (X.col(j).array() > 0).cast<float>().matrix();
+    for (int j = 1; j < n_features; j += 3)
+        X.col(j) = (4*X.col(j).array()).round().matrix();
+    ArrayXf y = X.col(2).array();
+
+    Util::Timer timer;
+    timer.Reset();
+    Dataset d(X, y);
+    float t_full = timer.Elapsed().count();
+
+    timer.Reset();
+    Dataset d_sampled(X, y, {}, {}, {}, false, 0.0, 1.0, false, false, 50);
+    float t_sampled = timer.Elapsed().count();
+
+    if (run_benchmarks())
+        fmt::print("{} x {} dataset constructed in {:.4f}s ({:.4f}s with sampled "
+                   "type sniffing, {} threads)\n", n_samples, n_features, t_full,
+                   t_sampled, omp_get_max_threads());
+
+    ASSERT_EQ(d.get_n_features(), n_features);
+    ASSERT_EQ(d.get_feature_type("x_0"), DataType::ArrayB);
+    ASSERT_EQ(d.get_feature_type("x_1"), DataType::ArrayI);
+    ASSERT_EQ(d.get_feature_type("x_2"), DataType::ArrayF);
+    ASSERT_EQ(d_sampled.feature_types, d.feature_types);
+}
+
+TEST(Data, TimeSeriesLayout)
+{
+    // samples of varying length, including an empty one
+    const int n_samples = 6;
+    TimeSeriesf::TimeType time;
+    TimeSeriesf::ValType value;
+    for (int i = 0; i < n_samples; ++i)
+    {
+        time.push_back(ArrayXi::LinSpaced(i, 0, 2*i));
+        value.push_back(ArrayXf::LinSpaced(i, -1.0, float(i)));
+    }
+    TimeSeriesf ts(time, value);
+    ASSERT_EQ(ts.size(), n_samples);
+    ASSERT_EQ(ts.n_values(), 15);
+
+    // transforms share times and offsets with their input
+    TimeSeriesf logged = ts.abs().log1p();
+    ASSERT_EQ(logged.times, ts.times);
+    ASSERT_EQ(logged.offsets, ts.offsets);
+    for (int i = 0; i < n_samples; ++i)
+        ASSERT_TRUE(logged.value(i).isApprox(value.at(i).abs().log1p()));
+
+    // segmented reductions match reductions of each sample
+    ArrayXf sums = ts.sum();
+    ArrayXf counts = ts.count();
+    ArrayXf medians = ts.median();
+    for (int i = 0; i < n_samples; ++i)
+    {
+        ASSERT_FLOAT_EQ(sums(i), value.at(i).sum());
+        ASSERT_EQ(counts(i), value.at(i).size());
+        if (i > 0)
+            ASSERT_FLOAT_EQ(medians(i), Util::median(value.at(i)));
+    }
+    ASSERT_TRUE(std::isnan(medians(0)));
+
+    // slicing by index and by contiguous range
+    TimeSeriesf picked = ts(vector<size_t>{4, 0, 2}, Eigen::all);
+    ASSERT_EQ(picked.size(), 3);
+    ASSERT_TRUE((picked.time(0) == time.at(4)).all());
+    ASSERT_EQ(picked.length(1), 0);
+    ASSERT_TRUE((picked.value(2) == value.at(2)).all());
+
+    TimeSeriesf block = ts.middleRows(3, 2);
+    ASSERT_EQ(block.size(), 2);
+    ASSERT_TRUE((block.value(0) == value.at(3)).all());
+    ASSERT_TRUE((block.time(1) == time.at(4)).all());
+
+    ASSERT_THROW(TimeSeriesf(time, TimeSeriesf::ValType(2)), std::runtime_error);
+}
+
+TEST(Data, TimeSeriesThroughput)
+{
+    // a chain of transforms followed by a reduction over many short samples
+    const int n_samples = bench_size(100000, 1000);
+    TimeSeriesf::TimeType time;
+    TimeSeriesf::ValType value;
+    for (int i = 0; i < n_samples; ++i)
+    {
+        time.push_back(ArrayXi::LinSpaced(1 + i % 20, 0, 100));
+        value.push_back(ArrayXf::Random(1 + i % 20));
+    }
+    TimeSeriesf ts(time, value);
+
+    Util::Timer timer;
+    timer.Reset();
+    ArrayXf out = ts.abs().sqrt().exp().mean();
+    float t_eval = timer.Elapsed().count();
+
+    if (run_benchmarks())
+        fmt::print("{} values in {} samples: transform chain and mean in {:.4f}s\n",
+                   ts.n_values(), ts.size(), t_eval);
+    ASSERT_EQ(out.size(), n_samples);
+    ASSERT_TRUE(out.allFinite());
+}
+
+TEST(Data, TimeSeriesTimingKernels)
+{
+    // sorted times, with a sample whose reference series is empty
+    TimeSeriesf::TimeType time = {
+        ArrayXi{{1, 3, 5, 7, 9}}, ArrayXi{{2, 4}}, ArrayXi{{0, 10}}
+    };
+    TimeSeriesf::ValType value = {
+        ArrayXf{{1, 3, 5, 7, 9}}, ArrayXf{{2, 4}}, ArrayXf{{0, 10}}
+    };
+    TimeSeriesb::TimeType ref_time = {
+        ArrayXi{{3, 6, 7}}, ArrayXi{}, ArrayXi{{10}}
+    };
+    TimeSeriesb::ValType ref_value = {
+        ArrayXb::Constant(3, true), ArrayXb(), ArrayXb::Constant(1, true)
+    };
+    TimeSeriesf ts(time, value);
+    TimeSeriesb ref(ref_time, ref_value);
+
+    TimeSeriesf before = ts.before(ref);
+    ASSERT_TRUE((before.value(0) == ArrayXf{{1}}).all());
+    ASSERT_EQ(before.length(1), 0);
+    ASSERT_TRUE((before.time(2) == ArrayXi{{0}}).all());
+
+    TimeSeriesf after = ts.after(ref);
+    ASSERT_TRUE((after.value(0) == ArrayXf{{9}}).all());
+    ASSERT_EQ(after.length(1), 0);
+    ASSERT_EQ(after.length(2), 0);
+
+    TimeSeriesf during = ts.during(ref);
+    ASSERT_TRUE((during.time(0) == ArrayXi{{3, 5, 7}}).all());
+    ASSERT_EQ(during.length(1), 0);
+    ASSERT_TRUE((during.time(2) == ArrayXi{{10}}).all());
+
+    ASSERT_THROW(ts.before(ref.middleRows(0, 2)), std::runtime_error);
+
+    // the merge matches a pairwise comparison on a larger population
+    const int n_samples = 50000;
+    TimeSeriesf::TimeType t1, t2;
+    TimeSeriesf::ValType v1, v2;
+    for (int i = 0; i < n_samples; ++i)
+    {
+        ArrayXi a = (ArrayXf::Random(i % 30).abs()*1000).cast<int>();
+        ArrayXi b = (ArrayXf::Random(i % 7).abs()*1000).cast<int>();
+        std::sort(a.begin(), a.end());
+        std::sort(b.begin(), b.end());
+        t1.push_back(a);
+        t2.push_back(b);
+        v1.push_back(a.cast<float>());
+        v2.push_back(b.cast<float>());
+    }
+    TimeSeriesf x(t1, v1), events(t2, v2);
+
+    Util::Timer timer;
+    timer.Reset();
+    TimeSeriesf x_during = x.during(events);
+    float t_merge = timer.Elapsed().count();
+    fmt::print("During over {} values in {} samples in {:.4f}s\n",
+               x.n_values(), x.size(), t_merge);
+
+    for (int i = 0; i < n_samples; ++i)
+    {
+        vector<int> expected;
+        for (auto t : t1.at(i))
+            if (t2.at(i).size() > 0 
+                && t >= t2.at(i).minCoeff() && t <= t2.at(i).maxCoeff())
+                expected.push_back(t);
+        ASSERT_EQ(x_during.length(i), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j)
+            ASSERT_EQ(x_during.time(i)(j), expected.at(j));
+    }
+}
+
+TEST(Data, OmopData)
+{
+    OmopData omop(fs::directory_iterator("data/OMOP"), TimeValues::timestamp, 20);
+
+    ASSERT_EQ(omop.cdm_version, "v5.2.2");
+    ASSERT_EQ(omop.get_n_samples(), 1000);
+    ASSERT_EQ(omop.person_ids.front(), 1);
+    ASSERT_TRUE(omop.features.contains("condition_era_30234"));
+
+    // person 1 had one era of condition 30234, on 2010-08-17
+    const auto& ts = std::get<TimeSeriesf>(omop.features.at("condition_era_30234"));
+    ASSERT_EQ(ts.size(), 1000);
+    ASSERT_TRUE((ts.time(0) == ArrayXi{{14838}}).all());
+    ASSERT_TRUE((ts.value(0) == ArrayXf{{1}}).all());
+
+    // observations are sorted by time within each person
+    for (const auto& [name, state] : omop.features)
+    {
+        const auto& f = std::get<TimeSeriesf>(state);
+        for (size_t i = 0; i < f.size(); ++i)
+            for (Eigen::Index k = 1; k < f.length(i); ++k)
+                ASSERT_LE(f.time(i)(k-1), f.time(i)(k));
+    }
+
+    // offsets count days from the first event of each person
+    OmopData offsets(fs::directory_iterator("data/OMOP"), TimeValues::offset, 20);
+    ASSERT_EQ(offsets.features.size(), omop.features.size());
+    int first = std::numeric_limits<int>::max();
+    for (const auto& [name, state] : offsets.features)
+    {
+        const auto& f = std::get<TimeSeriesf>(state);
+        if (f.length(0) > 0)
+            first = std::min(first, f.time(0).minCoeff());
+    }
+    ASSERT_EQ(first, 0);
+
+    Dataset d = omop.get_dataset(ArrayXf::Zero(omop.get_n_samples()));
+    ASSERT_EQ(d.get_n_samples(), 1000);
+    ASSERT_EQ(d.get_n_features(), omop.features.size());
+    ASSERT_EQ(d.get_feature_type("condition_era_30234"), DataType::TimeSeriesF);
+}
+
+TEST(Data, BatchScheduler)
+{
+    const int n_samples = 1000;
+    MatrixXf X = MatrixXf::Random(n_samples, 3);
+    ArrayXf y = (ArrayXf::Random(n_samples) > 0.6).cast<float>();
+    Dataset d(X, y, {}, {}, {}, true, 0.2);
+
+    // one epoch hands out every training row once, in batches of 10%
+    const auto train = d.get_training_data().get_indices();
+    BatchScheduler batches(d, 0.1);
+    ASSERT_EQ(batches.get_n_batch(), size_t(ceil(train.size()*0.1)));
+
+    vector<size_t> seen;
+    for (size_t b = 0; b < train.size()/batches.get_n_batch(); ++b)
+    {
+        auto batch = batches.next();
+        ASSERT_EQ(batch.get_n_samples(), batches.get_n_batch());
+        auto idx = batch.get_indices();
+        seen.insert(seen.end(), idx.begin(), idx.end());
+    }
+    ASSERT_EQ(batches.get_epoch(), 1);
+    std::sort(seen.begin(), seen.end());
+    ASSERT_TRUE(std::adjacent_find(seen.begin(), seen.end()) == seen.end());
+    for (auto i : seen)
+        ASSERT_TRUE(std::find(train.begin(), train.end(), i) != train.end());
+
+    // stratified batches keep the class proportions of the training rows
+    float p_train = 0;
+    for (auto i : train)
+        p_train += d.y(i);
+    p_train /= train.size();
+
+    BatchScheduler stratified(d, 0.1, true);
+    for (int b = 0; b < 20; ++b)
+    {
+        auto batch = stratified.next();
+        ASSERT_NEAR(batch.get_y().mean(), p_train, 2.0/batch.get_n_samples());
+    }
+
+    // the batch size grows at every new epoch, up to all training rows
+    BatchScheduler growing(d, 0.25, false, 2.0);
+    vector<size_t> sizes;
+    for (int b = 0; b < 10; ++b)
+        sizes.push_back(growing.next().get_n_samples());
+    ASSERT_EQ(sizes.front(), size_t(ceil(train.size()*0.25)));
+    ASSERT_EQ(sizes.back(), train.size());
+    ASSERT_TRUE(std::is_sorted(sizes.begin(), sizes.end()));
+
+    // a batch of all training rows is the training view, so its rows are
+    // neither copied nor given a new id
+    ASSERT_FLOAT_EQ(growing.get_batch_size(), 1.0);
+    ASSERT_EQ(growing.next().get().get_id(), 
+              d.get_training_data().get().get_id());
+
+    // without batches, the whole dataset is returned
+    BatchScheduler all(d, 1.0);
+    ASSERT_TRUE(all.next().is_identity());
+    ASSERT_FLOAT_EQ(all.get_batch_size(), 1.0);
+}
@@ -1,7 +1,8 @@
-#include <gtest/gtest.h>
+#include "testsHeader.h"
 #include "../../src/eval/evaluation.h"
 #include "../../src/eval/metrics.h"
 #include "../../src/eval/scorer.h"
+#include "../../src/data/io.h"
 
 using namespace Brush::Eval;
 
@@ -120,3 +121,324 @@ TEST(Evaluation, ScorerBinaryAccuracy)
 // TEST(EvaluationTest, AnotherMetricTest) {
 //     // TODO: Add test case for another metric
 // }
+
+TEST(Evaluation, TerminalColumnsAreBorrowed)
+{
+    using namespace Brush;
+    using namespace Brush::Data;
+
+    // microbenchmark for leaf evaluation, using the inputs of the accuracy
+    // test tiled to a larger number of samples
+    ArrayXf y(10), yhat(10);
+    y    << 0.0, 1.0, 0.0, 0.0, 1.0, 0.0, 0.0, 1.0, 0.0, 1.0;
+    yhat << 0.0, 1.0, 1.0, 0.0, 0.0, 1.0, 1.0, 0.0, 0.0, 0.0;
+
+    const int reps = 10000;
+    MatrixXf X(10*reps, 2);
+    X.col(0) = (0.5*y).replicate(reps, 1).matrix();
+    X.col(1) = (0.5*yhat).replicate(reps, 1).matrix();
+    ArrayXf target = y.replicate(reps, 1);
+
+    Dataset d(X, target);
+
+    // columns are returned by reference, without copying
+    ASSERT_EQ(&d.get<ArrayXf>("x_0"), &std::get<ArrayXf>(d["x_0"]));
+    ASSERT_THROW(d.get<ArrayXi>("x_0"), std::runtime_error);
+
+    tree<Node> leaf;
+    leaf.set_head(Node(NodeType::Terminal, Signature<ArrayXf()>{}, false, "x_0"));
+    tree<Node> weighted_leaf;
+    weighted_leaf.set_head(Node(NodeType::Terminal, Signature<ArrayXf()>{}, true, "x_1"));
+
+    const int n_evals = bench_size(1000, 10);
+    Util::Timer timer;
+    for (int i = 0; i < n_evals; ++i)
+    {
+        ArrayXf out = leaf.begin().node->predict<ArrayXf>(d);
+        ASSERT_EQ(out.size(), target.size());
+    }
+    float t_leaf = timer.Elapsed().count();
+
+    timer.Reset();
+    for (int i = 0; i < n_evals; ++i)
+    {
+        ArrayXf out = weighted_leaf.begin().node->predict<ArrayXf>(d);
+        ASSERT_EQ(out.size(), target.size());
+    }
+    float t_weighted = timer.Elapsed().count();
+
+    if (run_benchmarks())
+        fmt::print("leaf evaluation on {} samples: {:.2f} us (weighted: {:.2f} us)\n",
+            target.size(), 1e6*t_leaf/n_evals, 1e6*t_weighted/n_evals);
+
+    ArrayXf out = weighted_leaf.begin().node->predict<ArrayXf>(d);
+    ASSERT_TRUE(out.isApprox(std::get<ArrayXf>(d["x_1"])));
+}
+
+TEST(Evaluation, TiledEvaluation)
+{
+    using namespace Brush;
+    using namespace Brush::Data;
+
+    // scoring a program on a million rows, all at once and on row tiles
+    const int n = bench_size(1000000, 50000);
+    MatrixXf X = MatrixXf::Random(n, 4);
+    ArrayXf y = X.col(0).array()*X.col(1).array().sin() + X.col(2).array().exp();
+
+    Dataset d(X, y);
+
+    Parameters params;
+    params.max_size  = 30;
+    params.max_depth = 6;
+
+    SearchSpace SS;
+    SS.init(d);
+
+    RegressorProgram PRG = SS.make_regressor(0, 0, params);
+    while (PRG.size() < 10)
+        PRG = SS.make_regressor(0, 0, params);
+
+    // weights are fitted on a sample, so that timings are of evaluation only
+    PRG.fit(d(0, 1000));
+
+    Individual<PT::Regressor> ind(PRG);
+    Scorer<PT::Regressor> scorer("mse");
+
+    VectorXf loss;
+    const int n_evals = bench_size(5, 1);
+    Util::Timer timer(true);
+    float f;
+    for (int i = 0; i < n_evals; ++i)
+        f = scorer.score(ind, d, loss, params);
+    float t_whole = timer.Elapsed().count();
+
+    for (unsigned int tile : {1024u, 4096u, 16384u})
+    {
+        params.set_eval_tile_size(tile);
+        ASSERT_TRUE(params.use_tiles(d.get_n_samples()));
+
+        float f_tiled;
+        size_t start = Dataset::n_bytes_copied;
+        timer.Reset();
+        for (int i = 0; i < n_evals; ++i)
+            f_tiled = scorer.score(ind, d, loss, params);
+        float t_tiled = timer.Elapsed().count();
+
+        // tiles read the columns of the dataset in place
+        ASSERT_EQ(Dataset::n_bytes_copied, start);
+
+        if (run_benchmarks())
+            fmt::print("{} scored on {} samples: {:.2f} ms, {:.2f} ms on tiles of {} rows\n",
+                ind.program.get_model(), n, 1e3*t_whole/n_evals, 
+                1e3*t_tiled/n_evals, tile);
+
+        ASSERT_EQ(loss.size(), n);
+        if (std::isfinite(f))
+            ASSERT_NEAR(f_tiled, f, 1e-4*(1 + std::abs(f)));
+        else
+            ASSERT_FALSE(std::isfinite(f_tiled));
+    }
+
+    // fitting on tiles refits the weights of the same program
+    RegressorProgram tiled = PRG;
+    const Dataset sample = d(0, 10000);
+    tiled.fit(sample, 4096);
+    ASSERT_TRUE(tiled.is_fitted_);
+
+    // the optimizer evaluates the program on the tiles at every iteration,
+    // without copying their rows
+    size_t start = Dataset::n_bytes_copied;
+    tiled.update_weights(tiled.tiles(sample), 4096);
+    ASSERT_EQ(Dataset::n_bytes_copied, start);
+    ASSERT_EQ(tiled.size(), PRG.size());
+}
+
+TEST(Evaluation, SubtreeCache)
+{
+    using namespace Brush;
+
+    Parameters params;
+
+    Dataset data = Data::read_csv("docs/examples/datasets/d_enc.csv","label");
+
+    SearchSpace SS;
+    SS.init(data);
+
+    params.max_size  = 30;
+    params.max_depth = 6;
+
+    // a generation where every program has a clone
+    vector<Individual<PT::Regressor>> inds;
+    for (int i = 0; i < 20; ++i)
+    {
+        RegressorProgram PRG = SS.make_regressor(0, 0, params);
+        PRG.fit(data);
+        inds.push_back(Individual<PT::Regressor>(PRG));
+        inds.push_back(Individual<PT::Regressor>(PRG));
+    }
+
+    Evaluation<PT::Regressor> uncached, cached;
+    uncached.cache->set_max_bytes(0);
+    cached.cache->set_max_bytes(size_t(64) << 20);
+
+    auto same_fit = [](Individual<PT::Regressor>& a, Individual<PT::Regressor>& b) {
+        return a.fitness.get_loss() == b.fitness.get_loss()
+            && (a.error.array() == b.error.array() 
+                || (a.error.array().isNaN() && b.error.array().isNaN())).all();
+    };
+
+    // the generation is scored twice, like in a run. The outputs of the 
+    // clones are stored on the first pass, and read on the second one.
+    vector<Individual<PT::Regressor>> expected = inds;
+    for (auto& ind : expected)
+        uncached.assign_fit(ind, data, params);
+
+    Util::Timer timer(true);
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (int i = 0; i < inds.size(); ++i)
+        {
+            cached.assign_fit(inds.at(i), data, params);
+            ASSERT_TRUE(same_fit(inds.at(i), expected.at(i)));
+        }
+    }
+    float t_cached = timer.Elapsed().count();
+
+    fmt::print("subtree cache: {} lookups, hit rate {:.2f}, {} bytes saved, "
+        "{} entries ({} bytes) in {:.2f} ms\n",
+        cached.cache->get_n_lookups(), cached.cache->get_hit_rate(), 
+        cached.cache->get_bytes_saved(), cached.cache->get_n_entries(), 
+        cached.cache->get_n_bytes(), 1e3*t_cached);
+
+    ASSERT_GT(cached.cache->get_n_hits(), 0);
+    ASSERT_GT(cached.cache->get_bytes_saved(), 0);
+    ASSERT_EQ(uncached.cache->get_n_lookups(), 0);
+
+    // changing a weight changes the structural hash
+    auto changed = inds.at(0);
+    auto weighted = std::find_if(changed.program.Tree.begin(), 
+        changed.program.Tree.end(), [](const Node& n){ 
+            return n.get_is_weighted() && n.ret_type == DataType::ArrayF; });
+    if (weighted != changed.program.Tree.end())
+    {
+        weighted->W += 1.0;
+        auto changed_expected = changed;
+        uncached.assign_fit(changed_expected, data, params);
+        cached.assign_fit(changed, data, params);
+        ASSERT_TRUE(same_fit(changed, changed_expected));
+    }
+
+    // outputs are tied to the dataset rather than its address, which a new
+    // dataset may reuse once the old one is freed
+    vector<size_t> order(data.get_n_samples());
+    std::iota(order.rbegin(), order.rend(), 0);
+    for (int k = 0; k < 2; ++k)
+    {
+        auto other = std::make_unique<Dataset>(k == 0 ? data : data(order));
+        ASSERT_NE(other->get_id(), data.get_id());
+        for (int i = 0; i < inds.size(); ++i)
+        {
+            auto ind = inds.at(i), ind_expected = inds.at(i);
+            uncached.assign_fit(ind_expected, *other, params);
+            cached.assign_fit(ind, *other, params);
+            ASSERT_TRUE(same_fit(ind, ind_expected));
+        }
+    }
+
+    // the budget bounds the stored outputs
+    cached.cache->set_max_bytes(data.get_n_samples()*sizeof(float));
+    ASSERT_LE(cached.cache->get_n_bytes(), cached.cache->get_max_bytes());
+    for (auto& ind : inds)
+        cached.assign_fit(ind, data, params);
+    ASSERT_LE(cached.cache->get_n_bytes(), cached.cache->get_max_bytes());
+
+    cached.new_generation();
+    ASSERT_EQ(cached.cache->get_n_entries(), 0);
+    ASSERT_EQ(cached.cache->get_n_lookups(), 0);
+}
+
+TEST(Evaluation, BatchedTiles)
+{
+    using namespace Brush;
+
+    // a generation scored on row tiles, one program at a time and as a
+    // batch sharing the tiles
+    const int n = bench_size(200000, 20000);
+    MatrixXf X = MatrixXf::Random(n, 8);
+    ArrayXf y = X.col(0).array()*X.col(1).array().sin() + X.col(2).array().exp();
+
+    Dataset d(X, y);
+
+    Parameters params;
+    params.max_size  = 20;
+    params.max_depth = 6;
+    params.set_eval_tile_size(4096);
+
+    SearchSpace SS;
+    SS.init(d);
+
+    vector<Individual<PT::Regressor>> inds;
+    for (int i = 0; i < 50; ++i)
+    {
+        RegressorProgram PRG = SS.make_regressor(0, 0, params);
+        PRG.fit(d(0, 1000));
+        inds.push_back(Individual<PT::Regressor>(PRG));
+    }
+    vector<Individual<PT::Regressor>> batched = inds;
+
+    Evaluation<PT::Regressor> evaluator;
+
+    size_t start = Dataset::n_bytes_copied;
+    Util::Timer timer(true);
+    for (auto& ind : inds)
+        evaluator.assign_fit(ind, d, params);
+    float t_single = timer.Elapsed().count();
+    size_t bytes_single = Dataset::n_bytes_copied - start;
+
+    vector<Individual<PT::Regressor>*> batch;
+    for (auto& ind : batched)
+        batch.push_back(&ind);
+
+    start = Dataset::n_bytes_copied;
+    timer.Reset();
+    evaluator.assign_fit_batch(batch, d, params);
+    float t_batched = timer.Elapsed().count();
+    size_t bytes_batched = Dataset::n_bytes_copied - start;
+
+    if (run_benchmarks())
+        fmt::print("{} programs on {} samples: {:.2f} ms and {} bytes of tiles "
+            "one by one, {:.2f} ms and {} bytes as a batch\n", inds.size(), n,
+            1e3*t_single, bytes_single, 1e3*t_batched, bytes_batched);
+
+    for (int i = 0; i < inds.size(); ++i)
+    {
+        const auto& a = inds.at(i);
+        const auto& b = batched.at(i);
+        ASSERT_TRUE(a.fitness.get_loss() == b.fitness.get_loss()
+            || (std::isnan(a.fitness.get_loss()) && std::isnan(b.fitness.get_loss())));
+        ASSERT_EQ(a.fitness.get_loss_v(), b.fitness.get_loss_v());
+        ASSERT_TRUE((a.error.array() == b.error.array() 
+            || (a.error.array().isNaN() && b.error.array().isNaN())).all());
+        ASSERT_EQ(a.fitness.get_values(), b.fitness.get_values());
+    }
+    ASSERT_EQ(bytes_single, 0);
+    ASSERT_EQ(bytes_batched, 0);
+
+    // tiles of the same rows share an id, so a generation scored twice 
+    // reads the outputs of the shared subtrees from the cache
+    vector<Individual<PT::Regressor>> cached = inds;
+    batch.clear();
+    for (auto& ind : cached)
+        batch.push_back(&ind);
+
+    evaluator.cache->set_max_bytes(size_t(64) << 20);
+    evaluator.assign_fit_batch(batch, d, params);
+    evaluator.assign_fit_batch(batch, d, params);
+    ASSERT_GT(evaluator.cache->get_n_hits(), 0);
+    for (int i = 0; i < inds.size(); ++i)
+    {
+        ASSERT_TRUE(inds.at(i).fitness.get_loss() == cached.at(i).fitness.get_loss()
+            || (std::isnan(inds.at(i).fitness.get_loss()) 
+                && std::isnan(cached.at(i).fitness.get_loss())));
+    }
+}
@@ -0,0 +1,197 @@
+#include "testsHeader.h"
+
+#include "../../src/util/fast_math.h"
+#include "../../src/data/io.h"
+#include <chrono>
+#include <cfloat>
+
+namespace FastMath = Brush::Util::FastMath;
+
+namespace {
+
+using Kernel = void(*)(const float*, float*, size_t);
+
+// inputs drawn uniformly from [lo, hi], followed by special values
+ArrayXf make_inputs(float lo, float hi, size_t n=1<<16)
+{
+    vector<float> special = {0.0f, -0.0f, 1.0f, -1.0f, FLT_MIN, -FLT_MIN,
+        1e-40f, -1e-40f, FLT_MAX, -FLT_MAX, 88.5f, -88.5f, 1e30f, -1e30f,
+        std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::quiet_NaN()};
+
+    ArrayXf x(n + special.size());
+    x.head(n) = lo + (hi - lo)*(ArrayXf::Random(n) + 1.0f)/2.0f;
+    for (size_t i = 0; i < special.size(); ++i)
+        x(n + i) = special.at(i);
+    return x;
+}
+
+// max relative error of `out` against the reference, in units of the
+// float epsilon. Special values must match exactly. Results below FLT_MIN
+// are compared in absolute terms.
+float max_error(const ArrayXf& x, const ArrayXf& out,
+                std::function<double(double)> ref, bool absolute=false)
+{
+    float max_err = 0;
+    for (int i = 0; i < x.size(); ++i)
+    {
+        const float r = float(ref(double(x(i))));
+        if (!std::isfinite(r) || !std::isfinite(out(i)))
+        {
+            EXPECT_TRUE((std::isnan(r) && std::isnan(out(i))) || r == out(i))
+                << "x = " << x(i) << ": " << out(i) << " vs " << r;
+            continue;
+        }
+        const double diff = std::fabs(double(out(i)) - double(r));
+        const double scale = absolute ? 1.0 : std::max(std::fabs(double(r)),
+                                                       double(FLT_MIN));
+        max_err = std::max(max_err, float(diff/scale/FLT_EPSILON));
+    }
+    return max_err;
+}
+
+}
+
+TEST(FastMath, Accuracy)
+{
+    struct Case {
+        string name;
+        Kernel kernel;
+        std::function<double(double)> ref;
+        float lo, hi;
+        bool absolute;
+        float tol; // in ulp
+    };
+
+    vector<Case> cases = {
+        {"exp", FastMath::exp, [](double v){ return std::exp(v); }, -90, 90, false, 4},
+        {"log", FastMath::log, [](double v){ return std::log(v); }, 0, 1e6, false, 4},
+        {"logabs", FastMath::logabs, [](double v){ return std::log(std::fabs(v)); }, -1e3, 1e3, false, 4},
+        {"sin", FastMath::sin, [](double v){ return std::sin(v); }, -1e4, 1e4, true, 4},
+        {"cos", FastMath::cos, [](double v){ return std::cos(v); }, -1e4, 1e4, true, 4},
+        {"tanh", FastMath::tanh, [](double v){ return std::tanh(v); }, -20, 20, false, 4},
+        {"sinh", FastMath::sinh, [](double v){ return std::sinh(v); }, -90, 90, false, 4},
+        {"cosh", FastMath::cosh, [](double v){ return std::cosh(v); }, -90, 90, false, 4},
+        {"logistic", FastMath::logistic, [](double v){ return 1.0/(1.0 + std::exp(-v)); }, -87, 87, false, 4},
+    };
+
+    fmt::print("fast math kernels run with {}\n", FastMath::get_isa());
+    for (const auto& c : cases)
+    {
+        ArrayXf x = make_inputs(c.lo, c.hi);
+        ArrayXf out(x.size());
+
+        auto start = std::chrono::steady_clock::now();
+        c.kernel(x.data(), out.data(), x.size());
+        float ms = std::chrono::duration<float, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+
+        float err = max_error(x, out, c.ref, c.absolute);
+        fmt::print("{:>9}: max error {:.2f} ulp in {:.3f} ms\n", c.name, err, ms);
+        EXPECT_LE(err, c.tol) << c.name;
+    }
+
+    // pow, with bases of both signs and exponents that over and underflow
+    ArrayXf x = make_inputs(-10, 10);
+    ArrayXf y = 40.0f*ArrayXf::Random(x.size());
+    y.head(100) = y.head(100).round();
+    ArrayXf out(x.size());
+    FastMath::pow(x.data(), y.data(), out.data(), x.size());
+    float max_err = 0;
+    for (int i = 0; i < x.size(); ++i)
+    {
+        const float r = float(std::pow(double(x(i)), double(y(i))));
+        if (!std::isfinite(r) || !std::isfinite(out(i)) || std::fabs(r) < FLT_MIN)
+        {
+            EXPECT_TRUE((std::isnan(r) && std::isnan(out(i))) || r == out(i)
+                || std::fabs(out(i) - r) < FLT_MIN)
+                << x(i) << "^" << y(i) << ": " << out(i) << " vs " << r;
+            continue;
+        }
+        max_err = std::max(max_err, std::fabs(out(i) - r)/std::fabs(r));
+    }
+    fmt::print("{:>9}: max relative error {:.2e}\n", "pow", max_err);
+    EXPECT_LE(max_err, 1e-5);
+}
+
+TEST(FastMath, Precision)
+{
+    ASSERT_THROW(FastMath::Scope precision("approximate"), std::runtime_error);
+
+    // parameters only take the precisions the operators know. Parameters
+    // read from json are checked where their precision is used.
+    Parameters checked;
+    ASSERT_THROW(checked.set_precision("approximate"), std::runtime_error);
+    json j = checked;
+    j["precision"] = "approximate";
+    Parameters loaded = j.get<Parameters>();
+    ASSERT_THROW(FastMath::Scope precision(loaded.precision), std::runtime_error);
+    j["precision"] = "fast";
+    ASSERT_EQ(j.get<Parameters>().precision, "fast");
+
+    Parameters params;
+    params.max_size  = 10;
+    params.max_depth = 5;
+    params.functions = {{"Add", 1.0}, {"Mul", 1.0}, {"Exp", 1.0},
+        {"Logabs", 1.0}, {"Sin", 1.0}, {"Cos", 1.0}, {"Tanh", 1.0},
+        {"Logistic", 1.0}};
+
+    Dataset data = Data::read_csv("docs/examples/datasets/d_enc.csv","label");
+
+    SearchSpace SS;
+    SS.init(data, params.functions);
+
+    size_t n_close = 0, n = 0;
+    for (int p = 0; p < 50; ++p)
+    {
+        RegressorProgram PRG = SS.make_regressor(0, 0, params);
+        PRG.fit(data);
+        ArrayXf exact = PRG.predict(data);
+
+        ArrayXf fast, fast_tree;
+        {
+            FastMath::Scope precision("fast");
+            fast = PRG.predict(data);
+            // the node outputs match the compiled ones
+            fast_tree = PRG.Tree.begin().node->predict<ArrayXf>(data);
+        }
+        ASSERT_FALSE(FastMath::enabled());
+
+        ASSERT_EQ(fast.size(), exact.size());
+        for (int i = 0; i < fast.size(); ++i)
+        {
+            ASSERT_TRUE(fast(i) == fast_tree(i)
+                    || (std::isnan(fast(i)) && std::isnan(fast_tree(i))));
+            ++n;
+            if (fast(i) == exact(i) || (std::isnan(fast(i)) && std::isnan(exact(i)))
+            ||  std::fabs(fast(i) - exact(i)) <= 1e-4*std::max(1.0f, std::fabs(exact(i))))
+                ++n_close;
+        }
+    }
+    fmt::print("{} of {} predictions in fast precision within 1e-4 of exact "
+               "ones\n", n_close, n);
+    ASSERT_GE(float(n_close)/n, 0.999);
+
+    // evaluation scores with the precision of the parameters, on the 
+    // thread that evaluates, which it leaves as it was
+    params.precision = "fast";
+    Eval::Evaluation<ProgramType::Regressor> evaluator;
+    for (int p = 0; p < 10; ++p)
+    {
+        RegressorProgram PRG = SS.make_regressor(0, 0, params);
+        PRG.fit(data);
+        Individual<ProgramType::Regressor> ind(PRG);
+        evaluator.assign_fit(ind, data, params);
+        ASSERT_FALSE(FastMath::enabled());
+
+        VectorXf errors;
+        {
+            FastMath::Scope precision("fast");
+            Eval::Scorer<ProgramType::Regressor> S(evaluator.get_scorer());
+            S.score(ind, data.get_training_data(), errors, params);
+        }
+        ASSERT_TRUE((ind.error.array() == errors.array()
+            || (ind.error.array().isNaN() && errors.array().isNaN())).all());
+    }
+}
@@ -5,6 +5,8 @@
 #include "../../src/program/program.h"
 #include "../../src/program/dispatch_table.h"
 #include "../../src/data/io.h"
+#include <filesystem>
+#include <dlfcn.h>
 
 TEST(Program, MakeRegressor)
 {
@@ -397,4 +399,882 @@ TEST(Program, ComparisonAndBooleanOperators)
         ASSERT_GT(PRG.depth(), 0);
         ASSERT_GT(PRG.size(), 0);
     }
-}
\ No newline at end of file
+}
+TEST(Program, ChunkedEvaluation)
+{
+    Parameters params;
+
+    Dataset data = Data::read_csv("docs/examples/datasets/d_enc.csv","label");
+
+    SearchSpace SS;
+    SS.init(data);
+
+    const string path = (std::filesystem::temp_directory_path()
+                         / "brush_test_chunked_evaluation.bin").string();
+    data.save_binary(path);
+
+    DatasetFile file(path);
+    DatasetChunks chunks(data);
+    const vector<const ChunkSource*> sources = {&chunks, &file};
+
+    // chunk sizes that do not divide the number of samples. Multiples of 
+    // the packet size keep rows in the same SIMD lanes as in whole-data 
+    // evaluation.
+    const size_t chunk_size = 80;
+    ASSERT_NE(data.get_n_samples() % chunk_size, 0);
+
+    // rows gathered by splits may still fall in other lanes, which vectorized
+    // kernels round differently, so values are compared up to float
+    // precision, and overflows may be inf or nan
+    auto same = [](const ArrayXf& a, const ArrayXf& b) {
+        return a.size() == b.size() 
+            && (a == b || (!a.isFinite() && !b.isFinite())
+                || (a - b).abs() <= 1e-4*(1 + a.abs().max(b.abs()))).all();
+    };
+
+    Scorer<PT::Regressor> scorer("mse");
+    for (int d = 1; d < 6; ++d) { 
+        for (int s = 1; s < 50; s+=10) {
+            params.max_size  = s;
+            params.max_depth = d;
+
+            RegressorProgram PRG = SS.make_regressor(0, 0, params);
+            PRG.fit(data);
+
+            Individual<PT::Regressor> ind(PRG);
+            VectorXf loss;
+            ArrayXf y_pred = PRG.predict(data);
+            float score = scorer.score(ind, data, loss, params);
+
+            for (const auto* source : sources)
+            {
+                // predictions and fitness match whole-data evaluation
+                ASSERT_TRUE(same(PRG.predict(*source, chunk_size), y_pred));
+
+                VectorXf chunked_loss;
+                float chunked_score = scorer.score(ind, *source, chunk_size,
+                                                   chunked_loss, params);
+                ASSERT_TRUE(same(ArrayXf::Constant(1, chunked_score), 
+                                 ArrayXf::Constant(1, score)));
+                ASSERT_TRUE(same(chunked_loss.array(), loss.array()));
+
+                // and so are the residuals seen by the weight optimizer. 
+                // Fitted weights are not compared, since models with 
+                // redundant weights have many equivalent optima.
+                ArrayXf weights = PRG.get_weights();
+                ResidualEvaluator<RegressorProgram> whole(PRG, data);
+                ResidualEvaluator<RegressorProgram> chunked(PRG, *source, chunk_size);
+                ArrayXf whole_res(whole.NumResiduals());
+                ArrayXf chunked_res(chunked.NumResiduals());
+                whole(weights.data(), whole_res.data());
+                chunked(weights.data(), chunked_res.data());
+                ASSERT_TRUE(same(chunked_res, whole_res));
+            }
+        }
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST(Program, CompiledEvaluation)
+{
+    Parameters params;
+
+    Dataset data = Data::read_csv("docs/examples/datasets/d_enc.csv","label");
+
+    SearchSpace SS;
+    SS.init(data);
+
+    auto same = [](const ArrayXf& a, const ArrayXf& b) {
+        return a.size() == b.size() 
+            && (a == b || (a.isNaN() && b.isNaN())).all();
+    };
+
+    // benchmark of the compiled and the recursive evaluation, 
+    // for small and large trees
+    const int n_programs = 20;
+    const int n_evals = bench_size(50, 1);
+    for (int s : {10, 100}) {
+        params.max_size  = s;
+        params.max_depth = 10;
+
+        float t_recursive = 0, t_compiled = 0;
+        int n_nodes = 0;
+        for (int p = 0; p < n_programs; ++p)
+        {
+            RegressorProgram PRG = SS.make_regressor(0, 0, params);
+            PRG.fit(data);
+            n_nodes += PRG.Tree.size();
+
+            ArrayXf y_rec = PRG.Tree.begin().node->predict<ArrayXf>(data);
+            ArrayXf y = PRG.predict(data);
+            ASSERT_TRUE(same(y, y_rec));
+            // splits are compiled with their subtrees
+            ASSERT_LE(PRG.compiled_predict.size(), PRG.Tree.size());
+
+            // the dual tree used by the weight optimizer
+            ArrayXf weights = PRG.get_weights();
+            ArrayXfJet wjet = weights.cast<fJet>();
+            const fJet* wjet_ptr = wjet.data();
+            ArrayXfJet yjet_rec = PRG.Tree.begin().node->predict<ArrayXfJet>(data, &wjet_ptr);
+            const fJet* wjet_rec_end = wjet_ptr;
+            wjet_ptr = wjet.data();
+            ArrayXfJet yjet = PRG.predict_with_weights<ArrayXfJet>(data, &wjet_ptr);
+            // weights are consumed in the same order
+            ASSERT_EQ(wjet_ptr, wjet_rec_end);
+            ArrayXf yjet_a(yjet.size()), yjet_rec_a(yjet.size());
+            for (int i = 0; i < yjet.size(); ++i){
+                yjet_a(i) = yjet(i).a;
+                yjet_rec_a(i) = yjet_rec(i).a;
+            }
+            ASSERT_TRUE(same(yjet_a, yjet_rec_a));
+
+            Util::Timer timer(true);
+            for (int i = 0; i < n_evals; ++i)
+                y_rec = PRG.Tree.begin().node->predict<ArrayXf>(data);
+            t_recursive += timer.Elapsed().count();
+
+            timer.Reset();
+            for (int i = 0; i < n_evals; ++i)
+                y = PRG.predict(data);
+            t_compiled += timer.Elapsed().count();
+        }
+        if (run_benchmarks())
+            fmt::print("max size {} (mean size {:.1f}), {} samples: "
+                "recursive {:.2f} us, compiled {:.2f} us per evaluation\n",
+                s, float(n_nodes)/n_programs, data.get_n_samples(),
+                1e6*t_recursive/(n_programs*n_evals), 
+                1e6*t_compiled/(n_programs*n_evals));
+    }
+
+    // changing the tree regenerates the instructions
+    params.max_size  = 10;
+    params.max_depth = 5;
+    RegressorProgram PRG;
+    auto is_float_terminal = [](const Node& n){
+        return n.node_type == NodeType::Terminal && n.ret_type == DataType::ArrayF;
+    };
+    do {
+        PRG = SS.make_regressor(0, 0, params);
+    } while (std::none_of(PRG.Tree.begin(), PRG.Tree.end(), is_float_terminal));
+
+    PRG.fit(data);
+    PRG.predict(data);
+    ASSERT_TRUE(PRG.compiled_predict.is_compiled());
+    PRG.predict(data);
+    ASSERT_TRUE(PRG.compiled_predict.is_compiled());
+
+    auto spot = std::find_if(PRG.Tree.begin(), PRG.Tree.end(), is_float_terminal);
+    PRG.Tree.replace(spot, Node(NodeType::Constant, Signature<ArrayXf()>{}, true));
+    PRG.tree_changed();
+    ASSERT_FALSE(PRG.compiled_predict.is_compiled());
+    ASSERT_FALSE(PRG.compiled_fit.is_compiled());
+    ASSERT_TRUE(same(PRG.predict(data), 
+                     PRG.Tree.begin().node->predict<ArrayXf>(data)));
+
+    // copies are compiled from their own tree
+    auto clone = PRG.copy();
+    ASSERT_FALSE(clone.compiled_predict.is_compiled());
+    ASSERT_TRUE(same(clone.predict(data), PRG.predict(data)));
+    ASSERT_TRUE(clone.compiled_predict.is_compiled());
+}
+
+TEST(Program, CachedCallables)
+{
+    Parameters params;
+
+    Dataset data = Data::read_csv("docs/examples/datasets/d_enc.csv","label");
+
+    SearchSpace SS;
+    SS.init(data);
+
+    params.max_size  = 50;
+    params.max_depth = 10;
+
+    RegressorProgram PRG = SS.make_regressor(0, 0, params);
+    PRG.fit(data);
+    ArrayXf y = PRG.Tree.begin().node->predict<ArrayXf>(data);
+
+    // every evaluated node resolved its callables. Splits do not evaluate 
+    // branches that receive no rows.
+    for (auto it = PRG.Tree.begin(); it != PRG.Tree.end(); ++it)
+    {
+        bool in_split = false;
+        for (auto p = it.node->parent; p != nullptr; p = p->parent)
+            in_split |= Is<NodeType::SplitOn, NodeType::SplitBest>(p->data.node_type);
+        if (!in_split)
+            ASSERT_TRUE(it.node->ops.is_resolved_for(it.node->data));
+    }
+
+    // lookups in the dispatch table, compared to the cached callables
+    const int n_lookups = bench_size(100000, 100);
+    const TreeNode* root = PRG.Tree.begin().node;
+    Util::Timer timer(true);
+    size_t n_found = 0;
+    for (int i = 0; i < n_lookups; ++i)
+    {
+        auto F = dtable_predict.template Get<ArrayXf>(root->data.node_type, 
+                                                      root->data.sig_hash);
+        n_found += bool(F);
+    }
+    float t_table = timer.Elapsed().count();
+
+    timer.Reset();
+    for (int i = 0; i < n_lookups; ++i)
+        n_found += bool(PRG.Tree.begin().node->ops.get_predict<ArrayXf>(root->data));
+    float t_cached = timer.Elapsed().count();
+    ASSERT_EQ(n_found, 2*n_lookups);
+    if (run_benchmarks())
+        fmt::print("callable of {}: table lookup {:.1f} ns, cached {:.1f} ns\n",
+            root->data.get_name(), 1e9*t_table/n_lookups, 1e9*t_cached/n_lookups);
+
+    // replacing the data of a node in place resolves its callables again
+    auto is_float_terminal = [](const Node& n){
+        return n.node_type == NodeType::Terminal && n.ret_type == DataType::ArrayF;
+    };
+    auto spot = std::find_if(PRG.Tree.begin(), PRG.Tree.end(), is_float_terminal);
+    if (spot == PRG.Tree.end())
+        return;
+
+    spot.node->data = Node(NodeType::Constant, Signature<ArrayXf()>{}, true);
+    ASSERT_FALSE(spot.node->ops.is_resolved_for(spot.node->data));
+
+    ArrayXf y_const = spot.node->predict<ArrayXf>(data);
+    ASSERT_TRUE((y_const == spot->W).all());
+    ASSERT_TRUE(spot.node->ops.is_resolved_for(spot.node->data));
+}
+
+TEST(Program, ArenaBuffers)
+{
+    Parameters params;
+
+    Dataset data = Data::read_csv("docs/examples/datasets/d_enc.csv","label");
+
+    SearchSpace SS;
+    SS.init(data);
+
+    params.max_size  = 50;
+    params.max_depth = 10;
+
+    auto same = [](const ArrayXf& a, const ArrayXf& b) {
+        return a.size() == b.size() 
+            && (a == b || (a.isNaN() && b.isNaN())).all();
+    };
+
+    vector<RegressorProgram> programs;
+    for (int p = 0; p < 20; ++p)
+    {
+        programs.push_back(SS.make_regressor(0, 0, params));
+        programs.back().fit(data);
+    }
+
+    auto& arena = Util::BufferArena::local();
+
+    // the first evaluation of a generation fills the arena, and evaluating
+    // it again draws every intermediate output from it
+    arena.reset_counters();
+    for (auto& PRG : programs)
+        arena.release(PRG.predict(data));
+    size_t n_warmup = arena.get_n_allocations();
+
+    arena.reset_counters();
+    for (auto& PRG : programs)
+    {
+        ArrayXf y = PRG.predict(data);
+        ASSERT_TRUE(same(y, PRG.Tree.begin().node->predict<ArrayXf>(data)));
+        arena.release(std::move(y));
+    }
+    fmt::print("arena allocations per evaluation: {:.2f} on the first pass, "
+        "{:.2f} after ({} buffers reused, {} bytes held)\n", 
+        float(n_warmup)/programs.size(), 
+        float(arena.get_n_allocations())/programs.size(),
+        arena.get_n_reused(), arena.get_n_bytes());
+    ASSERT_EQ(arena.get_n_allocations(), 0);
+
+    // buffers over the budget of the arena are freed
+    size_t n_bytes = arena.get_n_bytes();
+    size_t max_bytes = arena.get_max_bytes();
+    arena.set_max_bytes(n_bytes);
+    arena.release(ArrayXf(data.get_n_samples()));
+    ASSERT_EQ(arena.get_n_bytes(), n_bytes);
+    arena.set_max_bytes(max_bytes);
+}
+
+TEST(Operators, FoldedReductions)
+{
+    // n-ary reductions fold their arguments into one buffer, rather than
+    // stacking them into a matrix that is reduced row-wise
+    const int n = bench_size(100000, 1000);
+    MatrixXf X = MatrixXf::Random(n, 4);
+    ArrayXf y = X.rowwise().sum().array();
+    Dataset d(X, y);
+
+    using S = Signature<ArrayXf(ArrayXf,ArrayXf,ArrayXf,ArrayXf)>;
+
+    auto make_tree = [](NodeType nt) {
+        tree<Node> t;
+        auto root = t.set_head(Node(nt, S{}, true));
+        root.node->data.W = 0.5;
+        for (int i = 0; i < 4; ++i)
+        {
+            auto leaf = t.append_child(root, Node(NodeType::Terminal, 
+                Signature<ArrayXf()>{}, true, fmt::format("x_{}", i)));
+            leaf.node->data.W = 1.0 + i;
+        }
+        return t;
+    };
+
+    // the reduction of the stacked arguments, as evaluated before folds
+    auto stacked = [&]<NodeType NT>(tree<Node>& t) {
+        auto op = Operator<NT, S, false>{};
+        static_assert(decltype(op)::Fold);
+        return ArrayXf(op.apply_weighted(op.get_kids(d, *t.begin().node), 
+                                         *t.begin().node, nullptr));
+    };
+
+    auto check = [&]<NodeType NT>() {
+        tree<Node> t = make_tree(NT);
+        ArrayXf expected = stacked.template operator()<NT>(t);
+
+        // recursive evaluation
+        ArrayXf folded = t.begin().node->predict<ArrayXf>(d);
+        ASSERT_TRUE(folded.isApprox(expected, 1e-6)) << NodeTypeName[NT];
+
+        // compiled evaluation
+        CompiledProgram<false> compiled;
+        ArrayXf run = compiled.run<ArrayXf>(t, d);
+        ASSERT_TRUE(run.isApprox(expected, 1e-6)) << NodeTypeName[NT];
+        ASSERT_TRUE((run == folded).all()) << NodeTypeName[NT];
+    };
+    check.template operator()<NodeType::Sum>();
+    check.template operator()<NodeType::Prod>();
+    check.template operator()<NodeType::Min>();
+    check.template operator()<NodeType::Max>();
+    check.template operator()<NodeType::Mean>();
+
+    // timing of a wide sum
+    if (!run_benchmarks())
+        return;
+
+    tree<Node> t = make_tree(NodeType::Sum);
+    CompiledProgram<false> compiled;
+    const int n_evals = 200;
+    Util::Timer timer(true);
+    for (int i = 0; i < n_evals; ++i)
+        Util::BufferArena::local().release(stacked.template operator()<NodeType::Sum>(t));
+    float t_stacked = timer.Elapsed().count();
+
+    timer.Reset();
+    for (int i = 0; i < n_evals; ++i)
+        Util::BufferArena::local().release(compiled.run<ArrayXf>(t, d));
+    float t_folded = timer.Elapsed().count();
+
+    fmt::print("Sum of 4 arguments on {} samples: {:.2f} us stacked, "
+        "{:.2f} us folded\n", n, 1e6*t_stacked/n_evals, 1e6*t_folded/n_evals);
+}
+
+TEST(Program, TriviallyCopyableNodes)
+{
+    static_assert(std::is_trivially_copyable_v<Node>);
+
+    Parameters params;
+    params.max_size  = 50;
+    params.max_depth = 10;
+
+    Dataset data = Data::read_csv("docs/examples/datasets/d_enc.csv","label");
+
+    SearchSpace SS;
+    SS.init(data);
+
+    vector<RegressorProgram> programs;
+    size_t n_nodes = 0;
+    for (int p = 0; p < 100; ++p)
+    {
+        programs.push_back(SS.make_regressor(0, 0, params));
+        n_nodes += programs.back().Tree.size();
+    }
+
+    // interned names and features are shared, and survive serialization
+    for (const auto& PRG : programs)
+    {
+        json j = PRG;
+        RegressorProgram loaded = j;
+        ASSERT_EQ(loaded.get_model(), PRG.get_model());
+        for (auto a = PRG.Tree.begin(), b = loaded.Tree.begin(); 
+             a != PRG.Tree.end(); ++a, ++b)
+        {
+            ASSERT_EQ(&a->name.get(), &b->name.get());
+            ASSERT_EQ(&a->get_feature(), &b->get_feature());
+            ASSERT_EQ(a->get_arg_types(), b->get_arg_types());
+            ASSERT_EQ(a->get_node_hash(), b->get_node_hash());
+        }
+    }
+
+    // nodes as they were before interning, holding their own strings
+    struct OwningNode {
+        string name;
+        NodeType node_type;
+        DataType ret_type;
+        vector<DataType> arg_types;
+        size_t sig_hash, sig_dual_hash;
+        bool node_is_fixed, weight_is_fixed, is_weighted;
+        float prob_change, W;
+        bool center_op;
+        string feature;
+        int feature_id;
+        DataType feature_type;
+        bool keep_split_feature;
+    };
+
+    vector<Node> nodes;
+    vector<OwningNode> owning_nodes;
+    for (const auto& PRG : programs)
+        for (const auto& n : PRG.Tree)
+        {
+            nodes.push_back(n);
+            owning_nodes.push_back({n.name, n.node_type, n.ret_type, 
+                n.get_arg_types(), n.sig_hash, n.sig_dual_hash, 
+                n.node_is_fixed, n.weight_is_fixed, n.is_weighted, 
+                n.get_prob_change(), n.W, n.center_op, n.get_feature(), 
+                n.get_feature_id(), n.get_feature_type(), 
+                n.get_keep_split_feature()});
+        }
+
+    ASSERT_LT(sizeof(Node), sizeof(OwningNode));
+    if (!run_benchmarks())
+        return;
+
+    auto time = [&](auto f) {
+        auto start = std::chrono::steady_clock::now();
+        for (int rep = 0; rep < 20; ++rep)
+            f();
+        return std::chrono::duration<float, std::nano>(
+            std::chrono::steady_clock::now() - start).count()/20/n_nodes;
+    };
+
+    float t_nodes = time([&]{ 
+        vector<Node> copy(nodes); 
+        ASSERT_EQ(copy.size(), n_nodes); });
+    float t_owning = time([&]{ 
+        vector<OwningNode> copy(owning_nodes); 
+        ASSERT_EQ(copy.size(), n_nodes); });
+    float t_trees = time([&]{ 
+        vector<RegressorProgram> copy(programs); 
+        ASSERT_EQ(copy.size(), programs.size()); });
+
+    fmt::print("sizeof(Node) = {} bytes ({} with owned strings). Copies: "
+        "{:.1f} ns/node, {:.1f} ns/node with owned strings, {:.1f} ns/node "
+        "for whole programs\n", sizeof(Node), sizeof(OwningNode), t_nodes, 
+        t_owning, t_trees);
+}
+
+TEST(Program, FlatTree)
+{
+    Parameters params;
+    params.max_size  = 50;
+    params.max_depth = 10;
+
+    Dataset data = Data::read_csv("docs/examples/datasets/d_enc.csv","label");
+
+    SearchSpace SS;
+    SS.init(data);
+
+    vector<RegressorProgram> programs;
+    for (int p = 0; p < 100; ++p)
+        programs.push_back(SS.make_regressor(0, 0, params));
+
+    for (auto& PRG : programs)
+    {
+        FlatTree flat = PRG.flatten();
+        ASSERT_EQ(flat.size(), PRG.Tree.size());
+        ASSERT_EQ(flat.get_size(), PRG.size());
+        ASSERT_EQ(flat.get_size(false), PRG.size(false));
+        ASSERT_EQ(flat.depth(), PRG.depth());
+        ASSERT_EQ(flat.get_n_weights(), PRG.get_n_weights());
+        ASSERT_TRUE((flat.get_weights() == PRG.get_weights()).all());
+
+        // subtrees are spans of the array
+        auto spot = PRG.Tree.begin();
+        for (size_t i = 0; i < flat.size(); ++i, ++spot)
+        {
+            ASSERT_EQ(flat.subtree_size(i), PRG.Tree.size(spot));
+            ASSERT_EQ(flat.parent(i) == -1, PRG.Tree.depth(spot) == 0);
+        }
+
+        // same json as the tree, and the conversions keep the program
+        json j = flat;
+        ASSERT_EQ(j, json(PRG.Tree));
+        FlatTree loaded = j;
+        ASSERT_EQ(RegressorProgram(SS, loaded).get_model(), PRG.get_model());
+        ASSERT_EQ(json(loaded.to_tree()), j);
+
+        ArrayXf w = ArrayXf::Random(flat.get_n_weights());
+        flat.set_weights(w);
+        PRG.set_weights(w);
+        ASSERT_EQ(json(flat), json(PRG.Tree));
+        PRG.replace_program(flat);
+        ASSERT_EQ(json(flat), json(PRG.Tree));
+    }
+
+    // subtree crossover is a splice of the arrays, or an erase followed by
+    // an insertion, and gives the same program as on the linked tree
+    for (int k = 0; k < 200; ++k)
+    {
+        const auto& mom = programs.at(k % programs.size());
+        const auto& dad = programs.at((k + 1) % programs.size());
+        FlatTree flat_mom = mom.flatten(), flat_dad = dad.flatten();
+        size_t i = Brush::Util::r.rnd_int(0, flat_mom.size()-1);
+        size_t j = Brush::Util::r.rnd_int(0, flat_dad.size()-1);
+
+        tree<Node> child = mom.Tree;
+        child.replace(std::next(child.begin(), i), std::next(dad.Tree.begin(), j));
+
+        FlatTree flat_child = flat_mom;
+        flat_child.replace(i, flat_dad, j);
+        ASSERT_EQ(json(flat_child), json(child));
+        ASSERT_EQ(json(flat_child.to_tree()), json(child));
+        ASSERT_EQ(flat_child.depth(), 1+child.max_depth());
+
+        if (i == 0)
+            continue;
+
+        int p = flat_mom.parent(i);
+        size_t n = 0;
+        for (size_t c = p + 1; c < i; c += flat_mom.subtree_size(c))
+            ++n;
+        flat_mom.erase(i);
+        flat_mom.insert(p, n, flat_dad, j);
+        ASSERT_EQ(json(flat_mom), json(child));
+        ASSERT_EQ(flat_mom.subtree_size(0), child.size());
+    }
+
+    // linear traversal, compared to chasing the pointers of the tree
+    vector<FlatTree> flats;
+    for (const auto& PRG : programs)
+        flats.push_back(PRG.flatten());
+
+    auto time = [&](auto f) {
+        auto start = std::chrono::steady_clock::now();
+        int acc = 0;
+        for (int rep = 0; rep < 20; ++rep)
+            acc += f();
+        auto t = std::chrono::duration<float, std::micro>(
+            std::chrono::steady_clock::now() - start).count()/20;
+        return std::make_pair(t, acc);
+    };
+    auto [t_tree, n_tree] = time([&]{
+        int n = 0;
+        for (const auto& PRG : programs)
+            n += PRG.get_n_weights() + PRG.size() + PRG.depth();
+        return n; });
+    auto [t_flat, n_flat] = time([&]{
+        int n = 0;
+        for (const auto& flat : flats)
+            n += flat.get_n_weights() + flat.get_size() + flat.depth();
+        return n; });
+    ASSERT_EQ(n_tree, n_flat);
+    if (run_benchmarks())
+        fmt::print("weights, size and depth of {} programs: {:.1f} us on trees, "
+            "{:.1f} us on flat trees\n", programs.size(), t_tree, t_flat);
+}
+
+TEST(Program, CppModel)
+{
+    if (std::system("c++ --version > /dev/null 2>&1") != 0)
+        GTEST_SKIP() << "no C++ compiler to build the exported programs";
+
+    Parameters params;
+    params.max_size  = 30;
+    params.max_depth = 6;
+
+    Dataset data = Data::read_csv("docs/examples/datasets/d_enc.csv","label");
+    Dataset data_clf = Data::read_csv("docs/examples/datasets/d_analcatdata_aids.csv","target");
+
+    SearchSpace SS, SS_clf;
+    SS.init(data);
+    SS_clf.init(data_clf);
+
+    namespace fs = std::filesystem;
+    string dir_name = (fs::temp_directory_path() / "brush_cpp_model_XXXXXX").string();
+    ASSERT_NE(mkdtemp(dir_name.data()), nullptr);
+    const fs::path dir = dir_name;
+
+    // the directory is removed however the test returns
+    struct RemoveDir {
+        fs::path path;
+        ~RemoveDir() { std::error_code ec; fs::remove_all(path, ec); }
+    } remove_dir{dir};
+
+    // one source per program, built into one library
+    vector<RegressorProgram> regressors;
+    vector<ClassifierProgram> classifiers;
+    string sources;
+    auto write = [&](const string& src, const string& name) {
+        std::ofstream(dir / (name + ".cpp")) << src;
+        sources += " " + (dir / (name + ".cpp")).string();
+    };
+    for (int p = 0; p < 30; ++p)
+    {
+        regressors.push_back(SS.make_regressor(0, 0, params));
+        regressors.back().fit(data);
+        write(regressors.back().get_cpp_model(fmt::format("regressor_{}", p)),
+              fmt::format("regressor_{}", p));
+        ASSERT_EQ(regressors.back().get_model("cpp"), 
+                  regressors.back().get_cpp_model("brush_predict"));
+    }
+    for (int p = 0; p < 10; ++p)
+    {
+        classifiers.push_back(SS_clf.make_classifier(0, 0, params));
+        classifiers.back().fit(data_clf);
+        write(classifiers.back().get_cpp_model(fmt::format("classifier_{}", p)),
+              fmt::format("classifier_{}", p));
+    }
+
+    // the square root of a feature that is inf on all rows but one, which
+    // Brush evaluates in packets and in the rows after the last packet
+    MatrixXf X_inf = MatrixXf::Constant(37, 1, INFINITY);
+    X_inf(5, 0) = 6.25f;
+    Dataset data_inf(X_inf, ArrayXf::Zero(37));
+
+    RegressorProgram sqrt_inf;
+    auto root = sqrt_inf.Tree.set_head(Node(NodeType::Sqrt, 
+                                            Signature<ArrayXf(ArrayXf)>{}, false));
+    sqrt_inf.Tree.append_child(root, Node(NodeType::Terminal, 
+                                          Signature<ArrayXf()>{}, false, "x_0"));
+    sqrt_inf.fit(data_inf);
+    write(sqrt_inf.get_cpp_model("sqrt_inf"), "sqrt_inf");
+
+    fs::path lib = dir / "libmodels.so";
+    string cmd = fmt::format("c++ -O2 -shared -fPIC -o {}{}", lib.string(), sources);
+    ASSERT_EQ(std::system(cmd.c_str()), 0) << cmd;
+
+    void* handle = dlopen(lib.c_str(), RTLD_NOW | RTLD_LOCAL);
+    ASSERT_NE(handle, nullptr) << dlerror();
+    std::unique_ptr<void, int(*)(void*)> library(handle, dlclose);
+
+    using Model = void(*)(const float* const*, float*, size_t);
+
+    // the columns of the features listed in the header of the source
+    auto get_columns = [](const string& src, const Dataset& d) {
+        vector<ArrayXf> columns;
+        std::istringstream lines(src);
+        string line;
+        while (std::getline(lines, line))
+        {
+            auto pos = line.find("//     X[");
+            if (pos != 0)
+                continue;
+            string name = line.substr(line.find(": ") + 2);
+            columns.push_back(std::visit([](const auto& x) -> ArrayXf {
+                using T = std::decay_t<decltype(x)>;
+                if constexpr (is_same_v<T, ArrayXf> || is_same_v<T, ArrayXi>
+                          ||  is_same_v<T, ArrayXb>)
+                    return x.template cast<float>();
+                else
+                    return ArrayXf();
+            }, d[name]));
+        }
+        return columns;
+    };
+
+    auto close = [](float a, float b) {
+        return a == b || (std::isnan(a) && std::isnan(b))
+            || std::fabs(a - b) <= 1e-4*std::max(1.0f, std::fabs(b));
+    };
+
+    // rows where a node of the program outputs a subnormal value in Brush.
+    // The vectorized exp, log and sqrt of Eigen flush subnormals, where the
+    // standard library does not (see get_cpp_model).
+    auto subnormal_rows = [](auto& PRG, const Dataset& d) {
+        ArrayXb rows = ArrayXb::Constant(d.get_n_samples(), false);
+        for (auto it = PRG.Tree.begin(); it != PRG.Tree.end(); ++it)
+        {
+            if (it->ret_type != DataType::ArrayF)
+                continue;
+            ArrayXf x = it.node->template predict<ArrayXf>(d);
+            rows = rows || (x != 0 && x.abs() < std::numeric_limits<float>::min());
+        }
+        return rows;
+    };
+
+    size_t n = 0, n_compared = 0, n_unstable = 0, n_subnormal = 0;
+    float t_exported = 0, t_brush = 0;
+    auto check = [&](auto& PRG, const Dataset& d, const string& name, auto predict) {
+        Model model = reinterpret_cast<Model>(dlsym(handle, name.c_str()));
+        ASSERT_NE(model, nullptr) << dlerror();
+
+        auto columns = get_columns(PRG.get_cpp_model(name), d);
+        vector<const float*> X;
+        for (const auto& c : columns)
+            X.push_back(c.data());
+
+        ArrayXf out(d.get_n_samples());
+        auto start = std::chrono::steady_clock::now();
+        model(X.data(), out.data(), out.size());
+        auto mid = std::chrono::steady_clock::now();
+        ArrayXf expected = predict(PRG, d);
+        auto end = std::chrono::steady_clock::now();
+        t_exported += std::chrono::duration<float, std::micro>(mid - start).count();
+        t_brush += std::chrono::duration<float, std::micro>(end - mid).count();
+
+        // rows whose output moves by more than the tolerance when the
+        // features move by one ulp, such as the tangent of a large value,
+        // are too ill-conditioned for two evaluations to agree on. Features
+        // move away from zero, which keeps their integer and boolean values.
+        vector<ArrayXf> nudged;
+        vector<const float*> X_nudged;
+        for (const auto& c : columns)
+        {
+            nudged.push_back(c.unaryExpr([](float x) {
+                return x == 0 ? x : std::nextafter(x, std::copysign(INFINITY, x)); 
+            }));
+            X_nudged.push_back(nudged.back().data());
+        }
+        ArrayXf out_nudged(d.get_n_samples());
+        model(X_nudged.data(), out_nudged.data(), out_nudged.size());
+
+        const ArrayXb subnormal = subnormal_rows(PRG, d);
+
+        // every other row agrees, including infinities and NaNs
+        for (int i = 0; i < out.size(); ++i)
+        {
+            ++n;
+            if (!close(out_nudged(i), out(i)))
+            {
+                ++n_unstable;
+                continue;
+            }
+            if (subnormal(i))
+            {
+                ++n_subnormal;
+                continue;
+            }
+            ++n_compared;
+            EXPECT_TRUE(close(out(i), expected(i))) << name << ": " << out(i) 
+                << " vs " << expected(i) << " in row " << i << " of " 
+                << PRG.get_model();
+        }
+    };
+
+    for (size_t p = 0; p < regressors.size(); ++p)
+        check(regressors[p], data, fmt::format("regressor_{}", p),
+              [](auto& PRG, const Dataset& d) { return PRG.predict(d); });
+    for (size_t p = 0; p < classifiers.size(); ++p)
+        check(classifiers[p], data_clf, fmt::format("classifier_{}", p),
+              [](auto& PRG, const Dataset& d) { return PRG.predict_proba(d); });
+
+    // like std::sqrt, Brush's square root is inf on inf in every row
+    ArrayXf sqrt_out = sqrt_inf.predict(data_inf);
+    ASSERT_EQ((sqrt_out == INFINITY).count(), 36);
+    ASSERT_EQ(sqrt_out(5), 2.5f);
+    check(sqrt_inf, data_inf, "sqrt_inf",
+          [](auto& PRG, const Dataset& d) { return PRG.predict(d); });
+
+    fmt::print("{} of {} exported predictions compared to Brush's, {} "
+        "ill-conditioned and {} subnormal ones left out. {:.0f} us exported, "
+        "{:.0f} us in Brush\n", n_compared, n, n_unstable, n_subnormal,
+        t_exported, t_brush);
+    ASSERT_GT(n_compared, 0);
+}
+
+TEST(Program, FusedEvaluation)
+{
+    Parameters params;
+    params.max_size  = 50;
+    params.max_depth = 10;
+
+    // in benchmarks, rows enough that the output of a node does not fit in
+    // cache. Features take few values, so that splits are quick to fit.
+    ArrayXXf X = (8*ArrayXXf::Random(bench_size(1 << 16, 1 << 12), 4)).round()/8 + 0.01;
+    ArrayXf y = X.col(0)*X.col(1) + X.col(2).exp();
+    Dataset data_large(X, y);
+    Dataset data_enc = Data::read_csv("docs/examples/datasets/d_enc.csv","label");
+
+    auto same = [](const ArrayXf& a, const ArrayXf& b) {
+        return a.size() == b.size() 
+            && (a == b || (a.isNaN() && b.isNaN())).all();
+    };
+    auto close = [](const ArrayXf& a, const ArrayXf& b) {
+        return a.size() == b.size() 
+            && ((a - b).abs() <= 1e-5*a.abs().max(1.0f) 
+                || a == b || (a.isNaN() && b.isNaN())).all();
+    };
+
+    auto& arena = Util::BufferArena::local();
+    for (Dataset* data : {&data_enc, &data_large})
+    {
+        SearchSpace SS;
+        SS.init(*data);
+
+        const int n_programs = 20;
+        const int n_evals = bench_size(10, 1);
+        size_t n_nodes = 0, n_fused = 0;
+        size_t n_arrays = 0, n_arrays_fused = 0;
+        float t_nodes = 0, t_fused = 0;
+        for (int p = 0; p < n_programs; ++p)
+        {
+            RegressorProgram PRG = SS.make_regressor(0, 0, params);
+            PRG.fit(*data);
+            n_nodes += PRG.Tree.size();
+
+            // groups output what their nodes do
+            ArrayXf y_rec = PRG.Tree.begin().node->predict<ArrayXf>(*data);
+            ArrayXf y_fused = PRG.predict(*data);
+            ASSERT_TRUE(same(y_fused, y_rec));
+            n_fused += PRG.compiled_predict.get_n_fused();
+
+            // the cached run fuses the groups whose nodes all run
+            {
+                SubtreeCache cache(size_t(64) << 20);
+                SubtreeCache::Scope scope(&cache);
+                for (int pass = 0; pass < 3; ++pass)
+                    ASSERT_TRUE(same(PRG.predict(*data), y_rec));
+            }
+
+            // with the kernels of the fast precision
+            {
+                Util::FastMath::Scope precision("fast");
+                ArrayXf y_fast_fused = PRG.predict(*data);
+                PRG.compiled_predict.set_fuse(false);
+                ArrayXf y_fast = PRG.predict(*data);
+                ASSERT_TRUE(close(y_fast_fused, y_fast));
+            }
+
+            // arrays drawn from the arena, and time, node by node and fused
+            ASSERT_TRUE(same(PRG.predict(*data), y_rec));
+            ASSERT_EQ(PRG.compiled_predict.get_n_fused(), 0);
+
+            // copies keep the setting
+            RegressorProgram clone = PRG;
+            ASSERT_FALSE(clone.compiled_predict.get_fuse());
+            clone = SS.make_regressor(0, 0, params);
+            clone = PRG;
+            ASSERT_FALSE(clone.compiled_predict.get_fuse());
+
+            arena.reset_counters();
+            Util::Timer timer(true);
+            for (int i = 0; i < n_evals; ++i)
+                arena.release(PRG.predict(*data));
+            t_nodes += timer.Elapsed().count();
+            n_arrays += arena.get_n_allocations() + arena.get_n_reused();
+
+            PRG.compiled_predict.set_fuse(true);
+            arena.reset_counters();
+            timer.Reset();
+            for (int i = 0; i < n_evals; ++i)
+                arena.release(PRG.predict(*data));
+            t_fused += timer.Elapsed().count();
+            n_arrays_fused += arena.get_n_allocations() + arena.get_n_reused();
+        }
+        if (run_benchmarks())
+            fmt::print("{} samples, {} nodes: {} fused. Arrays per evaluation: "
+                "{:.1f} node by node, {:.1f} fused. {:.1f} us node by node, "
+                "{:.1f} us fused per evaluation\n", data->get_n_samples(), 
+                n_nodes, n_fused, float(n_arrays)/(n_programs*n_evals), 
+                float(n_arrays_fused)/(n_programs*n_evals), 
+                1e6*t_nodes/(n_programs*n_evals), 1e6*t_fused/(n_programs*n_evals));
+
+        ASSERT_GT(n_fused, 0);
+        ASSERT_LT(n_arrays_fused, n_arrays);
+    }
+}
@@ -1,4 +1,5 @@
 #include "testsHeader.h"
+#include "../../src/data/io.h"
 // #include "../../src/bandit/bandit.cpp"
 
 TEST(Variation, FixedRootDoesntChange)
@@ -603,4 +604,99 @@ TEST(Variation, CrossoverSizeAndDepthLimit)
         }
     }
     ASSERT_TRUE(successes > 0);
-}
\ No newline at end of file
+}
+TEST(Variation, IncrementalEvaluation)
+{
+    Parameters params;
+
+    Dataset data = Data::read_csv("docs/examples/datasets/d_enc.csv","label");
+
+    SearchSpace SS;
+    SS.init(data);
+
+    params.max_size  = 30;
+    params.max_depth = 6;
+
+    Variation variator = Variation<ProgramType::Regressor>(params, SS, data);
+
+    auto same = [](const ArrayXf& a, const ArrayXf& b) {
+        return (a == b || (a.isNaN() && b.isNaN())).all();
+    };
+
+    // fits and predicts a program, retaining its outputs
+    auto evaluate = [&](RegressorProgram& PRG) {
+        NodeOutputs::Scope retain(true);
+        PRG.fit(data);
+        return PRG.predict(data);
+    };
+
+    size_t n_children = 0;
+    size_t n_nodes = 0, n_loaded = 0, n_fit_loaded = 0;
+    for (int attempt = 0; attempt < 20; ++attempt)
+    {
+        RegressorProgram mom = SS.make_regressor(0, 0, params);
+        RegressorProgram dad = SS.make_regressor(0, 0, params);
+        evaluate(mom);
+        evaluate(dad);
+        ASSERT_TRUE(mom.outputs != nullptr);
+
+        // a clone reads the output of its root
+        RegressorProgram clone(mom);
+        {
+            NodeOutputs::Scope retain(true);
+            ArrayXf y_clone = clone.predict(data);
+            RegressorProgram expected(mom);
+            expected.outputs = nullptr;
+            ASSERT_TRUE(same(y_clone, expected.predict(data)));
+            if (mom.Tree.size() > 1)
+                ASSERT_EQ(clone.compiled_predict.get_n_loaded(), mom.Tree.size());
+        }
+
+        Individual<PT::Regressor> IND1(mom), IND2(dad);
+        for (string choice : {"point", "insert", "delete", "subtree", "cx"})
+        {
+            auto opt = choice == "cx" ? variator.cross(IND1, IND2)
+                                      : variator.mutate(IND1, choice);
+            if (!opt)
+                continue;
+
+            RegressorProgram child = opt.value().program;
+            RegressorProgram fitted(child);
+
+            // the same program, evaluated from scratch
+            RegressorProgram expected(child);
+            expected.outputs = nullptr;
+            ArrayXf y_expected = expected.predict(data);
+
+            // predictions with the weights of the parents only evaluate 
+            // the changed subtree and its ancestors
+            {
+                NodeOutputs::Scope retain(true);
+                ASSERT_TRUE(same(child.predict(data), y_expected));
+            }
+            n_loaded += child.compiled_predict.get_n_loaded();
+            n_nodes += child.Tree.size();
+
+            // fitting reads the outputs of the parents before the weights
+            // are optimized
+            expected.fit(data);
+            ASSERT_TRUE(same(evaluate(fitted), expected.predict(data)));
+            n_fit_loaded += fitted.compiled_fit.get_n_loaded();
+            ++n_children;
+        }
+    }
+
+    fmt::print("incremental evaluation: {} children, {} of {} nodes read "
+        "from their parents when predicting, {} when fitting\n",
+        n_children, n_loaded, n_nodes, n_fit_loaded);
+
+    ASSERT_GT(n_children, 0);
+    ASSERT_GT(n_loaded, 0);
+    ASSERT_GT(n_fit_loaded, 0);
+
+    // outputs are not read or retained outside of a scope
+    RegressorProgram PRG = SS.make_regressor(0, 0, params);
+    PRG.fit(data);
+    PRG.predict(data);
+    ASSERT_TRUE(PRG.outputs == nullptr);
+}
@@ -24,6 +24,7 @@ using std::to_string;
 using std::stof;
 
 #include <cstdio>
+#include <cstdlib>
 #include "../../src/init.h"
 #include "../../src/params.h"
 #include "../../src/data/data.h"
@@ -54,4 +55,17 @@ using namespace Brush::Data;
 using namespace Brush::Var;
 using namespace Brush::MAB;
 
+// tests that time the library run at full size, and print their timings, 
+// only when BRUSH_BENCHMARKS is set. Otherwise they keep their checks on 
+// small inputs.
+inline bool run_benchmarks()
+{
+    static const bool run = std::getenv("BRUSH_BENCHMARKS") != nullptr;
+    return run;
+}
+
+/// `full` when benchmarks run, `small` otherwise
+template<typename T>
+inline T bench_size(T full, T small) { return run_benchmarks() ? full : small; }
+
 #endif